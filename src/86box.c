@@ -103,6 +103,7 @@
 #include <86box/machine_status.h>
 #include <86box/apm.h>
 #include <86box/acpi.h>
+#include <86box/instrument.h>
 
 // Disable c99-designator to avoid the warnings about int ng
 #ifdef __clang__
@@ -190,6 +191,7 @@ uint32_t mem_size                               = 0;              /* (C) memory
                                                                          system board)*/
 uint32_t isa_mem_size                           = 0;              /* (C) memory size (ISA Memory Cards) */
 int      cpu_use_dynarec                        = 0;              /* (C) cpu uses/needs Dyna */
+int      cpu_dynarec_ir_disable                 = 0;              /* (C) disabled dynarec IR passes */
 int      cpu                                    = 0;              /* (C) cpu type */
 int      fpu_type                               = 0;              /* (C) fpu type */
 int      fpu_softfloat                          = 0;              /* (C) fpu uses softfloat */
@@ -549,13 +551,19 @@ usage:
 #endif
             printf("-I or --image d:path    - load 'path' as floppy image on drive d\n");
 #ifdef USE_INSTRUMENT
-            printf("-J or --instrument name - set 'name' to be the profiling instrument\n");
+            printf("-J or --instrument ms   - run unthrottled for 'ms' emulated milliseconds and report\n");
 #endif
             printf("-K or --keycodes codes  - set 'codes' to be the uncapture combination\n");
             printf("-L or --logfile path    - set 'path' to be the logfile\n");
             printf("-M or --missing         - dump missing machines and video cards\n");
             printf("-N or --noconfirm       - do not ask for confirmation on quit\n");
+#ifdef USE_INSTRUMENT
+            printf("-O or --instruout path  - write the instrument report to 'path'\n");
+#endif
             printf("-P or --vmpath path     - set 'path' to be root for vm\n");
+#ifdef USE_INSTRUMENT
+            printf("-Q or --instruport port - end the instrument run when the guest writes to 'port'\n");
+#endif
             printf("-R or --rompath path    - set 'path' to be ROM path\n");
 #ifndef USE_SDL_UI
             printf("-S or --settings        - show only the settings dialog\n");
@@ -689,6 +697,14 @@ usage:
                 goto usage;
             instru_enabled = 1;
             sscanf(argv[++c], "%llu", &instru_run_ms);
+        } else if (!strcasecmp(argv[c], "--instruout") || !strcasecmp(argv[c], "-O")) {
+            if ((c + 1) == argc)
+                goto usage;
+            strncpy(instru_out_path, argv[++c], sizeof(instru_out_path) - 1);
+        } else if (!strcasecmp(argv[c], "--instruport") || !strcasecmp(argv[c], "-Q")) {
+            if ((c + 1) == argc)
+                goto usage;
+            instru_marker_port = (int) strtol(argv[++c], NULL, 0) & 0xffff;
 #endif
         }
 
@@ -1334,6 +1350,8 @@ pc_reset_hard(void)
 void
 pc_close(UNUSED(thread_t *ptr))
 {
+    plat_mem_stats_t mem_stats;
+
     /* Wait a while so things can shut down. */
     plat_delay_ms(200);
 
@@ -1343,6 +1361,10 @@ pc_close(UNUSED(thread_t *ptr))
     /* Terminate the UI thread. */
     is_quit = 1;
 
+    plat_get_mem_stats(&mem_stats);
+    pclog("Host memory: %" PRIu64 " KB resident (peak %" PRIu64 " KB), %" PRIu64 " minor and %" PRIu64 " major page faults\n",
+          mem_stats.rss >> 10, mem_stats.peak_rss >> 10, mem_stats.minor_faults, mem_stats.major_faults);
+
     nvr_save();
 
     config_save();
@@ -1434,6 +1456,7 @@ pc_run(void)
     }
 #endif
     joystick_process();
+    network_poll();
     endblit();
 
     /* Done with this frame, update statistics. */
@@ -347,6 +347,11 @@ cdi_set_device(cd_img_t *cdi, const char *path)
 {
     int ret;
 
+#ifdef USE_CHD
+    if ((ret = cdi_load_chd(cdi, path)))
+        return ret;
+#endif
+
     if ((ret = cdi_load_cue(cdi, path)))
         return ret;
 
@@ -735,6 +740,42 @@ cdi_load_iso(cd_img_t *cdi, const char *filename)
     return ret;
 }
 
+#ifdef USE_CHD
+int
+cdi_load_chd(cd_img_t *cdi, const char *filename)
+{
+    track_t       trk = { 0 };
+    track_file_t *tf;
+    int           error;
+
+    cdi->tracks     = NULL;
+    cdi->tracks_num = 0;
+
+    tf = chd_image_init(filename, &error);
+    if (error)
+        return 0;
+
+    for (int i = 0; i < chd_image_get_tracks_num(tf); i++) {
+        chd_image_get_track(tf, i, &trk);
+        cdi_track_push_back(cdi, &trk);
+        cdrom_image_backend_log("CHD: Track %i: start = %" PRIu64 ", length = %" PRIu64 ", skip = %" PRIu64 "\n",
+                                trk.number, trk.start, trk.length, trk.skip);
+    }
+
+    /* Lead out track. */
+    trk.number++;
+    trk.track_number = 0xAA;
+    trk.attr         = 0x16;
+    trk.start += trk.length;
+    trk.length = 0;
+    trk.skip   = 0;
+    trk.file   = NULL;
+    cdi_track_push_back(cdi, &trk);
+
+    return 1;
+}
+#endif
+
 static int
 cdi_cue_get_buffer(char *str, char **line, int up)
 {
@@ -0,0 +1,592 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          MAME CHD CD-ROM image back-end.
+ *
+ *          The CHD is presented to the image code as a single raw file
+ *          of 2352-byte frames, one per CHD frame. Tracks stored cooked
+ *          in the CHD get a synthesized sync pattern and header, audio
+ *          is swapped to little endian. Decompressed hunks are kept in
+ *          a small LRU cache, and a worker thread decompresses ahead of
+ *          sequential reads.
+ *
+ *
+ *
+ * Authors: Miran Grca, <mgrca8@gmail.com>
+ *
+ *          Copyright 2025 Miran Grca.
+ */
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/thread.h>
+#include <86box/cdrom_image_backend.h>
+
+#include <libchdr/chd.h>
+
+#define CHD_FRAME_SIZE      2448 /* 2352 bytes of data and 96 of subchannel. */
+#define CHD_CACHE_HUNKS     64
+#define CHD_PREFETCH_HUNKS  4
+#define CHD_MAX_TRACKS      99
+
+#define CDROM_BCD(x)        (((x) % 10) | (((x) / 10) << 4))
+
+enum {
+    CHD_TRACK_MODE1 = 0,      /* 2048 bytes of user data. */
+    CHD_TRACK_MODE1_RAW,      /* 2352 bytes. */
+    CHD_TRACK_MODE2,          /* 2336 bytes, starting with the subheader. */
+    CHD_TRACK_MODE2_FORM1,    /* 2048 bytes of user data. */
+    CHD_TRACK_MODE2_FORM2,    /* 2324 bytes of user data. */
+    CHD_TRACK_MODE2_FORM_MIX, /* 2336 bytes, starting with the subheader. */
+    CHD_TRACK_MODE2_RAW,      /* 2352 bytes. */
+    CHD_TRACK_AUDIO           /* 2352 bytes, big endian. */
+};
+
+typedef struct chd_track_t {
+    int      type;
+    uint32_t frame;   /* First frame in the CHD, including the stored pregap. */
+    uint32_t frames;  /* Frames in the CHD, including the stored pregap. */
+    uint32_t pregap;  /* Pregap frames stored in the CHD. */
+    uint32_t lba;     /* LBA of index 1. */
+} chd_track_t;
+
+typedef struct chd_hunk_t {
+    uint32_t hunk;
+    uint32_t stamp;
+    uint8_t *data;
+} chd_hunk_t;
+
+typedef struct chd_image_t {
+    track_file_t tf;
+
+    chd_file *chd;
+    uint32_t  hunk_bytes;
+    uint32_t  hunk_frames;
+    uint32_t  total_hunks;
+    uint32_t  total_frames;
+
+    int         tracks_num;
+    chd_track_t tracks[CHD_MAX_TRACKS];
+
+    /* Hunk cache, protected by the mutex along with the chd_file itself. */
+    mutex_t   *mutex;
+    chd_hunk_t cache[CHD_CACHE_HUNKS];
+    uint32_t   stamp;
+    uint32_t   last_hunk;
+
+    /* Prefetch worker. It decompresses through its own handle into its own
+       buffer without holding the mutex, so the foreground reads do not have
+       to wait for it. */
+    thread_t *thread;
+    event_t  *wake;
+    chd_file *prefetch_chd;
+    uint8_t  *prefetch_buf;
+    uint32_t  prefetch_hunk;
+    uint32_t  prefetch_end;
+    volatile int run;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t prefetched;
+} chd_image_t;
+
+#ifdef ENABLE_CDROM_IMAGE_CHD_LOG
+int cdrom_image_chd_do_log = ENABLE_CDROM_IMAGE_CHD_LOG;
+
+void
+cdrom_image_chd_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (cdrom_image_chd_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define cdrom_image_chd_log(fmt, ...)
+#endif
+
+/* Returns the cache slot holding the hunk, or NULL with the least recently
+   used slot in *victim. Must be called with the mutex held. */
+static chd_hunk_t *
+chd_image_find_hunk(chd_image_t *img, uint32_t hunk, chd_hunk_t **victim)
+{
+    chd_hunk_t *slot = &img->cache[0];
+
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++) {
+        chd_hunk_t *cur = &img->cache[i];
+
+        if ((cur->data != NULL) && (cur->hunk == hunk))
+            return cur;
+
+        /* Empty slots have a stamp of 0 and are taken first. */
+        if (cur->stamp < slot->stamp)
+            slot = cur;
+    }
+
+    *victim = slot;
+    return NULL;
+}
+
+/* Returns the cache slot holding the hunk, decompressing it into the
+   least recently used slot if needed. Must be called with the mutex held. */
+static chd_hunk_t *
+chd_image_get_hunk(chd_image_t *img, uint32_t hunk)
+{
+    chd_hunk_t *slot;
+    chd_hunk_t *cur = chd_image_find_hunk(img, hunk, &slot);
+
+    if (cur != NULL) {
+        cur->stamp = ++img->stamp;
+        img->hits++;
+        return cur;
+    }
+
+    if (slot->data == NULL) {
+        slot->data = (uint8_t *) malloc(img->hunk_bytes);
+        if (slot->data == NULL)
+            return NULL;
+    }
+
+    if (chd_read(img->chd, hunk, slot->data) != CHDERR_NONE) {
+        cdrom_image_chd_log("CHD: unable to read hunk %u\n", hunk);
+        slot->stamp = 0;
+        free(slot->data);
+        slot->data = NULL;
+        return NULL;
+    }
+
+    slot->hunk  = hunk;
+    slot->stamp = ++img->stamp;
+    img->misses++;
+
+    return slot;
+}
+
+static void
+chd_image_prefetch_thread(void *priv)
+{
+    chd_image_t *img = (chd_image_t *) priv;
+
+    while (img->run) {
+        thread_wait_event(img->wake, -1);
+        thread_reset_event(img->wake);
+
+        while (img->run) {
+            chd_hunk_t *slot;
+            uint8_t    *data;
+            uint32_t    hunk;
+            int         cached;
+
+            thread_wait_mutex(img->mutex);
+            if (img->prefetch_hunk >= img->prefetch_end) {
+                thread_release_mutex(img->mutex);
+                break;
+            }
+            hunk = img->prefetch_hunk++;
+            cached = (chd_image_find_hunk(img, hunk, &slot) != NULL);
+            thread_release_mutex(img->mutex);
+
+            if (cached)
+                continue;
+
+            if (img->prefetch_buf == NULL)
+                img->prefetch_buf = (uint8_t *) malloc(img->hunk_bytes);
+            if ((img->prefetch_buf == NULL) || (chd_read(img->prefetch_chd, hunk, img->prefetch_buf) != CHDERR_NONE))
+                continue;
+
+            /* A foreground read may have needed the hunk in the meantime. */
+            thread_wait_mutex(img->mutex);
+            if (chd_image_find_hunk(img, hunk, &slot) == NULL) {
+                data              = slot->data;
+                slot->data        = img->prefetch_buf;
+                slot->hunk        = hunk;
+                slot->stamp       = ++img->stamp;
+                img->prefetch_buf = data;
+                img->prefetched++;
+            }
+            thread_release_mutex(img->mutex);
+        }
+    }
+}
+
+static const chd_track_t *
+chd_image_find_track(const chd_image_t *img, uint32_t frame)
+{
+    for (int i = 0; i < img->tracks_num; i++) {
+        const chd_track_t *trk = &img->tracks[i];
+
+        if ((frame >= trk->frame) && (frame < (trk->frame + trk->frames)))
+            return trk;
+    }
+
+    return NULL;
+}
+
+/* Turns one CHD frame into a 2352-byte raw sector. */
+static void
+chd_image_build_sector(const chd_track_t *trk, uint32_t frame, const uint8_t *src, uint8_t *dst)
+{
+    uint32_t lba = trk->lba - trk->pregap + (frame - trk->frame) + 150;
+    int      m;
+    int      s;
+    int      f;
+
+    switch (trk->type) {
+        case CHD_TRACK_MODE1_RAW:
+        case CHD_TRACK_MODE2_RAW:
+            memcpy(dst, src, RAW_SECTOR_SIZE);
+            return;
+
+        case CHD_TRACK_AUDIO:
+            for (int i = 0; i < RAW_SECTOR_SIZE; i += 2) {
+                dst[i]     = src[i + 1];
+                dst[i + 1] = src[i];
+            }
+            return;
+
+        default:
+            break;
+    }
+
+    memset(dst, 0x00, RAW_SECTOR_SIZE);
+    memset(dst + 1, 0xff, 10);
+    FRAMES_TO_MSF(lba, &m, &s, &f);
+    dst[12] = CDROM_BCD(m & 0xff);
+    dst[13] = CDROM_BCD(s & 0xff);
+    dst[14] = CDROM_BCD(f & 0xff);
+
+    switch (trk->type) {
+        case CHD_TRACK_MODE1:
+            dst[15] = 1;
+            memcpy(dst + 16, src, COOKED_SECTOR_SIZE);
+            break;
+        case CHD_TRACK_MODE2:
+        case CHD_TRACK_MODE2_FORM_MIX:
+            dst[15] = 2;
+            memcpy(dst + 16, src, 2336);
+            break;
+        case CHD_TRACK_MODE2_FORM1:
+            dst[15] = 2;
+            memcpy(dst + 24, src, COOKED_SECTOR_SIZE);
+            break;
+        case CHD_TRACK_MODE2_FORM2:
+            dst[15] = 2;
+            dst[18] = dst[22] = 0x20; /* Form 2 submode. */
+            memcpy(dst + 24, src, 2324);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static int
+chd_image_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
+{
+    track_file_t *tf  = (track_file_t *) priv;
+    chd_image_t  *img = (chd_image_t *) tf->priv;
+    uint8_t       sector[RAW_SECTOR_SIZE];
+    uint32_t      frame = (uint32_t) (seek / RAW_SECTOR_SIZE);
+    uint32_t      pos   = (uint32_t) (seek % RAW_SECTOR_SIZE);
+    uint32_t      first_hunk;
+    uint32_t      hunk = 0;
+
+    if ((img == NULL) || ((seek + count) > ((uint64_t) img->total_frames * RAW_SECTOR_SIZE)))
+        return 0;
+
+    first_hunk = frame / img->hunk_frames;
+
+    thread_wait_mutex(img->mutex);
+
+    while (count > 0) {
+        const chd_track_t *trk   = chd_image_find_track(img, frame);
+        const size_t       len   = MIN(count, RAW_SECTOR_SIZE - pos);
+        chd_hunk_t        *entry = NULL;
+
+        hunk = frame / img->hunk_frames;
+
+        if (trk != NULL)
+            entry = chd_image_get_hunk(img, hunk);
+
+        if (entry == NULL) {
+            /* Padding between tracks, or a read error. */
+            if (trk != NULL) {
+                thread_release_mutex(img->mutex);
+                return 0;
+            }
+            memset(buffer, 0x00, len);
+        } else {
+            chd_image_build_sector(trk, frame, entry->data + ((frame % img->hunk_frames) * CHD_FRAME_SIZE), sector);
+            memcpy(buffer, sector + pos, len);
+        }
+
+        buffer += len;
+        count -= len;
+        pos = 0;
+        frame++;
+    }
+
+    /* Sequential access, have the worker decompress the next few hunks. */
+    if ((img->thread != NULL) && ((first_hunk == img->last_hunk) || (first_hunk == (img->last_hunk + 1)))) {
+        img->prefetch_hunk = MAX(img->prefetch_hunk, hunk + 1);
+        img->prefetch_end  = MIN(hunk + 1 + CHD_PREFETCH_HUNKS, img->total_hunks);
+        if (img->prefetch_hunk < img->prefetch_end)
+            thread_set_event(img->wake);
+    } else
+        img->prefetch_hunk = img->prefetch_end = 0;
+    img->last_hunk = hunk;
+
+    thread_release_mutex(img->mutex);
+
+    return 1;
+}
+
+static uint64_t
+chd_image_get_length(void *priv)
+{
+    const track_file_t *tf  = (track_file_t *) priv;
+    const chd_image_t  *img = (chd_image_t *) tf->priv;
+
+    return (uint64_t) img->total_frames * RAW_SECTOR_SIZE;
+}
+
+static void
+chd_image_close(void *priv)
+{
+    track_file_t *tf  = (track_file_t *) priv;
+    chd_image_t  *img = (chd_image_t *) tf->priv;
+
+    if (img == NULL)
+        return;
+
+    cdrom_image_chd_log("CHD: close(), %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " prefetched\n",
+                        img->hits, img->misses, img->prefetched);
+
+    if (img->thread != NULL) {
+        img->run = 0;
+        thread_set_event(img->wake);
+        thread_wait(img->thread);
+    }
+    if (img->wake != NULL)
+        thread_destroy_event(img->wake);
+    if (img->mutex != NULL)
+        thread_close_mutex(img->mutex);
+
+    for (int i = 0; i < CHD_CACHE_HUNKS; i++)
+        free(img->cache[i].data);
+    free(img->prefetch_buf);
+
+    if (img->prefetch_chd != NULL)
+        chd_close(img->prefetch_chd);
+    if (img->chd != NULL)
+        chd_close(img->chd);
+
+    free(img);
+}
+
+static int
+chd_image_parse_type(const char *type)
+{
+    static const struct {
+        const char *name;
+        int         type;
+    } types[] = {
+        { "MODE1",          CHD_TRACK_MODE1          },
+        { "MODE1_RAW",      CHD_TRACK_MODE1_RAW      },
+        { "MODE2",          CHD_TRACK_MODE2          },
+        { "MODE2_FORM1",    CHD_TRACK_MODE2_FORM1    },
+        { "MODE2_FORM2",    CHD_TRACK_MODE2_FORM2    },
+        { "MODE2_FORM_MIX", CHD_TRACK_MODE2_FORM_MIX },
+        { "MODE2_RAW",      CHD_TRACK_MODE2_RAW      },
+        { "AUDIO",          CHD_TRACK_AUDIO          }
+    };
+
+    for (size_t i = 0; i < (sizeof(types) / sizeof(types[0])); i++) {
+        if (!strcmp(type, types[i].name))
+            return types[i].type;
+    }
+
+    return -1;
+}
+
+/* Reads the track list from the metadata. */
+static int
+chd_image_parse_tracks(chd_image_t *img)
+{
+    char     meta[256];
+    char     type[64];
+    char     subtype[64];
+    char     pgtype[64];
+    char     pgsub[64];
+    uint32_t frame = 0;
+    uint32_t lba   = 0;
+
+    for (int i = 0; i < CHD_MAX_TRACKS; i++) {
+        chd_track_t *trk     = &img->tracks[i];
+        int          num     = 0;
+        int          frames  = 0;
+        int          pregap  = 0;
+        int          postgap = 0;
+
+        memset(meta, 0x00, sizeof(meta));
+        pgtype[0] = '\0';
+
+        if (chd_get_metadata(img->chd, CDROM_TRACK_METADATA2_TAG, i, meta, sizeof(meta) - 1, NULL, NULL, NULL) == CHDERR_NONE) {
+            if (sscanf(meta, CDROM_TRACK_METADATA2_FORMAT, &num, type, subtype, &frames, &pregap, pgtype, pgsub, &postgap) != 8)
+                return 0;
+        } else if (chd_get_metadata(img->chd, CDROM_TRACK_METADATA_TAG, i, meta, sizeof(meta) - 1, NULL, NULL, NULL) == CHDERR_NONE) {
+            if (sscanf(meta, CDROM_TRACK_METADATA_FORMAT, &num, type, subtype, &frames) != 4)
+                return 0;
+        } else
+            break;
+
+        if ((num != (i + 1)) || (frames <= 0) || ((trk->type = chd_image_parse_type(type)) < 0))
+            return 0;
+
+        trk->frame  = frame;
+        trk->frames = frames;
+
+        /* A pregap type starting with V means the pregap is stored in the track's frames. */
+        if (pgtype[0] == 'V') {
+            trk->pregap = MIN(pregap, frames);
+            trk->lba    = lba + trk->pregap;
+        } else {
+            trk->pregap = 0;
+            trk->lba    = lba + pregap;
+        }
+
+        lba = trk->lba + (trk->frames - trk->pregap) + postgap;
+
+        /* Every track is padded to a multiple of 4 frames. */
+        frame += (frames + 3) & ~3;
+
+        cdrom_image_chd_log("CHD: Track %i: type %s, %i frames at %u, pregap %i (%s), LBA %u\n",
+                            num, type, frames, trk->frame, pregap, pgtype, trk->lba);
+
+        img->tracks_num++;
+    }
+
+    img->total_frames = frame;
+
+    return (img->tracks_num > 0) && (img->total_frames <= (img->total_hunks * img->hunk_frames));
+}
+
+int
+chd_image_get_track(track_file_t *tf, int track, track_t *trk)
+{
+    const chd_image_t *img = (chd_image_t *) tf->priv;
+    const chd_track_t *cur;
+
+    if ((track < 0) || (track >= img->tracks_num))
+        return 0;
+
+    cur = &img->tracks[track];
+
+    memset(trk, 0x00, sizeof(track_t));
+    trk->number       = track + 1;
+    trk->track_number = track + 1;
+    trk->attr         = (cur->type == CHD_TRACK_AUDIO) ? AUDIO_TRACK : DATA_TRACK;
+    trk->sector_size  = RAW_SECTOR_SIZE;
+    trk->mode2        = (cur->type >= CHD_TRACK_MODE2) && (cur->type <= CHD_TRACK_MODE2_RAW);
+    switch (cur->type) {
+        case CHD_TRACK_MODE2_FORM1:
+        case CHD_TRACK_MODE2_FORM_MIX:
+        case CHD_TRACK_MODE2_RAW:
+            trk->form = 1;
+            break;
+        case CHD_TRACK_MODE2_FORM2:
+            trk->form = 2;
+            break;
+        default:
+            break;
+    }
+    trk->start  = cur->lba;
+    trk->length = cur->frames - cur->pregap;
+    trk->skip   = (uint64_t) (cur->frame + cur->pregap) * RAW_SECTOR_SIZE;
+    trk->file   = tf;
+
+    return 1;
+}
+
+int
+chd_image_get_tracks_num(track_file_t *tf)
+{
+    return ((chd_image_t *) tf->priv)->tracks_num;
+}
+
+track_file_t *
+chd_image_init(const char *filename, int *error)
+{
+    chd_image_t      *img = (chd_image_t *) calloc(1, sizeof(chd_image_t));
+    const chd_header *header;
+
+    *error = 1;
+    if (img == NULL)
+        return NULL;
+
+    if (chd_open(filename, CHD_OPEN_READ, NULL, &img->chd) != CHDERR_NONE) {
+        free(img);
+        return NULL;
+    }
+
+    header = chd_get_header(img->chd);
+    if ((header == NULL) || (header->unitbytes != CHD_FRAME_SIZE) || (header->hunkbytes % CHD_FRAME_SIZE)) {
+        cdrom_image_chd_log("CHD: %s is not a CD-ROM image\n", filename);
+        chd_close(img->chd);
+        free(img);
+        return NULL;
+    }
+
+    img->hunk_bytes  = header->hunkbytes;
+    img->hunk_frames = header->hunkbytes / CHD_FRAME_SIZE;
+    img->total_hunks = header->totalhunks;
+    img->last_hunk   = (uint32_t) -1;
+
+    if (!chd_image_parse_tracks(img)) {
+        cdrom_image_chd_log("CHD: %s has invalid track metadata\n", filename);
+        chd_close(img->chd);
+        free(img);
+        return NULL;
+    }
+
+    strncpy(img->tf.fn, filename, sizeof(img->tf.fn) - 1);
+    img->tf.priv       = img;
+    img->tf.read       = chd_image_read;
+    img->tf.get_length = chd_image_get_length;
+    img->tf.close      = chd_image_close;
+
+    img->mutex = thread_create_mutex();
+    img->wake  = thread_create_event();
+    img->run   = 1;
+    if ((img->mutex == NULL) || (img->wake == NULL)) {
+        chd_image_close(&img->tf);
+        return NULL;
+    }
+
+    /* A chd_file cannot be read from two threads at once, so the worker gets
+       its own. Without it, there is no read-ahead. */
+    if (chd_open(filename, CHD_OPEN_READ, NULL, &img->prefetch_chd) == CHDERR_NONE)
+        img->thread = thread_create(chd_image_prefetch_thread, img);
+    else
+        img->prefetch_chd = NULL;
+
+    cdrom_image_chd_log("CHD: %s: %i tracks, %u hunks of %u frames\n",
+                        filename, img->tracks_num, img->total_hunks, img->hunk_frames);
+
+    *error = 0;
+    return &img->tf;
+}
@@ -38,6 +38,7 @@
 #include <86box/path.h>
 #include <86box/plat.h>
 #include <86box/plat_dir.h>
+#include <86box/thread.h>
 #include <86box/version.h>
 #include <86box/timer.h>
 #include <86box/nvr.h>
@@ -79,6 +80,9 @@ typedef struct stat stat_t;
 
 #define VISO_SECTOR_SIZE COOKED_SECTOR_SIZE
 #define VISO_OPEN_FILES  32
+#define VISO_SCAN_THREADS 4   /* threads used to stat large directories */
+#define VISO_SCAN_MIN     256 /* smallest directory worth scanning in parallel */
+#define VISO_SCAN_BATCH   32
 
 enum {
     VISO_CHARSET_D = 0,
@@ -120,20 +124,33 @@ typedef struct _viso_entry_ {
     char *basename, path[];
 } viso_entry_t;
 
+/* A run of sectors backed by one file, from its first sector up to the next extent. */
+typedef struct {
+    size_t        sector;
+    viso_entry_t *entry;
+} viso_extent_t;
+
 typedef struct {
     uint64_t vol_size_offsets[2];
     uint64_t pt_meta_offsets[2];
     int      format;
     uint8_t  use_version_suffix : 1;
-    size_t   metadata_sectors, all_sectors, entry_map_size, sector_size, file_fifo_pos;
+    size_t   metadata_sectors, all_sectors, sector_size, extents_num, extents_size, last_extent;
     uint8_t *metadata;
 
     track_file_t   tf;
     viso_entry_t  *root_dir;
-    viso_entry_t **entry_map;
-    viso_entry_t  *file_fifo[VISO_OPEN_FILES];
+    viso_extent_t *extents;
+    viso_entry_t  *open_files[VISO_OPEN_FILES]; /* most recently used first */
 } viso_t;
 
+typedef struct {
+    viso_entry_t **entries;
+    size_t         count;
+    size_t         next;
+    mutex_t       *mutex;
+} viso_scan_t;
+
 static const char rr_eid[]   = "RRIP_1991A"; /* identifiers used in ER field for Rock Ridge */
 static const char rr_edesc[] = "THE ROCK RIDGE INTERCHANGE PROTOCOL PROVIDES SUPPORT FOR POSIX FILE SYSTEM SEMANTICS.";
 static int8_t     tz_offset  = 0;
@@ -659,76 +676,183 @@ pad_susp:
     return data[0];
 }
 
+static void
+viso_stat_entry(viso_entry_t *entry)
+{
+    if (stat(entry->path, &entry->stats) != 0) {
+        /* Use a blank structure if stat failed. */
+        memset(&entry->stats, 0x00, sizeof(stat_t));
+    }
+}
+
+static void
+viso_scan_thread(void *priv)
+{
+    viso_scan_t *scan = (viso_scan_t *) priv;
+    size_t       first;
+
+    while (1) {
+        /* Claim the next batch of entries. */
+        thread_wait_mutex(scan->mutex);
+        first = scan->next;
+        scan->next += VISO_SCAN_BATCH;
+        thread_release_mutex(scan->mutex);
+
+        if (first >= scan->count)
+            break;
+
+        for (size_t i = first; i < MIN(first + VISO_SCAN_BATCH, scan->count); i++)
+            viso_stat_entry(scan->entries[i]);
+    }
+}
+
+/* Stats a directory's children, spreading large directories over several
+   threads since stat() dominates the scan time on big or remote trees. */
+static void
+viso_stat_entries(viso_entry_t **entries, size_t count)
+{
+    viso_scan_t scan    = { .entries = entries, .count = count };
+    thread_t   *threads[VISO_SCAN_THREADS - 1];
+
+    if ((count < VISO_SCAN_MIN) || !(scan.mutex = thread_create_mutex())) {
+        for (size_t i = 0; i < count; i++)
+            viso_stat_entry(entries[i]);
+        return;
+    }
+
+    for (int i = 0; i < (VISO_SCAN_THREADS - 1); i++)
+        threads[i] = thread_create(viso_scan_thread, &scan);
+    viso_scan_thread(&scan);
+    for (int i = 0; i < (VISO_SCAN_THREADS - 1); i++) {
+        if (threads[i])
+            thread_wait(threads[i]);
+    }
+
+    thread_close_mutex(scan.mutex);
+}
+
 static int
 viso_compare_entries(const void *a, const void *b)
 {
     return strcmp((*((viso_entry_t **) a))->name_short, (*((viso_entry_t **) b))->name_short);
 }
 
+/* Finds the extent containing a data sector, trying the last one used first. */
+static const viso_extent_t *
+viso_find_extent(viso_t *viso, size_t sector)
+{
+    size_t lo = 0;
+    size_t hi = viso->extents_num;
+
+    if (!hi || (sector < viso->extents[0].sector))
+        return NULL;
+
+    if ((viso->last_extent < hi) && (sector >= viso->extents[viso->last_extent].sector)) {
+        lo = viso->last_extent;
+        if (((lo + 1) == hi) || (sector < viso->extents[lo + 1].sector))
+            return &viso->extents[lo];
+    }
+
+    /* Binary search for the last extent starting at or before this sector. */
+    while ((hi - lo) > 1) {
+        size_t mid = lo + ((hi - lo) / 2);
+
+        if (viso->extents[mid].sector <= sector)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    viso->last_extent = lo;
+    return &viso->extents[lo];
+}
+
+/* Returns an open handle for this entry's file, keeping the
+   most recently used files open and closing the oldest one. */
+static FILE *
+viso_open_file(viso_t *viso, viso_entry_t *entry)
+{
+    viso_entry_t *other_entry;
+    int           i;
+
+    /* Stop at this entry, the first free slot or the least recently used one. */
+    for (i = 0; (i < (VISO_OPEN_FILES - 1)) && viso->open_files[i] && (viso->open_files[i] != entry); i++)
+        ;
+
+    other_entry = viso->open_files[i];
+    if (other_entry != entry) {
+        /* Close the least recently used entry's file. */
+        if (other_entry && other_entry->file) {
+            cdrom_image_viso_log("VISO: Closing [%s]\n", other_entry->path);
+            fclose(other_entry->file);
+            other_entry->file = NULL;
+        }
+
+        /* Open file. */
+        cdrom_image_viso_log("VISO: Opening [%s]", entry->path);
+        if (!(entry->file = fopen(entry->path, "rb"))) {
+            cdrom_image_viso_log(" => failed\n");
+
+            /* Drop the freed slot. */
+            for (; i < (VISO_OPEN_FILES - 1); i++)
+                viso->open_files[i] = viso->open_files[i + 1];
+            viso->open_files[VISO_OPEN_FILES - 1] = NULL;
+            return NULL;
+        }
+        cdrom_image_viso_log("\n");
+    }
+
+    /* Move this entry to the front. */
+    memmove(&viso->open_files[1], &viso->open_files[0], i * sizeof(viso->open_files[0]));
+    viso->open_files[0] = entry;
+
+    return entry->file;
+}
+
 int
 viso_read(void *priv, uint8_t *buffer, uint64_t seek, size_t count)
 {
     track_file_t *tf   = (track_file_t *) priv;
     viso_t       *viso = (viso_t *) tf->priv;
 
-    /* Handle reads in a sector by sector basis. */
+    /* Handle reads in runs of contiguous sectors. */
     while (count > 0) {
-        /* Determine the current sector, offset and remainder. */
-        size_t sector        = seek / viso->sector_size;
-        size_t sector_offset = seek % viso->sector_size;
-        size_t sector_remain = MIN(count, viso->sector_size - sector_offset);
+        size_t sector = seek / viso->sector_size;
+        size_t chunk;
 
-        /* Handle sector. */
         if (sector < viso->metadata_sectors) {
             /* Copy metadata. */
-            memcpy(buffer, viso->metadata + seek, sector_remain);
+            chunk = MIN(count, (viso->metadata_sectors * viso->sector_size) - seek);
+            memcpy(buffer, viso->metadata + seek, chunk);
         } else {
-            size_t read = 0;
-
-            /* Get the file entry corresponding to this sector. */
-            viso_entry_t *entry = viso->entry_map[sector - viso->metadata_sectors];
-            if (entry) {
-                /* Open file if it's not already open. */
-                if (!entry->file) {
-                    /* Close any existing FIFO entry's file. */
-                    viso_entry_t *other_entry = viso->file_fifo[viso->file_fifo_pos];
-                    if (other_entry && other_entry->file) {
-                        cdrom_image_viso_log("VISO: Closing [%s]", other_entry->path);
-                        fclose(other_entry->file);
-                        other_entry->file = NULL;
-                        cdrom_image_viso_log("\n");
-                    }
-
-                    /* Open file. */
-                    cdrom_image_viso_log("VISO: Opening [%s]", entry->path);
-                    if ((entry->file = fopen(entry->path, "rb"))) {
-                        cdrom_image_viso_log("\n");
-
-                        /* Add this entry to the FIFO. */
-                        viso->file_fifo[viso->file_fifo_pos++] = entry;
-                        viso->file_fifo_pos &= (sizeof(viso->file_fifo) / sizeof(viso->file_fifo[0])) - 1;
-                    } else {
-                        cdrom_image_viso_log(" => failed\n");
-
-                        /* Clear any existing FIFO entry. */
-                        viso->file_fifo[viso->file_fifo_pos] = NULL;
-                    }
-                }
-
-                /* Read data. */
-                if (entry->file && (fseeko64(entry->file, seek - entry->data_offset, SEEK_SET) != -1))
-                    read = fread(buffer, 1, sector_remain, entry->file);
-            }
+            const viso_extent_t *extent = viso_find_extent(viso, sector);
+            size_t               read   = 0;
+
+            if (extent) {
+                /* Read as much as possible from this extent's file in one go. */
+                size_t   next = (extent - viso->extents) + 1;
+                uint64_t end  = ((uint64_t) ((next < viso->extents_num) ? viso->extents[next].sector : viso->all_sectors)) * viso->sector_size;
+                FILE    *fp;
+
+                if (end > seek) {
+                    chunk = MIN(count, end - seek);
+                    fp    = viso_open_file(viso, extent->entry);
+                    if (fp && (fseeko64(fp, seek - extent->entry->data_offset, SEEK_SET) != -1))
+                        read = fread(buffer, 1, chunk, fp);
+                } else
+                    chunk = count; /* past the end of the image */
+            } else
+                chunk = count;
 
             /* Fill remainder with 00 bytes if needed. */
-            if (read < sector_remain)
-                memset(buffer + read, 0x00, sector_remain - read);
+            if (read < chunk)
+                memset(buffer + read, 0x00, chunk - read);
         }
 
-        /* Move on to the next sector. */
-        buffer += sector_remain;
-        seek += sector_remain;
-        count -= sector_remain;
+        /* Move on to the next run. */
+        buffer += chunk;
+        seek += chunk;
+        count -= chunk;
     }
 
     return 1;
@@ -773,8 +897,8 @@ viso_close(void *priv)
 
     if (viso->metadata)
         free(viso->metadata);
-    if (viso->entry_map)
-        free(viso->entry_map);
+    if (viso->extents)
+        free(viso->extents);
 
     free(viso);
 }
@@ -901,49 +1025,52 @@ viso_init(const char *dirname, int *error)
 
                 /* Add and fill entry. */
                 entry = dir_entries[children_count++] = (viso_entry_t *) calloc(1, sizeof(viso_entry_t) + dir_path_len + strlen(readdir_entry->d_name) + 2);
-                if (!entry)
+                if (!entry) {
+                    children_count--;
                     break;
+                }
                 entry->parent = dir;
                 strcpy(entry->path, dir->path);
                 path_slash(&entry->path[dir_path_len]);
                 entry->basename = &entry->path[dir_path_len + 1];
                 strcpy(entry->basename, readdir_entry->d_name);
+            }
 
-                /* Stat this child. */
-                if (stat(entry->path, &entry->stats) != 0) {
-                    /* Use a blank structure if stat failed. */
-                    memset(&entry->stats, 0x00, sizeof(stat_t));
-                }
+            /* Stat the children. */
+            viso_stat_entries(&dir_entries[2], children_count - 2);
 
+            /* Process the children, dropping any which can't be given a short filename. */
+            size_t read_count = children_count;
+            children_count    = 2;
+            for (size_t i = 2; i < read_count; i++) {
+                entry = dir_entries[children_count++] = dir_entries[i];
                 /* Handle file size and El Torito boot code. */
                 if (!S_ISDIR(entry->stats.st_mode)) {
                     /* Clamp file size to 4 GB - 1 byte. */
                     if (entry->stats.st_size > ((uint32_t) -1))
                         entry->stats.st_size = (uint32_t) -1;
 
-                    /* Increase entry map size. */
-                    viso->entry_map_size += entry->stats.st_size / viso->sector_size;
-                    if (entry->stats.st_size % viso->sector_size)
-                        viso->entry_map_size++; /* round up to the next sector */
+                    /* Reserve an extent for this file's data. */
+                    viso->extents_size++;
 
                     /* Detect El Torito boot code file and set it accordingly. */
                     if (dir == eltorito_dir) {
-                        if (!stricmp(readdir_entry->d_name, "Boot-NoEmul.img")) {
+                        if (!stricmp(entry->basename, "Boot-NoEmul.img")) {
                             eltorito_type = 0x00;
 have_eltorito_entry:
                             if (eltorito_entry)
                                 eltorito_others_present = 1; /* flag that the boot code directory contains other files */
                             eltorito_entry = entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-1.2M.img")) {
+                        } else if (!stricmp(entry->basename, "Boot-1.2M.img")) {
                             eltorito_type = 0x01;
                             goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-1.44M.img")) {
+                        } else if (!stricmp(entry->basename, "Boot-1.44M.img")) {
                             eltorito_type = 0x02;
                             goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-2.88M.img")) {
+                        } else if (!stricmp(entry->basename, "Boot-2.88M.img")) {
                             eltorito_type = 0x03;
                             goto have_eltorito_entry;
-                        } else if (!stricmp(readdir_entry->d_name, "Boot-HardDisk.img")) {
+                        } else if (!stricmp(entry->basename, "Boot-HardDisk.img")) {
                             eltorito_type = 0x04;
                             goto have_eltorito_entry;
                         } else {
@@ -955,10 +1082,10 @@ have_eltorito_entry:
                         if (eltorito_dir &&                                  /* El Torito directory present? */
                             (eltorito_type == 0x00) &&                       /* El Torito directory not checked yet, or confirmed to contain non-emulation boot code? */
                             (dir->parent == viso->root_dir) &&               /* one subdirectory deep? (I386 for instance) */
-                            !stricmp(readdir_entry->d_name, "SETUPLDR.BIN")) /* SETUPLDR.BIN present? */
+                            !stricmp(entry->basename, "SETUPLDR.BIN"))       /* SETUPLDR.BIN present? */
                             viso->use_version_suffix = 0;
                     }
-                } else if ((dir == viso->root_dir) && !stricmp(readdir_entry->d_name, "[BOOT]")) {
+                } else if ((dir == viso->root_dir) && !stricmp(entry->basename, "[BOOT]")) {
                     /* Set this as the directory containing El Torito boot code. */
                     eltorito_dir            = entry;
                     eltorito_others_present = 0;
@@ -1432,43 +1559,12 @@ next_entry:
         }
     }
 
-    /* Allocate entry map for sector->file lookups. */
-    size_t orig_sector_size = viso->sector_size;
-    while (1) {
-        cdrom_image_viso_log("VISO: Allocating entry map for %zu %zu-byte sectors\n", viso->entry_map_size, viso->sector_size);
-        viso->entry_map = (viso_entry_t **) calloc(viso->entry_map_size, sizeof(viso_entry_t *));
-        if (viso->entry_map) {
-            /* Successfully allocated. */
-            break;
-        } else {
-            /* Blank data buffer for padding if this is the first run. */
-            if (orig_sector_size == viso->sector_size)
-                memset(data, 0x00, orig_sector_size);
-
-            /* If we don't have enough memory, double the sector size. */
-            viso->sector_size *= 2;
-            if ((viso->sector_size < VISO_SECTOR_SIZE) || (viso->sector_size > (1 << 30))) /* give up if sectors become too large */
-                goto end;
-
-            /* Go through files, recalculating the entry map size. */
-            size_t orig_entry_map_size = viso->entry_map_size;
-            viso->entry_map_size       = 0;
-            entry                      = viso->root_dir;
-            while (entry) {
-                if (!S_ISDIR(entry->stats.st_mode)) {
-                    viso->entry_map_size += entry->stats.st_size / viso->sector_size;
-                    if (entry->stats.st_size % viso->sector_size)
-                        viso->entry_map_size++; /* round up to the next sector */
-                }
-                entry = entry->next;
-            }
-            if (viso->entry_map_size == orig_entry_map_size) /* give up if there was no change in map size */
-                goto end;
-
-            /* Pad metadata to the new size's next sector. */
-            while (ftello64(viso->tf.fp) % viso->sector_size)
-                fwrite(data, orig_sector_size, 1, viso->tf.fp);
-        }
+    /* Allocate the extent map for sector->file lookups. */
+    cdrom_image_viso_log("VISO: Allocating extent map for %zu files\n", viso->extents_size);
+    if (viso->extents_size) {
+        viso->extents = (viso_extent_t *) calloc(viso->extents_size, sizeof(viso_extent_t));
+        if (!viso->extents)
+            goto end;
     }
 
     /* Start sector counts. */
@@ -1477,10 +1573,8 @@ next_entry:
 
     /* Go through files, assigning sectors to them. */
     cdrom_image_viso_log("VISO: Assigning sectors to files:\n");
-    size_t        base_factor  = viso->sector_size / orig_sector_size;
-    viso_entry_t *prev_entry   = viso->root_dir;
-    viso_entry_t **entry_map_p = viso->entry_map;
-    entry                      = prev_entry->next;
+    viso_entry_t *prev_entry = viso->root_dir;
+    entry                    = prev_entry->next;
     while (entry) {
         /* Skip this entry if it corresponds to a directory. */
         if (S_ISDIR(entry->stats.st_mode)) {
@@ -1505,11 +1599,11 @@ next_entry:
             } else { /* emulation */
                 *((uint16_t *) &data[0]) = cpu_to_le16(1);
             }
-            *((uint32_t *) &data[2]) = cpu_to_le32(viso->all_sectors * base_factor);
+            *((uint32_t *) &data[2]) = cpu_to_le32(viso->all_sectors);
             viso_pwrite(data, eltorito_offset, 6, 1, viso->tf.fp);
         } else {
             p = data;
-            VISO_LBE_32(p, viso->all_sectors * base_factor);
+            VISO_LBE_32(p, viso->all_sectors);
             for (int i = 0; i <= max_vd; i++)
                 viso_pwrite(data, entry->dr_offsets[i] + 2, 8, 1, viso->tf.fp);
         }
@@ -1523,10 +1617,12 @@ next_entry:
             size++; /* round up to the next sector */
         cdrom_image_viso_log("[%08X] %s => %zu + %zu sectors\n", entry, entry->path, viso->all_sectors, size);
 
-        /* Allocate sectors to this file. */
+        /* Allocate sectors to this file. Empty files take no sectors and need no extent. */
+        if (size && (viso->extents_num < viso->extents_size)) {
+            viso->extents[viso->extents_num].sector  = viso->all_sectors;
+            viso->extents[viso->extents_num++].entry = entry;
+        }
         viso->all_sectors += size;
-        while (size-- > 0)
-            *entry_map_p++ = entry;
 
         /* Move on to the next entry. */
         prev_entry = entry;
@@ -62,6 +62,7 @@ void
 codegen_ir_compile(ir_data_t *ir, codeblock_t *block)
 {
     int jump_target_at_end = -1;
+    int mem_blocks;
     int c;
 
     if (codegen_unroll_count) {
@@ -82,6 +83,8 @@ codegen_ir_compile(ir_data_t *ir, codeblock_t *block)
 
     codegen_reg_mark_as_required();
     codegen_reg_process_dead_list(ir);
+    codegen_ir_optimise(ir);
+    mem_blocks       = codegen_allocator_usage;
     block_write_data = codeblock_allocator_get_ptr(block->head_mem_block);
     block_pos        = 0;
     codegen_backend_prologue(block);
@@ -189,6 +192,7 @@ codegen_ir_compile(ir_data_t *ir, codeblock_t *block)
 
     codegen_backend_epilogue(block);
     block_write_data = NULL;
+    codegen_ir_stats.code_bytes += ((codegen_allocator_usage - mem_blocks) * MEM_BLOCK_SIZE) + block_pos;
 #if 0
     if (has_ea)
         fatal("IR compilation complete\n");
@@ -1,6 +1,18 @@
+#include "codegen_public.h"
 #include "codegen_ir_defs.h"
 
 ir_data_t *codegen_ir_init(void);
 
 void codegen_ir_set_unroll(int count, int start, int first_instruction);
 void codegen_ir_compile(ir_data_t *ir, codeblock_t *block);
+
+/*Optimisation passes, run by codegen_ir_compile(). Setting the corresponding
+  bit in cpu_dynarec_ir_disable turns a pass off.*/
+#define CODEGEN_IR_PASS_CONST      (1 << 0) /*Constant folding and propagation*/
+#define CODEGEN_IR_PASS_DEAD_STORE (1 << 1) /*Dead flag/register store elimination*/
+#define CODEGEN_IR_PASS_FORWARD    (1 << 2) /*Redundant cpu_state store removal*/
+#define CODEGEN_IR_PASS_ALL        (CODEGEN_IR_PASS_CONST | CODEGEN_IR_PASS_DEAD_STORE | CODEGEN_IR_PASS_FORWARD)
+
+extern codegen_ir_stats_t codegen_ir_stats;
+
+void codegen_ir_optimise(ir_data_t *ir);
@@ -0,0 +1,393 @@
+/*IR optimisation passes
+
+  These run over the uOP list of a block after IR generation and dead register
+  processing, and before register allocation. Each pass can be disabled with
+  the cpu_dynarec_ir_disable bitmask (see CODEGEN_IR_PASS_*).
+
+  Register versions are only immutable between full barriers. A barrier uOP
+  may call an interpreter function that modifies emulated registers in
+  cpu_state directly, and later reads of the same version reload them from
+  there. Known constants are therefore forgotten at every full barrier, and at
+  every jump destination since the value may depend on the path taken.
+
+  A register version may only be removed if its value can not be observed
+  outside the block, ie it is superseded by a full-width write with no barrier
+  of either kind in between (order barriers may exit the block, which requires
+  cpu_state to be up to date).*/
+#include <stdint.h>
+#include <string.h>
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/mem.h>
+
+#include "codegen.h"
+#include "codegen_ir.h"
+#include "codegen_reg.h"
+
+codegen_ir_stats_t codegen_ir_stats;
+
+static uint8_t  const_valid[IREG_COUNT];
+static uint16_t const_version[IREG_COUNT];
+static uint32_t const_value[IREG_COUNT];
+
+static uint8_t  uop_is_jump_dest[UOP_NR_MAX + 1];
+static uint16_t barrier_count[UOP_NR_MAX + 1];
+
+static int
+ir_reg_const(ir_reg_t ir_reg, uint32_t *val)
+{
+    int reg = IREG_GET_REG(ir_reg.reg);
+
+    if (ir_reg_is_invalid(ir_reg) || !reg_is_dword(ir_reg))
+        return 0;
+    if (!const_valid[reg] || const_version[reg] != ir_reg.version)
+        return 0;
+
+    *val = const_value[reg];
+    return 1;
+}
+
+static void
+ir_reg_drop_read(ir_reg_t ir_reg)
+{
+    if (!ir_reg_is_invalid(ir_reg))
+        reg_version[IREG_GET_REG(ir_reg.reg)][ir_reg.version].refcount--;
+}
+
+static void
+uop_set_mov_imm(uop_t *uop, uint32_t imm_data)
+{
+    ir_reg_drop_read(uop->src_reg_a);
+    ir_reg_drop_read(uop->src_reg_b);
+    ir_reg_drop_read(uop->src_reg_c);
+
+    uop->type      = UOP_MOV_IMM;
+    uop->imm_data  = imm_data;
+    uop->src_reg_a = invalid_ir_reg;
+    uop->src_reg_b = invalid_ir_reg;
+    uop->src_reg_c = invalid_ir_reg;
+}
+
+static void
+uop_set_op_imm(uop_t *uop, uint32_t uop_type, ir_reg_t src_reg, uint32_t imm_data)
+{
+    /*src_reg is kept, the other source is replaced by the immediate*/
+    if (uop->src_reg_a.reg == src_reg.reg && uop->src_reg_a.version == src_reg.version)
+        ir_reg_drop_read(uop->src_reg_b);
+    else
+        ir_reg_drop_read(uop->src_reg_a);
+
+    uop->type      = uop_type;
+    uop->imm_data  = imm_data;
+    uop->src_reg_a = src_reg;
+    uop->src_reg_b = invalid_ir_reg;
+}
+
+/*Constant folding and propagation. Returns 1 if the uOP was changed.*/
+static int
+ir_fold_uop(uop_t *uop)
+{
+    uint32_t a;
+    uint32_t b;
+    int      a_const;
+    int      b_const;
+
+    if (!reg_is_dword(uop->src_reg_a))
+        return 0;
+    a_const = ir_reg_const(uop->src_reg_a, &a);
+
+    switch (uop->type) {
+        case UOP_MOV:
+            if (!a_const)
+                return 0;
+            uop_set_mov_imm(uop, a);
+            return 1;
+
+        case UOP_ADD_IMM:
+        case UOP_SUB_IMM:
+        case UOP_AND_IMM:
+        case UOP_OR_IMM:
+        case UOP_XOR_IMM:
+        case UOP_SHL_IMM:
+        case UOP_SHR_IMM:
+        case UOP_SAR_IMM:
+            if (!a_const)
+                return 0;
+            b = uop->imm_data;
+            switch (uop->type) {
+                case UOP_ADD_IMM:
+                    a += b;
+                    break;
+                case UOP_SUB_IMM:
+                    a -= b;
+                    break;
+                case UOP_AND_IMM:
+                    a &= b;
+                    break;
+                case UOP_OR_IMM:
+                    a |= b;
+                    break;
+                case UOP_XOR_IMM:
+                    a ^= b;
+                    break;
+                case UOP_SHL_IMM:
+                    if (b >= 32)
+                        return 0;
+                    a <<= b;
+                    break;
+                case UOP_SHR_IMM:
+                    if (b >= 32)
+                        return 0;
+                    a >>= b;
+                    break;
+                case UOP_SAR_IMM:
+                    if (b >= 32)
+                        return 0;
+                    a = (uint32_t) ((int32_t) a >> b);
+                    break;
+
+                default:
+                    break;
+            }
+            uop_set_mov_imm(uop, a);
+            return 1;
+
+        case UOP_ADD:
+        case UOP_SUB:
+        case UOP_AND:
+        case UOP_OR:
+        case UOP_XOR:
+            if (!reg_is_dword(uop->src_reg_b))
+                return 0;
+            b_const = ir_reg_const(uop->src_reg_b, &b);
+
+            if (a_const && b_const) {
+                switch (uop->type) {
+                    case UOP_ADD:
+                        a += b;
+                        break;
+                    case UOP_SUB:
+                        a -= b;
+                        break;
+                    case UOP_AND:
+                        a &= b;
+                        break;
+                    case UOP_OR:
+                        a |= b;
+                        break;
+                    case UOP_XOR:
+                        a ^= b;
+                        break;
+
+                    default:
+                        break;
+                }
+                uop_set_mov_imm(uop, a);
+                return 1;
+            }
+            if (b_const) {
+                static const uint32_t imm_type[] = {
+                    [UOP_ADD & 0xf] = UOP_ADD_IMM,
+                    [UOP_SUB & 0xf] = UOP_SUB_IMM,
+                    [UOP_AND & 0xf] = UOP_AND_IMM,
+                    [UOP_OR & 0xf]  = UOP_OR_IMM,
+                    [UOP_XOR & 0xf] = UOP_XOR_IMM
+                };
+
+                uop_set_op_imm(uop, imm_type[uop->type & 0xf], uop->src_reg_a, b);
+                return 1;
+            }
+            if (a_const && uop->type != UOP_SUB) {
+                /*Commutative, swap the constant into the immediate*/
+                static const uint32_t imm_type[] = {
+                    [UOP_ADD & 0xf] = UOP_ADD_IMM,
+                    [UOP_AND & 0xf] = UOP_AND_IMM,
+                    [UOP_OR & 0xf]  = UOP_OR_IMM,
+                    [UOP_XOR & 0xf] = UOP_XOR_IMM
+                };
+
+                uop_set_op_imm(uop, imm_type[uop->type & 0xf], uop->src_reg_b, a);
+                return 1;
+            }
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+/*Is the store of ir_reg to cpu_state unobservable, ie will it be replaced by a
+  full-width write before anything outside the block could see it ?*/
+static int
+ir_reg_store_is_dead(ir_data_t *ir, int reg, int version)
+{
+    const reg_version_t *regv = &reg_version[reg][version];
+    const reg_version_t *next;
+    const uop_t         *next_uop;
+    ir_reg_t             ir_reg = { .reg = reg, .version = version };
+
+    if (version == reg_last_version[reg])
+        return reg_is_volatile(ir_reg);
+
+    next = &reg_version[reg][version + 1];
+    if (next->flags & REG_FLAGS_DEAD)
+        return 0;
+    next_uop = &ir->uops[next->parent_uop];
+    /*Partial writes depend on the previous version*/
+    if (!reg_is_native_size(next_uop->dest_reg_a))
+        return 0;
+    if (reg_is_volatile(ir_reg))
+        return 1;
+
+    return barrier_count[next->parent_uop + 1] == barrier_count[regv->parent_uop + 1];
+}
+
+/*Can this write be dropped in favour of the previous version, which holds the
+  same value ? Unlike ir_reg_store_is_dead() barriers do not matter here, as the
+  previous version will be written back to cpu_state in place of this one.*/
+static int
+ir_store_is_redundant(ir_data_t *ir, ir_reg_t ir_reg)
+{
+    int                  reg = IREG_GET_REG(ir_reg.reg);
+    const reg_version_t *next;
+
+    /*Volatile registers are not written back once they have no readers*/
+    if (reg_version[reg][ir_reg.version].refcount || reg_is_volatile(ir_reg))
+        return 0;
+    if (ir_reg.version == reg_last_version[reg])
+        return 1;
+
+    next = &reg_version[reg][ir_reg.version + 1];
+    if (next->flags & REG_FLAGS_DEAD)
+        return 0;
+    /*Partial writes read back the version being removed*/
+    return reg_is_native_size(ir->uops[next->parent_uop].dest_reg_a);
+}
+
+static void
+ir_kill_uop(uop_t *uop)
+{
+    reg_version[IREG_GET_REG(uop->dest_reg_a.reg)][uop->dest_reg_a.version].flags |= REG_FLAGS_DEAD;
+    ir_reg_drop_read(uop->src_reg_a);
+    ir_reg_drop_read(uop->src_reg_b);
+    ir_reg_drop_read(uop->src_reg_c);
+    uop->type = UOP_INVALID;
+}
+
+/*Constant folding/propagation and redundant store forwarding*/
+static void
+ir_pass_const(ir_data_t *ir, int passes)
+{
+    memset(const_valid, 0, sizeof(const_valid));
+
+    for (int c = 0; c < ir->wr_pos; c++) {
+        uop_t *uop = &ir->uops[c];
+        int    reg;
+
+        if (uop_is_jump_dest[c] || (uop->type & UOP_TYPE_BARRIER))
+            memset(const_valid, 0, sizeof(const_valid));
+
+        if ((uop->type & UOP_MASK) == UOP_INVALID || ir_reg_is_invalid(uop->dest_reg_a))
+            continue;
+        reg = IREG_GET_REG(uop->dest_reg_a.reg);
+
+        if ((passes & CODEGEN_IR_PASS_CONST) && reg_is_dword(uop->dest_reg_a) && ir_fold_uop(uop))
+            codegen_ir_stats.folded++;
+
+        if (uop->type != UOP_MOV_IMM || !reg_is_dword(uop->dest_reg_a)) {
+            const_valid[reg] = 0;
+            continue;
+        }
+
+        if ((passes & CODEGEN_IR_PASS_FORWARD) && const_valid[reg] && const_value[reg] == uop->imm_data && const_version[reg] == uop->dest_reg_a.version - 1 && ir_store_is_redundant(ir, uop->dest_reg_a)) {
+            /*cpu_state (or the host register caching it) already holds this
+              value from the previous version, and nothing reads this one*/
+            ir_kill_uop(uop);
+            codegen_ir_stats.forwarded++;
+        }
+
+        const_valid[reg]   = 1;
+        const_version[reg] = uop->dest_reg_a.version;
+        const_value[reg]   = uop->imm_data;
+    }
+}
+
+/*Remove register versions that are never read and never observable. This
+  picks up flag and temporary writes orphaned by constant folding, and final
+  temporaries that the write-time dead list never sees.*/
+static void
+ir_pass_dead_store(ir_data_t *ir)
+{
+    int changed;
+
+    do {
+        changed = 0;
+
+        for (int reg = IREG_EBX + 1; reg < IREG_COUNT; reg++) {
+            for (int version = 1; version <= reg_last_version[reg]; version++) {
+                const reg_version_t *regv = &reg_version[reg][version];
+                uop_t               *uop  = &ir->uops[regv->parent_uop];
+
+                if (regv->refcount || (regv->flags & REG_FLAGS_DEAD))
+                    continue;
+                if ((uop->type & UOP_MASK) == UOP_INVALID || (uop->type & (UOP_TYPE_BARRIER | UOP_TYPE_ORDER_BARRIER | UOP_TYPE_JUMP)))
+                    continue;
+                if (IREG_GET_REG(uop->dest_reg_a.reg) != reg || uop->dest_reg_a.version != version)
+                    continue;
+
+                if (ir_reg_store_is_dead(ir, reg, version)) {
+                    ir_kill_uop(uop);
+                    codegen_ir_stats.dead_stores++;
+                    changed = 1;
+                }
+            }
+        }
+    } while (changed);
+}
+
+static int
+ir_count_uops(const ir_data_t *ir)
+{
+    int count = 0;
+
+    for (int c = 0; c < ir->wr_pos; c++) {
+        if ((ir->uops[c].type & UOP_MASK) != UOP_INVALID)
+            count++;
+    }
+
+    return count;
+}
+
+void
+codegen_ir_optimise(ir_data_t *ir)
+{
+    int passes = CODEGEN_IR_PASS_ALL & ~cpu_dynarec_ir_disable;
+
+    codegen_ir_stats.blocks++;
+    codegen_ir_stats.uops_in += ir_count_uops(ir);
+
+    if (passes) {
+        memset(uop_is_jump_dest, 0, ir->wr_pos + 1);
+        barrier_count[0] = 0;
+        for (int c = 0; c < ir->wr_pos; c++) {
+            const uop_t *uop = &ir->uops[c];
+
+            if ((uop->type & UOP_TYPE_JUMP) && uop->jump_dest_uop >= 0 && uop->jump_dest_uop <= ir->wr_pos)
+                uop_is_jump_dest[uop->jump_dest_uop] = 1;
+            barrier_count[c + 1] = barrier_count[c] + !!(uop->type & (UOP_TYPE_BARRIER | UOP_TYPE_ORDER_BARRIER));
+        }
+
+        if (passes & (CODEGEN_IR_PASS_CONST | CODEGEN_IR_PASS_FORWARD))
+            ir_pass_const(ir, passes);
+        if (passes & CODEGEN_IR_PASS_DEAD_STORE)
+            ir_pass_dead_store(ir);
+    }
+
+    codegen_ir_stats.uops_out += ir_count_uops(ir);
+}
+
+void
+codegen_ir_get_stats(codegen_ir_stats_t *stats)
+{
+    *stats = codegen_ir_stats;
+}
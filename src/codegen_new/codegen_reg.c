@@ -223,6 +223,19 @@ reg_is_native_size(ir_reg_t ir_reg)
     return 0;
 }
 
+int
+reg_is_volatile(ir_reg_t ir_reg)
+{
+    return ireg_data[IREG_GET_REG(ir_reg.reg)].is_volatile == REG_VOLATILE;
+}
+
+/*Full width access to a 32-bit integer register*/
+int
+reg_is_dword(ir_reg_t ir_reg)
+{
+    return !ir_reg_is_invalid(ir_reg) && ireg_data[IREG_GET_REG(ir_reg.reg)].native_size == REG_DWORD && IREG_GET_SIZE(ir_reg.reg) == IREG_SIZE_L;
+}
+
 void
 codegen_reg_reset(void)
 {
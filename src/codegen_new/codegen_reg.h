@@ -422,4 +422,7 @@ void codegen_reg_rename(codeblock_t *block, ir_reg_t src, ir_reg_t dst);
 
 void codegen_reg_mark_as_required(void);
 void codegen_reg_process_dead_list(struct ir_data_t *ir);
+
+int reg_is_volatile(ir_reg_t ir_reg);
+int reg_is_dword(ir_reg_t ir_reg);
 #endif
@@ -48,6 +48,7 @@
 #include <86box/isamem.h>
 #include <86box/isartc.h>
 #include <86box/lpt.h>
+#include <86box/printer.h>
 #include <86box/serial.h>
 #include <86box/hdd.h>
 #include <86box/hdc.h>
@@ -389,6 +390,7 @@ load_machine(void)
         mem_size = machine_get_max_ram(machine);
 
     cpu_use_dynarec = !!ini_section_get_int(cat, "cpu_use_dynarec", 0);
+    cpu_dynarec_ir_disable = ini_section_get_int(cat, "cpu_dynarec_ir_disable", 0);
     fpu_softfloat = !!ini_section_get_int(cat, "fpu_softfloat", 0);
     if ((fpu_type != FPU_NONE) && machine_has_flags(machine, MACHINE_SOFTFLOAT_ONLY))
         fpu_softfloat = 1;
@@ -732,6 +734,9 @@ load_network(void)
                                              (NET_LINK_10_HD | NET_LINK_10_FD |
                                               NET_LINK_100_HD | NET_LINK_100_FD |
                                               NET_LINK_1000_HD | NET_LINK_1000_FD));
+
+        sprintf(temp, "net_%02i_queue_len", c + 1);
+        nc->queue_len = ini_section_get_int(cat, temp, NET_QUEUE_LEN);
     }
 }
 
@@ -765,6 +770,8 @@ load_ports(void)
         p                   = ini_section_get_string(cat, temp, "none");
         lpt_ports[c].device = lpt_device_get_from_internal_name(p);
     }
+
+    escp_page_format = ini_section_get_int(cat, "escp_page_format", ESCP_PAGE_PNG);
 }
 
 /* Load "Storage Controllers" section. */
@@ -982,6 +989,17 @@ load_hard_disks(void)
         p                   = ini_section_get_string(cat, temp, tmp2);
         hdd[c].speed_preset = hdd_preset_get_from_internal_name(p);
 
+        /* I/O engine for raw, HDI and HDX images, ignored for VHD images and
+           on Windows:
+             stdio    - buffered seek + read/write (default);
+             pread    - one pread()/pwrite() per transfer, no libc buffering;
+             pread_ra - pread with a read-ahead window of 8 to 64 KiB that
+                        grows while the guest keeps reading sequentially.
+           Unknown values fall back to stdio. */
+        sprintf(temp, "hdd_%02i_io_engine", c + 1);
+        p                = ini_section_get_string(cat, temp, "stdio");
+        hdd[c].io_engine = hdd_io_engine_from_internal_name(p);
+
         /* MFM/RLL */
         sprintf(temp, "hdd_%02i_mfm_channel", c + 1);
         if (hdd[c].bus == HDD_BUS_MFM)
@@ -1971,6 +1989,10 @@ save_machine(void)
     ini_section_set_int(cat, "mem_size", mem_size);
 
     ini_section_set_int(cat, "cpu_use_dynarec", cpu_use_dynarec);
+    if (cpu_dynarec_ir_disable)
+        ini_section_set_int(cat, "cpu_dynarec_ir_disable", cpu_dynarec_ir_disable);
+    else
+        ini_section_delete_var(cat, "cpu_dynarec_ir_disable");
     ini_section_set_int(cat, "fpu_softfloat", fpu_softfloat);
 
     if (time_sync & TIME_SYNC_ENABLED)
@@ -2228,6 +2250,12 @@ save_network(void)
             ini_section_delete_var(cat, temp);
         else
             ini_section_set_int(cat, temp, nc->link_state);
+
+        sprintf(temp, "net_%02i_queue_len", c + 1);
+        if (nc->queue_len == NET_QUEUE_LEN)
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_int(cat, temp, nc->queue_len);
     }
 
     ini_delete_section_if_empty(config, cat);
@@ -2273,6 +2301,11 @@ save_ports(void)
                                    lpt_device_get_internal_name(lpt_ports[c].device));
     }
 
+    if (escp_page_format == ESCP_PAGE_PNG)
+        ini_section_delete_var(cat, "escp_page_format");
+    else
+        ini_section_set_int(cat, "escp_page_format", escp_page_format);
+
     ini_delete_section_if_empty(config, cat);
 }
 
@@ -2510,6 +2543,12 @@ save_hard_disks(void)
             ini_section_delete_var(cat, temp);
         else
             ini_section_set_string(cat, temp, hdd_preset_get_internal_name(hdd[c].speed_preset));
+
+        sprintf(temp, "hdd_%02i_io_engine", c + 1);
+        if (!hdd_is_valid(c) || (hdd[c].io_engine == HDD_IO_STDIO))
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_string(cat, temp, hdd_io_engine_get_internal_name(hdd[c].io_engine));
     }
 
     ini_delete_section_if_empty(config, cat);
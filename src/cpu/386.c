@@ -28,6 +28,7 @@
 #include <86box/machine.h>
 #include <86box/plat_fallthrough.h>
 #include <86box/gdbstub.h>
+#include <86box/instrument.h>
 #ifndef OPS_286_386
 #    define OPS_286_386
 #endif
@@ -290,6 +291,7 @@ exec386_2386(int32_t cycs)
                 if (opcode == 0xf0)
                     in_lock = 1;
                 x86_2386_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                instru_count(instru_ins);
                 sse_xmm = 0;
                 in_lock = 0;
                 if (x86_was_reset)
@@ -31,6 +31,7 @@
 #include <86box/machine.h>
 #include <86box/plat_fallthrough.h>
 #include <86box/gdbstub.h>
+#include <86box/instrument.h>
 #ifdef USE_DYNAREC
 #    include "codegen.h"
 #    ifdef USE_NEW_DYNAREC
@@ -275,6 +276,8 @@ exec386_dynarec_int(void)
     cpu_block_end = 0;
     x86_was_reset = 0;
 
+    instru_count(instru_blocks_interpreted);
+
 #    ifdef USE_DEBUG_REGS_486
     if (trap & 2) {
 #    else
@@ -324,6 +327,7 @@ exec386_dynarec_int(void)
             cpu_state.eflags &= ~(RF_FLAG);
 #    endif
             x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+            instru_count(instru_ins);
             sse_xmm = 0;
         }
 
@@ -519,6 +523,9 @@ exec386_dynarec_dyn(void)
 #    ifndef USE_NEW_DYNAREC
         codeblock_hash[hash] = block;
 #    endif
+        instru_count(instru_blocks_run);
+        instru_add(instru_ins, block->ins);
+
         inrecomp = 1;
         code();
 #    ifdef USE_ACYCS
@@ -548,6 +555,7 @@ exec386_dynarec_dyn(void)
 #    endif
         codegen_block_start_recompile(block);
         codegen_in_recompile = 1;
+        instru_count(instru_blocks_interpreted);
 
         while (!cpu_block_end) {
 #    ifndef USE_NEW_DYNAREC
@@ -575,6 +583,7 @@ exec386_dynarec_dyn(void)
                 codegen_generate_call(opcode, x86_opcodes[(opcode | cpu_state.op32) & 0x3ff], fetchdat, cpu_state.pc, cpu_state.pc - 1);
 
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                instru_count(instru_ins);
                 sse_xmm = 0;
                 is_repe = 0;
                 is_repne = 0;
@@ -651,6 +660,7 @@ exec386_dynarec_dyn(void)
         x86_was_reset = 0;
 
         codegen_block_init(phys_addr);
+        instru_count(instru_blocks_interpreted);
 
         while (!cpu_block_end) {
 #    ifndef USE_NEW_DYNAREC
@@ -678,6 +688,7 @@ exec386_dynarec_dyn(void)
                 cpu_state.pc++;
 
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                instru_count(instru_ins);
                 sse_xmm = 0;
 
                 if (x86_was_reset)
@@ -930,6 +941,7 @@ exec386(int32_t cycs)
                 cpu_state.eflags &= ~(RF_FLAG);
 #endif
                 x86_opcodes[(opcode | cpu_state.op32) & 0x3ff](fetchdat);
+                instru_count(instru_ins);
                 if (x86_was_reset)
                     break;
             }
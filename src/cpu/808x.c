@@ -32,6 +32,7 @@
 #include <86box/rom.h>
 #include <86box/nmi.h>
 #include <86box/pic.h>
+#include <86box/instrument.h>
 #include <86box/ppi.h>
 #include <86box/timer.h>
 #include <86box/gdbstub.h>
@@ -1683,6 +1684,7 @@ execx86(int cycs)
         if (!repeating) {
             cpu_state.oldpc = cpu_state.pc;
             opcode          = pfq_fetchb();
+            instru_count(instru_ins);
             handled         = 0;
             oldc            = cpu_state.flags & C_FLAG;
             if (clear_lock) {
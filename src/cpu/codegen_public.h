@@ -52,6 +52,20 @@
 extern void codegen_init(void);
 extern void codegen_flush(void);
 
+#ifdef USE_NEW_DYNAREC
+typedef struct codegen_ir_stats_t {
+    uint64_t blocks;      /*Blocks compiled*/
+    uint64_t uops_in;     /*uOPs before optimisation*/
+    uint64_t uops_out;    /*uOPs after optimisation*/
+    uint64_t folded;      /*uOPs folded to a constant or an immediate form*/
+    uint64_t dead_stores; /*Unobservable register writes removed*/
+    uint64_t forwarded;   /*Writes of an unchanged constant removed*/
+    uint64_t code_bytes;  /*Host code generated*/
+} codegen_ir_stats_t;
+
+extern void codegen_ir_get_stats(codegen_ir_stats_t *stats);
+#endif
+
 /*Current physical page of block being recompiled. -1 if no recompilation taking place */
 extern uint32_t recomp_page;
 extern int      codegen_in_recompile;
@@ -206,7 +206,7 @@ opMOV_CRx_r_a16(uint32_t fetchdat)
             break;
         case 3:
             cr3 = cpu_state.regs[cpu_rm].l;
-            flushmmucache();
+            flushmmucache_nonglobal();
             break;
         case 4:
             if (cpu_has_feature(CPU_FEATURE_CR4)) {
@@ -263,7 +263,7 @@ opMOV_CRx_r_a32(uint32_t fetchdat)
             break;
         case 3:
             cr3 = cpu_state.regs[cpu_rm].l;
-            flushmmucache();
+            flushmmucache_nonglobal();
             break;
         case 4:
             if (cpu_has_feature(CPU_FEATURE_CR4)) {
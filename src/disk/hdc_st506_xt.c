@@ -1823,7 +1823,7 @@ st506_close(void *priv)
     }
 
     if (dev->bios_rom.rom != NULL) {
-        free(dev->bios_rom.rom);
+        rom_free(dev->bios_rom.rom);
         dev->bios_rom.rom = NULL;
     }
 
@@ -26,6 +26,9 @@
 #include <time.h>
 #include <wchar.h>
 #include <errno.h>
+#ifndef _WIN32
+#    include <unistd.h>
+#endif
 #define HAVE_STDARG_H
 #include <86box/86box.h>
 #include <86box/path.h>
@@ -40,6 +43,15 @@
 #define HDD_IMAGE_HDX 2
 #define HDD_IMAGE_VHD 3
 
+/* Size of the read-ahead window, in sectors. The window starts small and
+   doubles every time a stream runs past it, so a short sequential run does
+   not pay for a large synchronous read. */
+#define HDD_IMAGE_RA_MIN_SECTORS 16
+#define HDD_IMAGE_RA_SECTORS     128
+
+/* Largest single write issued when zeroing sectors. */
+#define HDD_IMAGE_ZERO_SECTORS 128
+
 typedef struct hdd_image_t {
     FILE     *file; /* Used for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */
     MVHDMeta *vhd;  /* Used for HDD_IMAGE_VHD. */
@@ -48,12 +60,34 @@ typedef struct hdd_image_t {
     uint32_t  last_sector;
     uint8_t   type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, or HDD_IMAGE_VHD */
     uint8_t   loaded;
+    uint8_t   engine; /* HDD_IO_STDIO, HDD_IO_PREAD, or HDD_IO_PREAD_RA */
+
+    /* Positional I/O engine. */
+    int       fd;
+    uint8_t  *ra_buf;
+    uint32_t  ra_start; /* First sector held in ra_buf. */
+    uint32_t  ra_count; /* Number of valid sectors in ra_buf. */
+    uint32_t  ra_window; /* Sectors the next window fill will read. */
+    uint32_t  next_sector; /* Sector following the last read, for detecting streams. */
 } hdd_image_t;
 
+static const struct {
+    const char *internal_name;
+    int         engine;
+} hdd_io_engines[] = {
+    { "stdio",    HDD_IO_STDIO    },
+    { "pread",    HDD_IO_PREAD    },
+    { "pread_ra", HDD_IO_PREAD_RA },
+    { NULL,       0               }
+};
+
 hdd_image_t hdd_images[HDD_NUM];
 
 static char  empty_sector[512];
 static char *empty_sector_1mb;
+#ifndef _WIN32
+static const uint8_t zero_sectors[HDD_IMAGE_ZERO_SECTORS << 9];
+#endif
 
 #ifdef ENABLE_HDD_IMAGE_LOG
 int hdd_image_do_log = ENABLE_HDD_IMAGE_LOG;
@@ -232,6 +266,169 @@ hdd_image_init(void)
         memset(&hdd_images[i], 0, sizeof(hdd_image_t));
 }
 
+int
+hdd_io_engine_from_internal_name(const char *s)
+{
+    for (int i = 0; hdd_io_engines[i].internal_name != NULL; i++) {
+        if (!strcmp(hdd_io_engines[i].internal_name, s))
+            return hdd_io_engines[i].engine;
+    }
+
+    return HDD_IO_STDIO;
+}
+
+const char *
+hdd_io_engine_get_internal_name(int engine)
+{
+    for (int i = 0; hdd_io_engines[i].internal_name != NULL; i++) {
+        if (hdd_io_engines[i].engine == engine)
+            return hdd_io_engines[i].internal_name;
+    }
+
+    return hdd_io_engines[0].internal_name;
+}
+
+static void
+hdd_image_close_file(uint8_t id)
+{
+    if (hdd_images[id].file != NULL) {
+        fclose(hdd_images[id].file);
+        hdd_images[id].file = NULL;
+    } else if (hdd_images[id].vhd != NULL) {
+        mvhd_close(hdd_images[id].vhd);
+        hdd_images[id].vhd = NULL;
+    }
+
+    if (hdd_images[id].ra_buf != NULL) {
+        free(hdd_images[id].ra_buf);
+        hdd_images[id].ra_buf = NULL;
+    }
+    hdd_images[id].ra_count = 0;
+    hdd_images[id].engine   = HDD_IO_STDIO;
+}
+
+/* Switch a raw, HDI, or HDX image over to the configured I/O engine, once
+   the header and the image size have been taken care of through stdio. */
+static void
+hdd_image_set_engine(uint8_t id)
+{
+    hdd_images[id].engine      = HDD_IO_STDIO;
+    hdd_images[id].ra_count    = 0;
+    hdd_images[id].ra_window   = HDD_IMAGE_RA_MIN_SECTORS;
+    hdd_images[id].next_sector = 0;
+
+#ifndef _WIN32
+    if ((hdd_images[id].file == NULL) || (hdd[id].io_engine == HDD_IO_STDIO))
+        return;
+
+    fflush(hdd_images[id].file);
+    hdd_images[id].fd = fileno(hdd_images[id].file);
+    if (hdd_images[id].fd == -1)
+        return;
+
+    if (hdd[id].io_engine == HDD_IO_PREAD_RA) {
+        hdd_images[id].ra_buf = (uint8_t *) malloc(HDD_IMAGE_RA_SECTORS << 9);
+        if (hdd_images[id].ra_buf == NULL)
+            return;
+    }
+
+    hdd_images[id].engine = hdd[id].io_engine;
+    hdd_image_log("HDD %i: Using the %s I/O engine\n", id, hdd_io_engine_get_internal_name(hdd_images[id].engine));
+#endif
+}
+
+#ifndef _WIN32
+/* Positional read/write of whole sectors, returns the number of sectors transferred. */
+static uint32_t
+hdd_image_pio(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer, int write)
+{
+    off_t   offset = ((off_t) sector << 9) + hdd_images[id].base;
+    size_t  size   = (size_t) count << 9;
+    size_t  done   = 0;
+    ssize_t ret;
+
+    while (done < size) {
+        if (write)
+            ret = pwrite(hdd_images[id].fd, buffer + done, size - done, offset + done);
+        else
+            ret = pread(hdd_images[id].fd, buffer + done, size - done, offset + done);
+
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        } else if (ret == 0)
+            break;
+
+        done += ret;
+    }
+
+    return (uint32_t) (done >> 9);
+}
+
+static uint32_t
+hdd_image_pread(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+    uint32_t     ra_sectors;
+    uint32_t     num_read;
+
+    if (img->engine == HDD_IO_PREAD_RA) {
+        /* Serve the request from the read-ahead window if it is fully there. */
+        if (img->ra_count && (sector >= img->ra_start) &&
+            ((sector - img->ra_start) + (uint64_t) count <= img->ra_count)) {
+            memcpy(buffer, img->ra_buf + ((sector - img->ra_start) << 9), count << 9);
+            img->next_sector = sector + count;
+            return count;
+        }
+
+        /* A request continuing the previous one starts a new window, and
+           a stream that has already used up a window gets a larger one. A
+           request that does not continue the stream resets the window. */
+        if (sector != img->next_sector)
+            img->ra_window = HDD_IMAGE_RA_MIN_SECTORS;
+        else if (count < img->ra_window) {
+            ra_sectors = img->ra_window;
+            if (sector > img->last_sector)
+                ra_sectors = 0;
+            else if ((img->last_sector - sector + 1) < ra_sectors)
+                ra_sectors = img->last_sector - sector + 1;
+
+            if (ra_sectors >= count) {
+                img->ra_start = sector;
+                img->ra_count = hdd_image_pio(id, sector, ra_sectors, img->ra_buf, 0);
+
+                if (img->ra_window < HDD_IMAGE_RA_SECTORS)
+                    img->ra_window <<= 1;
+
+                num_read = (img->ra_count < count) ? img->ra_count : count;
+                memcpy(buffer, img->ra_buf, num_read << 9);
+                img->next_sector = sector + num_read;
+                return num_read;
+            }
+        }
+    }
+
+    num_read         = hdd_image_pio(id, sector, count, buffer, 0);
+    img->next_sector = sector + num_read;
+
+    return num_read;
+}
+
+static uint32_t
+hdd_image_pwrite(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    /* Drop the read-ahead window if the write overlaps it. */
+    if (img->ra_count && ((uint64_t) sector < ((uint64_t) img->ra_start + img->ra_count)) &&
+        (((uint64_t) sector + count) > img->ra_start))
+        img->ra_count = 0;
+
+    return hdd_image_pio(id, sector, count, buffer, 1);
+}
+#endif
+
 int
 hdd_image_load(int id)
 {
@@ -257,13 +454,7 @@ hdd_image_load(int id)
     hdd_images[id].base = 0;
 
     if (hdd_images[id].loaded) {
-        if (hdd_images[id].file) {
-            fclose(hdd_images[id].file);
-            hdd_images[id].file = NULL;
-        } else if (hdd_images[id].vhd) {
-            mvhd_close(hdd_images[id].vhd);
-            hdd_images[id].vhd = NULL;
-        }
+        hdd_image_close_file(id);
         hdd_images[id].loaded = 0;
     }
 
@@ -484,6 +675,9 @@ retry_vhd:
         ret                        = 1;
     }
 
+    if (ret)
+        hdd_image_set_engine(id);
+
     return ret;
 }
 
@@ -509,6 +703,11 @@ hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     if (hdd_images[id].type == HDD_IMAGE_VHD) {
         non_transferred_sectors = mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
         hdd_images[id].pos      = sector + count - non_transferred_sectors - 1;
+#ifndef _WIN32
+    } else if (hdd_images[id].engine != HDD_IO_STDIO) {
+        num_read           = hdd_image_pread(id, sector, count, buffer);
+        hdd_images[id].pos = sector + num_read;
+#endif
     } else {
         if (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1) {
             fatal("Hard disk image %i: Read error during seek\n", id);
@@ -557,6 +756,11 @@ hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     if (hdd_images[id].type == HDD_IMAGE_VHD) {
         non_transferred_sectors = mvhd_write_sectors(hdd_images[id].vhd, sector, count, buffer);
         hdd_images[id].pos      = sector + count - non_transferred_sectors - 1;
+#ifndef _WIN32
+    } else if (hdd_images[id].engine != HDD_IO_STDIO) {
+        num_write          = hdd_image_pwrite(id, sector, count, buffer);
+        hdd_images[id].pos = sector + num_write;
+#endif
     } else {
         if (fseeko64(hdd_images[id].file, ((uint64_t) (sector) << 9LL) + hdd_images[id].base, SEEK_SET) == -1) {
             fatal("Hard disk image %i: Write error during seek\n", id);
@@ -590,6 +794,24 @@ hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
     if (hdd_images[id].type == HDD_IMAGE_VHD) {
         int non_transferred_sectors = mvhd_format_sectors(hdd_images[id].vhd, sector, count);
         hdd_images[id].pos          = sector + count - non_transferred_sectors - 1;
+#ifndef _WIN32
+    } else if (hdd_images[id].engine != HDD_IO_STDIO) {
+        uint32_t i = 0;
+        uint32_t len;
+        uint32_t num_write;
+
+        while (i < count) {
+            len       = MIN(count - i, HDD_IMAGE_ZERO_SECTORS);
+            num_write = hdd_image_pwrite(id, sector + i, len, (uint8_t *) zero_sectors);
+
+            i += num_write;
+            if (num_write != len)
+                break;
+        }
+
+        if (i > 0)
+            hdd_images[id].pos = sector + i - 1;
+#endif
     } else {
         memset(empty_sector, 0, 512);
 
@@ -643,13 +865,7 @@ hdd_image_unload(uint8_t id, UNUSED(int fn_preserve))
         return;
 
     if (hdd_images[id].loaded) {
-        if (hdd_images[id].file != NULL) {
-            fclose(hdd_images[id].file);
-            hdd_images[id].file = NULL;
-        } else if (hdd_images[id].vhd != NULL) {
-            mvhd_close(hdd_images[id].vhd);
-            hdd_images[id].vhd = NULL;
-        }
+        hdd_image_close_file(id);
         hdd_images[id].loaded = 0;
     }
 
@@ -666,13 +882,7 @@ hdd_image_close(uint8_t id)
     if (!hdd_images[id].loaded)
         return;
 
-    if (hdd_images[id].file != NULL) {
-        fclose(hdd_images[id].file);
-        hdd_images[id].file = NULL;
-    } else if (hdd_images[id].vhd != NULL) {
-        mvhd_close(hdd_images[id].vhd);
-        hdd_images[id].vhd = NULL;
-    }
+    hdd_image_close_file(id);
 
     memset(&hdd_images[id], 0, sizeof(hdd_image_t));
     hdd_images[id].loaded = 0;
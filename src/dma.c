@@ -1868,15 +1868,26 @@ dma_bm_read(uint32_t PhysAddress, uint8_t *DataRead, uint32_t TotalSize, int Tra
 {
     uint32_t n;
     uint32_t n2;
+    uint32_t run;
+    uint8_t *p;
     uint8_t  bytes[4] = { 0, 0, 0, 0 };
 
     n  = TotalSize & ~(TransferSize - 1);
     n2 = TotalSize - n;
 
-    /* Do the divisible block, if there is one. */
-    if (n) {
-        for (uint32_t i = 0; i < n; i += TransferSize)
+    /* Do the divisible block, if there is one. Runs of plain RAM are
+       copied in one go, anything else a transfer at a time. */
+    for (uint32_t i = 0; i < n; i += run) {
+        p = mem_phys_ram_run(PhysAddress + i, n - i, 0, &run);
+        if (run < (n - i))
+            run &= ~(TransferSize - 1);
+
+        if ((p != NULL) && run)
+            memcpy(&(DataRead[i]), p, run);
+        else {
             mem_read_phys((void *) &(DataRead[i]), PhysAddress + i, TransferSize);
+            run = TransferSize;
+        }
     }
 
     /* Do the non-divisible block, if there is one. */
@@ -1891,15 +1902,26 @@ dma_bm_write(uint32_t PhysAddress, const uint8_t *DataWrite, uint32_t TotalSize,
 {
     uint32_t n;
     uint32_t n2;
+    uint32_t run;
+    uint8_t *p;
     uint8_t  bytes[4] = { 0, 0, 0, 0 };
 
     n  = TotalSize & ~(TransferSize - 1);
     n2 = TotalSize - n;
 
-    /* Do the divisible block, if there is one. */
-    if (n) {
-        for (uint32_t i = 0; i < n; i += TransferSize)
+    /* Do the divisible block, if there is one. Runs of plain RAM are
+       copied in one go, anything else a transfer at a time. */
+    for (uint32_t i = 0; i < n; i += run) {
+        p = mem_phys_ram_run(PhysAddress + i, n - i, 1, &run);
+        if (run < (n - i))
+            run &= ~(TransferSize - 1);
+
+        if ((p != NULL) && run)
+            memcpy(p, &(DataWrite[i]), run);
+        else {
             mem_write_phys((void *) &(DataWrite[i]), PhysAddress + i, TransferSize);
+            run = TransferSize;
+        }
     }
 
     /* Do the non-divisible block, if there is one. */
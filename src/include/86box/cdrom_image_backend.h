@@ -95,6 +95,9 @@ extern int  cdi_is_mode2(cd_img_t *cdi, uint32_t sector);
 extern int  cdi_get_mode2_form(cd_img_t *cdi, uint32_t sector);
 extern int  cdi_load_iso(cd_img_t *cdi, const char *filename);
 extern int  cdi_load_cue(cd_img_t *cdi, const char *cuefile);
+#ifdef USE_CHD
+extern int  cdi_load_chd(cd_img_t *cdi, const char *filename);
+#endif
 extern int  cdi_has_data_track(cd_img_t *cdi);
 extern int  cdi_has_audio_track(cd_img_t *cdi);
 
@@ -104,4 +107,11 @@ extern uint64_t      viso_get_length(void *priv);
 extern void          viso_close(void *priv);
 extern track_file_t *viso_init(const char *dirname, int *error);
 
+#ifdef USE_CHD
+/* CHD image functions. */
+extern track_file_t *chd_image_init(const char *filename, int *error);
+extern int           chd_image_get_tracks_num(track_file_t *tf);
+extern int           chd_image_get_track(track_file_t *tf, int track, track_t *trk);
+#endif
+
 #endif /*CDROM_IMAGE_BACKEND_H*/
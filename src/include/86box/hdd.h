@@ -84,6 +84,12 @@ enum {
     HDD_OP_WRITE = 3
 };
 
+enum {
+    HDD_IO_STDIO    = 0, /* Buffered stdio, seek + read/write. */
+    HDD_IO_PREAD    = 1, /* Positional pread()/pwrite(). */
+    HDD_IO_PREAD_RA = 2  /* Positional I/O with sequential read-ahead. */
+};
+
 #define HDD_MAX_ZONES     16
 #define HDD_MAX_CACHE_SEG 16
 
@@ -180,6 +186,7 @@ typedef struct hard_disk_t {
 
     uint32_t speed_preset;
     uint32_t vhd_blocksize;
+    uint32_t io_engine; /* HDD_IO_*, ignored for VHD images. */
 
     double avg_rotation_lat_usec;
     double full_stroke_usec;
@@ -224,4 +231,7 @@ extern const char *hdd_preset_get_internal_name(int preset);
 extern int         hdd_preset_get_from_internal_name(char *s);
 extern void        hdd_preset_apply(int hdd_id);
 
+extern const char *hdd_io_engine_get_internal_name(int engine);
+extern int         hdd_io_engine_from_internal_name(const char *s);
+
 #endif /*EMU_HDD_H*/
@@ -0,0 +1,63 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the benchmark instrumentation.
+ *
+ *
+ *
+ * Authors: Miran Grca, <mgrca8@gmail.com>
+ *
+ *          Copyright 2016-2025 Miran Grca.
+ */
+#ifndef EMU_INSTRUMENT_H
+#define EMU_INSTRUMENT_H
+
+#ifdef USE_INSTRUMENT
+
+enum {
+    INSTRU_STOP_NONE = 0,
+    INSTRU_STOP_TIME,
+    INSTRU_STOP_MARKER,
+    INSTRU_STOP_USER
+};
+
+extern char     instru_out_path[1024];
+extern int      instru_marker_port;
+extern int      instru_stop_reason;
+
+extern uint64_t instru_ins;
+extern uint64_t instru_timer_callbacks;
+extern uint64_t instru_blocks_run;
+extern uint64_t instru_blocks_interpreted;
+extern uint64_t instru_tlb_fills;
+extern uint64_t instru_tlb_flushes;
+extern uint64_t instru_tlb_cr3_flushes;
+extern uint64_t instru_tlb_cr3_invalidated;
+extern uint32_t instru_io_reads[65536];
+extern uint32_t instru_io_writes[65536];
+
+#    ifdef __cplusplus
+extern "C" {
+#    endif
+
+extern void instru_io_write(uint16_t port);
+extern int  instru_frame(uint64_t host_us);
+extern void instru_report(void);
+
+#    ifdef __cplusplus
+}
+#    endif
+
+#    define instru_count(x)  (x)++
+#    define instru_add(x, n) (x) += (n)
+#else
+#    define instru_count(x)
+#    define instru_add(x, n)
+#endif
+
+#endif /*EMU_INSTRUMENT_H*/
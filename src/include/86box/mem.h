@@ -134,6 +134,9 @@
 #define MEM_GRANULARITY_PAGE   (MEM_GRANULARITY_MASK & ~0xfff)
 #define MEM_GRANULARITY_BASE   (~MEM_GRANULARITY_MASK)
 
+/* Number of pages the software TLB keeps track of, must be a power of 2. */
+#define MMU_TLB_SIZE 1024
+
 /* Compatibility #defines. */
 #define mem_set_state(smm, mode, base, size, access) \
     mem_set_access((smm ? ACCESS_SMM : ACCESS_NORMAL), mode, base, size, access)
@@ -263,12 +266,12 @@ extern uint8_t *rom;
 extern uint32_t biosmask;
 extern uint32_t biosaddr;
 
-extern int        readlookup[256];
+extern int        readlookup[MMU_TLB_SIZE];
 extern uintptr_t *readlookup2;
 extern uintptr_t  old_rl2;
 extern uint8_t    uncached;
 extern int        readlnext;
-extern int        writelookup[256];
+extern int        writelookup[MMU_TLB_SIZE];
 extern uintptr_t *writelookup2;
 extern int        writelnext;
 extern uint32_t   ram_mapped_addr[64];
@@ -300,6 +303,7 @@ extern int writelnum;
 extern int memspeed[11];
 
 extern int     mmu_perm;
+extern int     mmu_global;
 extern uint8_t high_page; /* if a high (> 4 gb) page was detected */
 
 extern uint8_t *_mem_exec[MEM_MAPPINGS_NO];
@@ -417,6 +421,7 @@ extern void     mem_writeb_phys(uint32_t addr, uint8_t val);
 extern void     mem_writew_phys(uint32_t addr, uint16_t val);
 extern void     mem_writel_phys(uint32_t addr, uint32_t val);
 extern void     mem_write_phys(void *src, uint32_t addr, int tranfer_size);
+extern uint8_t *mem_phys_ram_run(uint32_t addr, uint32_t size, int write, uint32_t *len);
 
 extern uint8_t  mem_read_ram(uint32_t addr, void *priv);
 extern uint16_t mem_read_ramw(uint32_t addr, void *priv);
@@ -446,6 +451,7 @@ extern void mem_flush_write_page(uint32_t addr, uint32_t virt);
 extern void mem_reset_page_blocks(void);
 
 extern void flushmmucache(void);
+extern void flushmmucache_nonglobal(void);
 extern void flushmmucache_nopc(void);
 
 extern void mem_debug_check_addr(uint32_t addr, int write);
@@ -55,8 +55,10 @@
 
 #define NET_MAX_FRAME  1518
 /* Queue size must be a power of 2 */
-#define NET_QUEUE_LEN      16
-#define NET_QUEUE_LEN_MASK (NET_QUEUE_LEN - 1)
+#define NET_QUEUE_LEN      64
+#define NET_QUEUE_LEN_MIN  16
+#define NET_QUEUE_LEN_MAX  4096
+#define NET_PKT_BATCH      16 /* Packets a host backend moves per wakeup */
 #define NET_QUEUE_COUNT 3
 #define NET_CARD_MAX       4
 #define NET_HOST_INTF_MAX  64
@@ -94,6 +96,7 @@ typedef struct netcard_conf_t {
     int      net_type;
     char     host_dev_name[128];
     uint32_t link_state;
+    int      queue_len;
 } netcard_conf_t;
 
 extern netcard_conf_t net_cards_conf[NET_CARD_MAX];
@@ -107,11 +110,8 @@ typedef struct netpkt {
     int      len;
 } netpkt_t;
 
-typedef struct netqueue_t {
-    netpkt_t packets[NET_QUEUE_LEN];
-    int      head;
-    int      tail;
-} netqueue_t;
+/* Single-producer, single-consumer packet ring, see network.c. */
+typedef struct netqueue_t netqueue_t;
 
 typedef struct _netcard_t netcard_t;
 
@@ -133,14 +133,14 @@ struct _netcard_t {
     struct netdrv_t host_drv;
     NETRXCB         rx;
     NETSETLINKSTATE set_link_state;
-    netqueue_t      queues[NET_QUEUE_COUNT];
+    netqueue_t     *queues[NET_QUEUE_COUNT];
     netpkt_t        queued_pkt;
-    mutex_t        *tx_mutex;
-    mutex_t        *rx_mutex;
+    mutex_t        *rx_mutex; /* Serializes producers of the RX queue. */
     pc_timer_t      timer;
     uint16_t        card_num;
     double          byte_period;
     uint32_t        led_timer;
+    uint8_t         led_wait; /* Timer is only armed to turn the LED off. */
     uint32_t        led_state;
     uint32_t        link_state;
 };
@@ -179,6 +179,7 @@ extern void       network_close(void);
 extern void       network_reset(void);
 extern int        network_available(void);
 extern void       network_tx(netcard_t *card, uint8_t *, int);
+extern void       network_poll(void);
 
 extern int net_pcap_prepare(netdev_t *);
 extern int net_vde_prepare(void);
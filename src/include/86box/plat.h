@@ -132,6 +132,14 @@ extern int kbd_req_capture;
 extern int hide_status_bar;
 extern int hide_tool_bar;
 
+/* Host memory use of this process, for dense multi-VM hosting. */
+typedef struct plat_mem_stats_t {
+    uint64_t rss;          /* resident set, in bytes */
+    uint64_t peak_rss;     /* largest resident set, in bytes */
+    uint64_t minor_faults; /* page faults served without I/O */
+    uint64_t major_faults; /* page faults that had to read from disk */
+} plat_mem_stats_t;
+
 /* System-related functions. */
 extern FILE    *plat_fopen(const char *path, const char *mode);
 extern FILE    *plat_fopen64(const char *path, const char *mode);
@@ -148,6 +156,8 @@ extern int      plat_dir_check(char *path);
 extern int      plat_dir_create(char *path);
 extern void    *plat_mmap(size_t size, uint8_t executable);
 extern void     plat_munmap(void *ptr, size_t size);
+extern int      plat_mmap_file(void *ptr, size_t size, const char *path, uint64_t offset);
+extern void     plat_get_mem_stats(plat_mem_stats_t *stats);
 extern uint64_t plat_timer_read(void);
 extern uint32_t plat_get_ticks(void);
 extern void     plat_delay_ms(uint32_t count);
@@ -59,4 +59,11 @@
 extern void
 select_codepage(uint16_t code, uint16_t *curmap);
 
+/* Page image formats of the ESC/P printer. */
+#define ESCP_PAGE_PNG      0 /* compressed PNG */
+#define ESCP_PAGE_PNG_FAST 1 /* uncompressed PNG */
+#define ESCP_PAGE_PBM      2 /* PBM, PNG for pages with color on them */
+
+extern int escp_page_format;
+
 #endif /*PRINTER_H*/
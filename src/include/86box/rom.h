@@ -45,6 +45,7 @@ typedef struct rom_path_t {
 } rom_path_t;
 
 extern rom_path_t rom_paths;
+extern uint32_t   rom_index_generation;
 
 extern void rom_add_path(const char *path);
 
@@ -55,6 +56,7 @@ extern uint32_t rom_readl(uint32_t addr, void *priv);
 extern FILE *rom_fopen(const char *fn, char *mode);
 extern int   rom_getfile(char *fn, char *s, int size);
 extern int   rom_present(const char *fn);
+extern void  rom_free(uint8_t *ptr);
 
 extern int rom_load_linear_oddeven(const char *fn, uint32_t addr, int sz,
                                    int off, uint8_t *ptr);
@@ -398,13 +398,16 @@ typedef struct emu8k_t {
     int32_t buffer[WTBUFLEN * 2];
 
     uint16_t addr;
+
+    struct emu8k_worker_t *worker;
 } emu8k_t;
 
 void emu8k_change_addr(emu8k_t *emu8k, uint16_t emu_addr);
-void emu8k_init(emu8k_t *emu8k, uint16_t emu_addr, int onboard_ram);
+void emu8k_init(emu8k_t *emu8k, uint16_t emu_addr, int onboard_ram, int threaded);
 void emu8k_close(emu8k_t *emu8k);
 
-void emu8k_update(emu8k_t *emu8k);
+void           emu8k_update(emu8k_t *emu8k);
+const int32_t *emu8k_get_buffer(emu8k_t *emu8k);
 
 #define EMU8K_ROM_PATH "roms/sound/creative/awe32.raw"
 
@@ -92,12 +92,18 @@ extern void        sound_card_init(void);
 extern void        sound_set_cd_volume(unsigned int vol_l, unsigned int vol_r);
 
 extern void sound_speed_changed(void);
+extern void sound_poll_get_ts(uint64_t *next, uint64_t *period);
 
 extern void sound_init(void);
 extern void sound_reset(void);
 
 extern void sound_card_reset(void);
 
+extern void sound_mix_int32_to_int16(int16_t *dst, const int32_t *src, int len);
+extern void sound_mix_int32_to_float(float *dst, const int32_t *src, int len);
+extern void sound_mix_float_to_int16(int16_t *dst, const float *src, int len);
+extern void sound_mix_float_to_float(float *dst, const float *src, int len);
+
 extern void sound_cd_thread_end(void);
 extern void sound_cd_thread_reset(void);
 
@@ -369,6 +369,7 @@ enum {
 };
 
 uint32_t svga_lookup_lut_ram(svga_t* svga, uint32_t val);
+uint32_t svga_conv_16to32(struct svga_t *svga, uint16_t color, uint8_t bpp);
 
 /* We need a way to add a device with a pointer to a parent device so it can attach itself to it, and
    possibly also a second ATi 68860 RAM DAC type that auto-sets SVGA render on RAM DAC render change. */
@@ -38,6 +38,18 @@ extern uint8_t egaremap2bpp[256];
 
 extern void svga_recalc_remap_func(svga_t *svga);
 
+/* Whole-line converters from contiguous VRAM, see vid_svga_render_simd.c. */
+typedef struct svga_line_funcs_t {
+    void (*conv_15to32)(uint32_t *dst, const uint8_t *src, int pixels);
+    void (*conv_16to32)(uint32_t *dst, const uint8_t *src, int pixels);
+    void (*conv_24to32)(uint32_t *dst, const uint8_t *src, int pixels);
+    void (*conv_32to32)(uint32_t *dst, const uint8_t *src, int pixels);
+} svga_line_funcs_t;
+
+extern svga_line_funcs_t svga_line_funcs;
+
+extern void svga_render_line_init(void);
+
 extern void svga_render_null(svga_t *svga);
 extern void svga_render_blank(svga_t *svga);
 extern void svga_render_overscan_left(svga_t *svga);
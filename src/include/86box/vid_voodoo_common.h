@@ -30,7 +30,9 @@
 
 #define TEX_DIRTY_SHIFT 10
 
-#define TEX_CACHE_MAX   64
+#define TEX_CACHE_MAX   64  /* default number of cached textures per TMU */
+#define TEX_CACHE_LIMIT 512
+#define TEX_CACHE_HASH  256
 
 #ifdef __cplusplus
 #    include <atomic>
@@ -104,6 +106,8 @@ enum {
 #define PARAM_FULL(x)    ((voodoo->params_write_idx - voodoo->params_read_idx[x]) >= PARAM_SIZE)
 #define PARAM_EMPTY(x)   (voodoo->params_read_idx[x] == voodoo->params_write_idx)
 
+#define VOODOO_RENDER_THREADS_MAX 16
+
 typedef struct
 {
     uint32_t addr_type;
@@ -234,14 +238,34 @@ typedef struct texture_t {
     uint32_t   base;
     uint32_t   tLOD;
     atomic_int refcount;
-    atomic_int refcount_r[4];
+    atomic_int refcount_r[VOODOO_RENDER_THREADS_MAX];
     int        is16;
     uint32_t   palette_checksum;
     uint32_t   addr_start[4];
     uint32_t   addr_end[4];
     uint32_t  *data;
+
+    /* Cache bookkeeping, only touched by the FIFO thread. */
+    int      next; /* next entry in the same hash bucket, -1 if none */
+    int      buf;  /* decoded data buffer, -1 if none */
+    int      tformat;
+    uint32_t last_used;
+    uint64_t content_hash;
 } texture_t;
 
+/* Decoded texture data, shared by every cache entry with the same content. */
+typedef struct texture_buf_t {
+    uint32_t *data;
+    int       users;
+} texture_buf_t;
+
+typedef struct texture_stats_t {
+    int hits;
+    int misses;
+    int shared;
+    int stalls;
+} texture_stats_t;
+
 typedef struct vert_t {
     float sVx;
     float sVy;
@@ -266,6 +290,11 @@ typedef struct clip_t {
     int y_max;
 } clip_t;
 
+typedef struct voodoo_render_thread_t {
+    struct voodoo_t *voodoo;
+    int              index;
+} voodoo_render_thread_t;
+
 typedef struct voodoo_t {
     mem_mapping_t mapping;
 
@@ -362,25 +391,28 @@ typedef struct voodoo_t {
     int    ncc_dirty[2];
 
     thread_t *fifo_thread;
-    thread_t *render_thread[4];
+    thread_t *render_thread[VOODOO_RENDER_THREADS_MAX];
     event_t  *wake_fifo_thread;
     event_t  *wake_main_thread;
     event_t  *fifo_not_full_event;
-    event_t  *render_not_full_event[4];
-    event_t  *wake_render_thread[4];
+    event_t  *render_not_full_event[VOODOO_RENDER_THREADS_MAX];
+    event_t  *wake_render_thread[VOODOO_RENDER_THREADS_MAX];
 
     int voodoo_busy;
-    int render_voodoo_busy[4];
+    int render_voodoo_busy[VOODOO_RENDER_THREADS_MAX];
 
+    /* Each render thread sees every triangle and draws the scanlines
+       where (y % render_threads) == its index. */
     int render_threads;
-    int odd_even_mask;
 
-    int pixel_count[4];
-    int texel_count[4];
+    voodoo_render_thread_t render_thread_data[VOODOO_RENDER_THREADS_MAX];
+
+    int pixel_count[VOODOO_RENDER_THREADS_MAX];
+    int texel_count[VOODOO_RENDER_THREADS_MAX];
     int tri_count;
     int frame_count;
-    int pixel_count_old[4];
-    int texel_count_old[4];
+    int pixel_count_old[VOODOO_RENDER_THREADS_MAX];
+    int texel_count_old[VOODOO_RENDER_THREADS_MAX];
     int wr_count;
     int rd_count;
     int tex_count;
@@ -410,7 +442,7 @@ typedef struct voodoo_t {
     atomic_int   cmd_written_fifo;
 
     voodoo_params_t params_buffer[PARAM_SIZE];
-    atomic_int      params_read_idx[4];
+    atomic_int      params_read_idx[VOODOO_RENDER_THREADS_MAX];
     atomic_int      params_write_idx;
 
     uint32_t   cmdfifo_base;
@@ -642,15 +674,22 @@ typedef struct voodoo_t {
     uint8_t  thefilterb[256][256];
     uint16_t purpleline[256][3];
 
-    texture_t texture_cache[2][TEX_CACHE_MAX];
-    uint8_t   texture_present[2][16384];
-    int       texture_last_removed;
+    texture_t     *texture_cache[2];
+    texture_buf_t *texture_buf[2];
+    int            texture_cache_size;
+    int            texture_hash[2][TEX_CACHE_HASH];
+    uint8_t        texture_present[2][16384];
+    uint32_t       texture_stamp;
+
+    int             texture_stats_frame_nr;
+    texture_stats_t texture_stats;       /* frame in progress */
+    texture_stats_t texture_stats_frame; /* last completed frame */
 
     uint32_t palette_checksum[2];
     int      palette_dirty[2];
 
     uint64_t time;
-    int      render_time[4];
+    int      render_time[VOODOO_RENDER_THREADS_MAX];
 
     int      force_blit_count;
     int      can_blit;
@@ -662,7 +701,7 @@ typedef struct voodoo_t {
     struct voodoo_set_t *set;
 
     uint8_t fifo_thread_run;
-    uint8_t render_thread_run[4];
+    uint8_t render_thread_run[VOODOO_RENDER_THREADS_MAX];
 
     uint8_t *vram;
     uint8_t *changedvram;
@@ -122,6 +122,7 @@ typedef struct monitor_t {
     int                      mon_force_resize;
     int                      mon_fullchange;
     int                      mon_changeframecount;
+    int                      mon_frame_unchanged; /* Card redrew nothing in the frame it is about to blit. */
     atomic_int               mon_screenshots;
     uint32_t                *mon_pal_lookup;
     int                     *mon_cga_palette;
@@ -256,6 +257,9 @@ extern void video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monit
 extern void video_blit_complete_monitor(int monitor_index);
 extern void video_wait_for_blit_monitor(int monitor_index);
 extern void video_wait_for_buffer_monitor(int monitor_index);
+extern bitmap_t *video_get_blit_buffer_monitor(int monitor_index);
+extern void video_get_blit_stats_monitor(int monitor_index, uint32_t *blitted, uint32_t *dropped, uint32_t *late);
+extern uint32_t video_get_blit_serial_monitor(int monitor_index);
 
 extern bitmap_t *create_bitmap(int w, int h);
 extern void      destroy_bitmap(bitmap_t *b);
@@ -292,6 +296,7 @@ extern uint32_t video_color_transform(uint32_t color);
 #define video_blit_complete()                 video_blit_complete_monitor(monitor_index_global)
 #define video_wait_for_blit()                 video_wait_for_blit_monitor(monitor_index_global)
 #define video_wait_for_buffer()               video_wait_for_buffer_monitor(monitor_index_global)
+#define video_get_blit_buffer()               video_get_blit_buffer_monitor(monitor_index_global)
 #define cgapal_rebuild()                      cgapal_rebuild_monitor(monitor_index_global)
 #define video_force_resize_get()              video_force_resize_get_monitor(monitor_index_global)
 #define video_force_resize_set(val)           video_force_resize_set_monitor(val, monitor_index_global)
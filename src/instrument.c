@@ -0,0 +1,240 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Benchmark instrumentation.
+ *
+ *          When built with INSTRUMENT and started with --instrument,
+ *          the frontends run the machine unthrottled and report the
+ *          host time of every pc_run() frame here. The run ends after
+ *          the requested amount of emulated time, or when the guest
+ *          writes to the marker port, and a JSON report is written
+ *          with the counters collected by the CPU, timer and I/O cores.
+ *
+ *
+ *
+ * Authors: Miran Grca, <mgrca8@gmail.com>
+ *
+ *          Copyright 2016-2025 Miran Grca.
+ */
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include "cpu.h"
+#ifdef USE_DYNAREC
+#    include "codegen_public.h"
+#endif
+#include <86box/machine.h>
+#include <86box/mem.h>
+#include <86box/plat.h>
+#include <86box/instrument.h>
+
+#define IO_REPORT_MAX 64
+
+char     instru_out_path[1024] = { '\0' };
+int      instru_marker_port    = -1;
+int      instru_stop_reason    = INSTRU_STOP_NONE;
+
+uint64_t instru_ins;
+uint64_t instru_timer_callbacks;
+uint64_t instru_blocks_run;
+uint64_t instru_blocks_interpreted;
+uint64_t instru_tlb_fills;
+uint64_t instru_tlb_flushes;
+uint64_t instru_tlb_cr3_flushes;
+uint64_t instru_tlb_cr3_invalidated;
+uint32_t instru_io_reads[65536];
+uint32_t instru_io_writes[65536];
+
+static uint32_t *frame_us;
+static uint32_t  frames;
+static uint32_t  frames_size;
+static uint64_t  host_us_total;
+
+void
+instru_io_write(uint16_t port)
+{
+    instru_io_writes[port]++;
+
+    if ((port == instru_marker_port) && (instru_stop_reason == INSTRU_STOP_NONE))
+        instru_stop_reason = INSTRU_STOP_MARKER;
+}
+
+static uint64_t
+instru_emulated_ms(void)
+{
+    return (uint64_t) ((double) tsc / cpu_s->rspeed * 1000);
+}
+
+/* Record one pc_run() frame. Returns 1 once the run should end. */
+int
+instru_frame(uint64_t host_us)
+{
+    if (frames == frames_size) {
+        uint32_t *temp = realloc(frame_us, (frames_size ? (frames_size * 2) : 4096) * sizeof(uint32_t));
+
+        if (temp) {
+            frame_us    = temp;
+            frames_size = frames_size ? (frames_size * 2) : 4096;
+        }
+    }
+    if (frames < frames_size)
+        frame_us[frames++] = (uint32_t) MIN(host_us, 0xffffffffULL);
+    host_us_total += host_us;
+
+    if ((instru_stop_reason == INSTRU_STOP_NONE) && instru_run_ms && (instru_emulated_ms() >= instru_run_ms))
+        instru_stop_reason = INSTRU_STOP_TIME;
+
+    return instru_stop_reason != INSTRU_STOP_NONE;
+}
+
+static int
+instru_cmp_u32(const void *a, const void *b)
+{
+    uint32_t va = *(const uint32_t *) a;
+    uint32_t vb = *(const uint32_t *) b;
+
+    return (va > vb) - (va < vb);
+}
+
+static int
+instru_cmp_port(const void *a, const void *b)
+{
+    uint16_t pa = *(const uint16_t *) a;
+    uint16_t pb = *(const uint16_t *) b;
+    uint64_t ta = (uint64_t) instru_io_reads[pa] + instru_io_writes[pa];
+    uint64_t tb = (uint64_t) instru_io_reads[pb] + instru_io_writes[pb];
+
+    if (ta != tb)
+        return (ta < tb) ? 1 : -1;
+    return pa - pb;
+}
+
+static uint32_t
+instru_percentile(int p)
+{
+    if (!frames)
+        return 0;
+
+    return frame_us[MIN(((uint64_t) frames * p) / 100, frames - 1)];
+}
+
+void
+instru_report(void)
+{
+    static const char *reasons[] = { "none", "time", "marker", "user" };
+    static uint16_t    ports[65536];
+    double             host_s = (double) host_us_total / 1000000.0;
+    double             emu_s  = (double) instru_emulated_ms() / 1000.0;
+    uint64_t           blocks = instru_blocks_run + instru_blocks_interpreted;
+    uint32_t           nports = 0;
+    FILE              *fp     = stdout;
+
+    if (instru_stop_reason == INSTRU_STOP_NONE)
+        instru_stop_reason = INSTRU_STOP_USER;
+
+    if (instru_out_path[0] != '\0') {
+        fp = plat_fopen(instru_out_path, "w");
+        if (!fp) {
+            fprintf(stderr, "[instrument] unable to open %s\n", instru_out_path);
+            fp = stdout;
+        }
+    }
+
+    if (frames)
+        qsort(frame_us, frames, sizeof(uint32_t), instru_cmp_u32);
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"machine\": \"%s\",\n", machine_get_internal_name());
+    fprintf(fp, "  \"cpu\": \"%s\",\n", cpu_s->name);
+    fprintf(fp, "  \"dynarec\": %i,\n", cpu_use_dynarec);
+    fprintf(fp, "  \"stop_reason\": \"%s\",\n", reasons[instru_stop_reason]);
+    fprintf(fp, "  \"emulated_seconds\": %.6f,\n", emu_s);
+    fprintf(fp, "  \"host_seconds\": %.6f,\n", host_s);
+    fprintf(fp, "  \"speed_ratio\": %.4f,\n", (host_s > 0.0) ? (emu_s / host_s) : 0.0);
+    fprintf(fp, "  \"instructions\": %" PRIu64 ",\n", instru_ins);
+    fprintf(fp, "  \"mips\": %.3f,\n", (host_s > 0.0) ? ((double) instru_ins / host_s / 1000000.0) : 0.0);
+    fprintf(fp, "  \"frames\": {\n");
+    fprintf(fp, "    \"count\": %u,\n", frames);
+    fprintf(fp, "    \"mean_us\": %.3f,\n", frames ? ((double) host_us_total / frames) : 0.0);
+    fprintf(fp, "    \"min_us\": %u,\n", frames ? frame_us[0] : 0);
+    fprintf(fp, "    \"p50_us\": %u,\n", instru_percentile(50));
+    fprintf(fp, "    \"p95_us\": %u,\n", instru_percentile(95));
+    fprintf(fp, "    \"p99_us\": %u,\n", instru_percentile(99));
+    fprintf(fp, "    \"max_us\": %u\n", frames ? frame_us[frames - 1] : 0);
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"timer_callbacks\": %" PRIu64 ",\n", instru_timer_callbacks);
+    fprintf(fp, "  \"blocks\": {\n");
+    fprintf(fp, "    \"run\": %" PRIu64 ",\n", instru_blocks_run);
+    fprintf(fp, "    \"interpreted\": %" PRIu64 ",\n", instru_blocks_interpreted);
+#ifdef USE_NEW_DYNAREC
+    {
+        codegen_ir_stats_t ir;
+
+        codegen_ir_get_stats(&ir);
+        fprintf(fp, "    \"ir\": {\n");
+        fprintf(fp, "      \"blocks_compiled\": %" PRIu64 ",\n", ir.blocks);
+        fprintf(fp, "      \"uops_in\": %" PRIu64 ",\n", ir.uops_in);
+        fprintf(fp, "      \"uops_out\": %" PRIu64 ",\n", ir.uops_out);
+        fprintf(fp, "      \"folded\": %" PRIu64 ",\n", ir.folded);
+        fprintf(fp, "      \"dead_stores\": %" PRIu64 ",\n", ir.dead_stores);
+        fprintf(fp, "      \"forwarded\": %" PRIu64 ",\n", ir.forwarded);
+        fprintf(fp, "      \"code_bytes\": %" PRIu64 ",\n", ir.code_bytes);
+        fprintf(fp, "      \"disabled_passes\": %i\n", cpu_dynarec_ir_disable);
+        fprintf(fp, "    },\n");
+    }
+#endif
+    fprintf(fp, "    \"hit_rate\": %.6f\n", blocks ? ((double) instru_blocks_run / blocks) : 0.0);
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"tlb\": {\n");
+    fprintf(fp, "    \"size\": %i,\n", MMU_TLB_SIZE);
+    fprintf(fp, "    \"fills\": %" PRIu64 ",\n", instru_tlb_fills);
+    fprintf(fp, "    \"flushes\": %" PRIu64 ",\n", instru_tlb_flushes);
+    fprintf(fp, "    \"cr3_flushes\": %" PRIu64 ",\n", instru_tlb_cr3_flushes);
+    fprintf(fp, "    \"cr3_invalidated\": %" PRIu64 "\n", instru_tlb_cr3_invalidated);
+    fprintf(fp, "  },\n");
+    {
+        plat_mem_stats_t mem_stats;
+
+        plat_get_mem_stats(&mem_stats);
+        fprintf(fp, "  \"host_memory\": {\n");
+        fprintf(fp, "    \"rss_bytes\": %" PRIu64 ",\n", mem_stats.rss);
+        fprintf(fp, "    \"peak_rss_bytes\": %" PRIu64 ",\n", mem_stats.peak_rss);
+        fprintf(fp, "    \"minor_faults\": %" PRIu64 ",\n", mem_stats.minor_faults);
+        fprintf(fp, "    \"major_faults\": %" PRIu64 "\n", mem_stats.major_faults);
+        fprintf(fp, "  },\n");
+    }
+
+    for (uint32_t c = 0; c < 65536; c++) {
+        if (instru_io_reads[c] || instru_io_writes[c])
+            ports[nports++] = c;
+    }
+    qsort(ports, nports, sizeof(uint16_t), instru_cmp_port);
+
+    fprintf(fp, "  \"io_ports\": [");
+    for (uint32_t c = 0; c < MIN(nports, IO_REPORT_MAX); c++) {
+        fprintf(fp, "%s\n    { \"port\": \"%04X\", \"reads\": %u, \"writes\": %u }", c ? "," : "",
+                ports[c], instru_io_reads[ports[c]], instru_io_writes[ports[c]]);
+    }
+    fprintf(fp, "%s]\n", nports ? "\n  " : "");
+    fprintf(fp, "}\n");
+
+    if (fp != stdout)
+        fclose(fp);
+    else
+        fflush(fp);
+
+    free(frame_us);
+    frame_us    = NULL;
+    frames      = 0;
+    frames_size = 0;
+}
@@ -26,6 +26,7 @@
 #define HAVE_STDARG_H
 #include <86box/86box.h>
 #include <86box/io.h>
+#include <86box/instrument.h>
 #include <86box/timer.h>
 #include "cpu.h"
 #include <86box/m_amstrad.h>
@@ -44,9 +45,42 @@ typedef struct _io_ {
 
     void *priv;
 
-    struct _io_ *prev, *next;
+    uint8_t in_mask;  /* Widths (1, 2, 4) this handler reads.  */
+    uint8_t out_mask; /* Widths (1, 2, 4) this handler writes. */
+    int     refcount; /* Number of ports referencing this handler. */
 } io_t;
 
+/* Per-port summary of the handlers, used by the wider accesses to find the
+   narrower handlers they have to fall back to. */
+#define IO_INB_NOW   0x01 /* inb, but no inw.         */
+#define IO_INB_NOWL  0x02 /* inb, but no inw nor inl. */
+#define IO_INW_NOL   0x04 /* inw, but no inl.         */
+#define IO_OUTB_NOW  0x10
+#define IO_OUTB_NOWL 0x20
+#define IO_OUTW_NOL  0x40
+
+/* Accesses that can be served by a single call to the only handler. */
+#define IO_FAST_INB  0x01
+#define IO_FAST_INW  0x02
+#define IO_FAST_INL  0x04
+#define IO_FAST_OUTB 0x10
+#define IO_FAST_OUTW 0x20
+#define IO_FAST_OUTL 0x40
+
+typedef struct {
+    io_t    *single; /* The only handler, valid if any fast bit is set. */
+    io_t   **list;   /* All handlers, in registration order. */
+    uint32_t gen;    /* Changes whenever the list is modified. */
+    uint16_t count;
+    uint16_t alloc;
+    uint8_t  flags;
+    uint8_t  fast;
+} io_port_t;
+
+/* Handlers a multi-handler dispatch can take a snapshot of on the stack, a
+   port with more handlers than this falls back to the heap. */
+#define IO_SNAPSHOT_LEN 8
+
 typedef struct {
     uint8_t   enable;
     uint16_t  base;
@@ -55,9 +89,10 @@ typedef struct {
     void     *priv;
 } io_trap_t;
 
-int   initialized = 0;
-io_t *io[NPORTS];
-io_t *io_last[NPORTS];
+int       initialized = 0;
+io_port_t io_ports[NPORTS];
+
+static uint32_t io_gen = 0;
 
 #ifdef ENABLE_IO_LOG
 int io_do_log = ENABLE_IO_LOG;
@@ -77,34 +112,107 @@ io_log(const char *fmt, ...)
 #    define io_log(fmt, ...)
 #endif
 
+/* Recalculate the handler summary of a port. */
+static void
+io_port_update_flags(uint16_t port)
+{
+    io_port_t *p = &io_ports[port];
+    io_t      *h;
+
+    p->flags = 0x00;
+
+    for (int i = 0; i < p->count; i++) {
+        h = p->list[i];
+
+        if ((h->in_mask & 3) == 1)
+            p->flags |= IO_INB_NOW;
+        if ((h->in_mask & 7) == 1)
+            p->flags |= IO_INB_NOWL;
+        if ((h->in_mask & 6) == 2)
+            p->flags |= IO_INW_NOL;
+
+        if ((h->out_mask & 3) == 1)
+            p->flags |= IO_OUTB_NOW;
+        if ((h->out_mask & 7) == 1)
+            p->flags |= IO_OUTB_NOWL;
+        if ((h->out_mask & 6) == 2)
+            p->flags |= IO_OUTW_NOL;
+    }
+}
+
+/* Recalculate the fast path of a port, this depends on the next three ports
+   as well, as wider accesses also reach the narrower handlers there. */
+static void
+io_port_update_fast(uint16_t port)
+{
+    io_port_t *p  = &io_ports[port];
+    uint8_t    f1 = io_ports[(port + 1) & 0xffff].flags;
+    uint8_t    f2 = io_ports[(port + 2) & 0xffff].flags;
+    uint8_t    f3 = io_ports[(port + 3) & 0xffff].flags;
+    io_t      *h;
+
+    p->fast   = 0x00;
+    p->single = NULL;
+
+    if (p->count != 1)
+        return;
+
+    h = p->list[0];
+
+    if (h->inb)
+        p->fast |= IO_FAST_INB;
+    if (h->inw && !(f1 & IO_INB_NOW))
+        p->fast |= IO_FAST_INW;
+    if (h->inl && !((f1 | f2 | f3) & IO_INB_NOWL) && !(f2 & IO_INW_NOL))
+        p->fast |= IO_FAST_INL;
+
+    if (h->outb)
+        p->fast |= IO_FAST_OUTB;
+    if (h->outw && !(f1 & IO_OUTB_NOW))
+        p->fast |= IO_FAST_OUTW;
+    if (h->outl && !((f1 | f2 | f3) & IO_OUTB_NOWL) && !(f2 & IO_OUTW_NOL))
+        p->fast |= IO_FAST_OUTL;
+
+    if (p->fast)
+        p->single = h;
+}
+
+static void
+io_update_range(uint16_t base, int size)
+{
+    for (int c = 0; c < size; c++)
+        io_port_update_flags((base + c) & 0xffff);
+
+    for (int c = -3; c < size; c++)
+        io_port_update_fast((base + c) & 0xffff);
+}
+
+static void
+io_handler_release(io_t *h)
+{
+    if (--h->refcount <= 0)
+        free(h);
+}
+
 void
 io_init(void)
 {
-    int   c;
-    io_t *p;
-    io_t *q;
+    io_port_t *p;
 
     if (!initialized) {
-        for (c = 0; c < NPORTS; c++)
-            io[c] = io_last[c] = NULL;
+        memset(io_ports, 0x00, sizeof(io_ports));
         initialized = 1;
     }
 
-    for (c = 0; c < NPORTS; c++) {
-        if (io_last[c]) {
-            /* Port c has at least one handler. */
-            p = io_last[c];
-            /* After this loop, p will have the pointer to the first handler. */
-            while (p) {
-                q = p->prev;
-                free(p);
-                p = q;
-            }
-            p = NULL;
-        }
+    for (int c = 0; c < NPORTS; c++) {
+        p = &io_ports[c];
 
-        /* io[c] should be NULL. */
-        io[c] = io_last[c] = NULL;
+        /* Handlers are shared between ports, free them once no port is left. */
+        for (int i = 0; i < p->count; i++)
+            io_handler_release(p->list[i]);
+
+        free(p->list);
+        memset(p, 0x00, sizeof(io_port_t));
     }
 }
 
@@ -118,34 +226,43 @@ io_sethandler_common(uint16_t base, int size,
                      void (*outl)(uint16_t addr, uint32_t val, void *priv),
                      void *priv, int step)
 {
-    io_t *p;
-    io_t *q = NULL;
+    io_port_t *p;
+    io_t      *q;
 
-    for (int c = 0; c < size; c += step) {
-        p = io_last[base + c];
-        q = (io_t *) malloc(sizeof(io_t));
-        memset(q, 0, sizeof(io_t));
-        if (p) {
-            p->next = q;
-            q->prev = p;
-        } else {
-            io[base + c] = q;
-            q->prev      = NULL;
-        }
+    if (size <= 0)
+        return;
+
+    /* One handler is shared by all the ports of the range. */
+    q = (io_t *) malloc(sizeof(io_t));
+    memset(q, 0, sizeof(io_t));
 
-        q->inb = inb;
-        q->inw = inw;
-        q->inl = inl;
+    q->inb = inb;
+    q->inw = inw;
+    q->inl = inl;
 
-        q->outb = outb;
-        q->outw = outw;
-        q->outl = outl;
+    q->outb = outb;
+    q->outw = outw;
+    q->outl = outl;
 
-        q->priv = priv;
-        q->next = NULL;
+    q->priv = priv;
+
+    q->in_mask  = (inb ? 1 : 0) | (inw ? 2 : 0) | (inl ? 4 : 0);
+    q->out_mask = (outb ? 1 : 0) | (outw ? 2 : 0) | (outl ? 4 : 0);
+
+    for (int c = 0; c < size; c += step) {
+        p = &io_ports[(base + c) & 0xffff];
 
-        io_last[base + c] = q;
+        if (p->count == p->alloc) {
+            p->alloc = p->alloc ? (p->alloc << 1) : 2;
+            p->list  = (io_t **) realloc(p->list, p->alloc * sizeof(io_t *));
+        }
+
+        p->list[p->count++] = q;
+        p->gen = ++io_gen;
+        q->refcount++;
     }
+
+    io_update_range(base, size);
 }
 
 void
@@ -158,31 +275,28 @@ io_removehandler_common(uint16_t base, int size,
                         void (*outl)(uint16_t addr, uint32_t val, void *priv),
                         void *priv, int step)
 {
-    io_t *p;
-    io_t *q;
+    io_port_t *p;
+    io_t      *q;
+
+    if (size <= 0)
+        return;
 
     for (int c = 0; c < size; c += step) {
-        p = io[base + c];
-        if (!p)
-            continue;
-        while (p) {
-            q = p->next;
-            if ((p->inb == inb) && (p->inw == inw) && (p->inl == inl) && (p->outb == outb) && (p->outw == outw) && (p->outl == outl) && (p->priv == priv)) {
-                if (p->prev)
-                    p->prev->next = p->next;
-                else
-                    io[base + c] = p->next;
-                if (p->next)
-                    p->next->prev = p->prev;
-                else
-                    io_last[base + c] = p->prev;
-                free(p);
-                p = NULL;
+        p = &io_ports[(base + c) & 0xffff];
+
+        for (int i = 0; i < p->count; i++) {
+            q = p->list[i];
+            if ((q->inb == inb) && (q->inw == inw) && (q->inl == inl) && (q->outb == outb) && (q->outw == outw) && (q->outl == outl) && (q->priv == priv)) {
+                p->count--;
+                memmove(&p->list[i], &p->list[i + 1], (p->count - i) * sizeof(io_t *));
+                p->gen = ++io_gen;
+                io_handler_release(q);
                 break;
             }
-            p = q;
         }
     }
+
+    io_update_range(base, size);
 }
 
 void
@@ -331,56 +445,184 @@ io_debug_check_addr(uint16_t addr)
 }
 #endif
 
+static __inline int
+io_is_pci_config(uint16_t port)
+{
+    if (!(pci_flags & (FLAG_CONFIG_IO_ON | FLAG_CONFIG_DEV0_IO_ON)))
+        return 0;
+
+    return ((pci_flags & FLAG_CONFIG_IO_ON) && (port >= pci_base) && (port < (pci_base + pci_size))) ||
+           ((pci_flags & FLAG_CONFIG_DEV0_IO_ON) && (port >= 0xc000) && (port < 0xc100));
+}
+
+static __inline void
+io_amstrad_latch(uint16_t port)
+{
+    if (amstrad_latch & 0x80000000) {
+        if (port & 0x80)
+            amstrad_latch = AMSTRAD_NOLATCH | 0x80000000;
+        else if (port & 0x4000)
+            amstrad_latch = AMSTRAD_SW10 | 0x80000000;
+        else
+            amstrad_latch = AMSTRAD_SW9 | 0x80000000;
+    }
+}
+
+/* Take a snapshot of the handlers of a port before dispatching to them, a
+   handler may add or remove handlers on its own port. Every handler in the
+   snapshot holds a reference, so that its address can not be reused by a
+   handler registered during the dispatch. */
+static io_t **
+io_port_snapshot(io_port_t *p, io_t **buf, int *count)
+{
+    io_t **list = buf;
+
+    *count = p->count;
+
+    if (*count > IO_SNAPSHOT_LEN)
+        list = (io_t **) malloc(*count * sizeof(io_t *));
+
+    for (int i = 0; i < *count; i++) {
+        list[i] = p->list[i];
+        list[i]->refcount++;
+    }
+
+    return list;
+}
+
+static void
+io_port_snapshot_release(io_t **list, io_t **buf, int count)
+{
+    for (int i = 0; i < count; i++)
+        io_handler_release(list[i]);
+
+    if (list != buf)
+        free(list);
+}
+
+/* Returns 1 if a handler of the snapshot is still on the port. */
+static int
+io_port_has(io_port_t *p, uint32_t gen, io_t *h)
+{
+    if (p->gen == gen)
+        return 1;
+
+    for (int i = 0; i < p->count; i++) {
+        if (p->list[i] == h)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Run the read handlers of the given width on a port, skipping those that
+   also implement any of the widths in skip (as they serve the wider access
+   themselves), and return the number of handlers called. Handlers removed
+   by an earlier handler are not called, those added are not called either. */
+static int
+io_port_in(uint16_t port, uint8_t width, uint8_t skip, uint32_t *ret)
+{
+    io_port_t *p   = &io_ports[port];
+    uint32_t   gen = p->gen;
+    io_t      *buf[IO_SNAPSHOT_LEN];
+    io_t     **list;
+    io_t      *h;
+    int        count;
+    int        n = 0;
+
+    list = io_port_snapshot(p, buf, &count);
+
+    for (int i = 0; i < count; i++) {
+        h = list[i];
+
+        if (((h->in_mask & (width | skip)) == width) && io_port_has(p, gen, h)) {
+            if (width == 1)
+                *ret &= h->inb(port, h->priv);
+            else if (width == 2)
+                *ret &= h->inw(port, h->priv);
+            else
+                *ret &= h->inl(port, h->priv);
+            n++;
+        }
+    }
+
+    io_port_snapshot_release(list, buf, count);
+
+    return n;
+}
+
+/* Same as above, for the write handlers. */
+static int
+io_port_out(uint16_t port, uint8_t width, uint8_t skip, uint32_t val)
+{
+    io_port_t *p   = &io_ports[port];
+    uint32_t   gen = p->gen;
+    io_t      *buf[IO_SNAPSHOT_LEN];
+    io_t     **list;
+    io_t      *h;
+    int        count;
+    int        n = 0;
+
+    list = io_port_snapshot(p, buf, &count);
+
+    for (int i = 0; i < count; i++) {
+        h = list[i];
+
+        if (((h->out_mask & (width | skip)) == width) && io_port_has(p, gen, h)) {
+            if (width == 1)
+                h->outb(port, val, h->priv);
+            else if (width == 2)
+                h->outw(port, val, h->priv);
+            else
+                h->outl(port, val, h->priv);
+            n++;
+        }
+    }
+
+    io_port_snapshot_release(list, buf, count);
+
+    return n;
+}
+
 uint8_t
 inb(uint16_t port)
 {
-    uint8_t ret = 0xff;
-    io_t   *p;
-    io_t   *q;
-    int     found  = 0;
+    io_port_t *p = &io_ports[port];
+    uint32_t   ret = 0xff;
+    int        found  = 0;
+    int        n;
 #ifdef ENABLE_IO_LOG
-    int     qfound = 0;
+    int        qfound = 0;
 #endif
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
 #endif
 
-    if ((pci_flags & FLAG_CONFIG_IO_ON) && (port >= pci_base) && (port < (pci_base + pci_size))) {
+    instru_count(instru_io_reads[port]);
+
+    if (io_is_pci_config(port)) {
         ret = pci_read(port, NULL);
         found = 1;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
-    } else if ((pci_flags & FLAG_CONFIG_DEV0_IO_ON) && (port >= 0xc000) && (port < 0xc100)) {
-        ret = pci_read(port, NULL);
+    } else if (p->fast & IO_FAST_INB) {
+        ret = p->single->inb(port, p->single->priv);
         found = 1;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
     } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->inb) {
-                ret &= p->inb(port, p->priv);
-                found |= 1;
+        n = io_port_in(port, 1, 0, &ret);
+        if (n)
+            found |= 1;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+        qfound += n;
 #endif
-            }
-            p = q;
-        }
     }
 
-    if (amstrad_latch & 0x80000000) {
-        if (port & 0x80)
-            amstrad_latch = AMSTRAD_NOLATCH | 0x80000000;
-        else if (port & 0x4000)
-            amstrad_latch = AMSTRAD_SW10 | 0x80000000;
-        else
-            amstrad_latch = AMSTRAD_SW9 | 0x80000000;
-    }
+    io_amstrad_latch(port);
 
     if (!found)
         cycles -= io_delay;
@@ -399,42 +641,40 @@ inb(uint16_t port)
 void
 outb(uint16_t port, uint8_t val)
 {
-    io_t *p;
-    io_t *q;
-    int   found  = 0;
+    io_port_t *p = &io_ports[port];
+    int        found  = 0;
+    int        n;
 #ifdef ENABLE_IO_LOG
-    int   qfound = 0;
+    int        qfound = 0;
 #endif
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
 #endif
 
-    if ((pci_flags & FLAG_CONFIG_IO_ON) && (port >= pci_base) && (port < (pci_base + pci_size))) {
+#ifdef USE_INSTRUMENT
+    instru_io_write(port);
+#endif
+
+    if (io_is_pci_config(port)) {
         pci_write(port, val, NULL);
         found = 1;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
-    } else if ((pci_flags & FLAG_CONFIG_DEV0_IO_ON) && (port >= 0xc000) && (port < 0xc100)) {
-        pci_write(port, val, NULL);
+    } else if (p->fast & IO_FAST_OUTB) {
+        p->single->outb(port, val, p->single->priv);
         found = 1;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
     } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->outb) {
-                p->outb(port, val, p->priv);
-                found |= 1;
+        n = io_port_out(port, 1, 0, val);
+        if (n)
+            found |= 1;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+        qfound += n;
 #endif
-            }
-            p = q;
-        }
     }
 
     if (!found) {
@@ -453,72 +693,55 @@ outb(uint16_t port, uint8_t val)
 uint16_t
 inw(uint16_t port)
 {
-    io_t    *p;
-    io_t    *q;
-    uint16_t ret    = 0xffff;
-    int      found  = 0;
+    io_port_t *p = &io_ports[port];
+    uint32_t   ret    = 0xffff;
+    uint32_t   ret8[2];
+    int        found  = 0;
+    int        n;
 #ifdef ENABLE_IO_LOG
-    int      qfound = 0;
+    int        qfound = 0;
 #endif
-    uint8_t  ret8[2];
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
 #endif
 
-    if ((pci_flags & FLAG_CONFIG_IO_ON) && (port >= pci_base) && (port < (pci_base + pci_size))) {
+    instru_count(instru_io_reads[port]);
+
+    if (io_is_pci_config(port)) {
         ret = pci_readw(port, NULL);
         found = 2;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
-    } else if ((pci_flags & FLAG_CONFIG_DEV0_IO_ON) && (port >= 0xc000) && (port < 0xc100)) {
-        ret = pci_readw(port, NULL);
+    } else if (p->fast & IO_FAST_INW) {
+        ret = p->single->inw(port, p->single->priv);
         found = 2;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
     } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->inw) {
-                ret &= p->inw(port, p->priv);
-                found |= 2;
+        n = io_port_in(port, 2, 0, &ret);
+        if (n)
+            found |= 2;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+        qfound += n;
 #endif
-            }
-            p = q;
-        }
 
         ret8[0] = ret & 0xff;
         ret8[1] = (ret >> 8) & 0xff;
         for (uint8_t i = 0; i < 2; i++) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->inb && !p->inw) {
-                    ret8[i] &= p->inb(port + i, p->priv);
-                    found |= 1;
+            n = io_port_in((port + i) & 0xffff, 1, 2, &ret8[i]);
+            if (n)
+                found |= 1;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+            qfound += n;
 #endif
-                }
-                p = q;
-            }
         }
         ret = (ret8[1] << 8) | ret8[0];
     }
 
-    if (amstrad_latch & 0x80000000) {
-        if (port & 0x80)
-            amstrad_latch = AMSTRAD_NOLATCH | 0x80000000;
-        else if (port & 0x4000)
-            amstrad_latch = AMSTRAD_SW10 | 0x80000000;
-        else
-            amstrad_latch = AMSTRAD_SW9 | 0x80000000;
-    }
+    io_amstrad_latch(port);
 
     if (!found)
         cycles -= io_delay;
@@ -531,56 +754,48 @@ inw(uint16_t port)
 void
 outw(uint16_t port, uint16_t val)
 {
-    io_t *p;
-    io_t *q;
-    int   found  = 0;
+    io_port_t *p = &io_ports[port];
+    int        found  = 0;
+    int        n;
 #ifdef ENABLE_IO_LOG
-    int   qfound = 0;
+    int        qfound = 0;
 #endif
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
 #endif
 
-    if ((pci_flags & FLAG_CONFIG_IO_ON) && (port >= pci_base) && (port < (pci_base + pci_size))) {
+#ifdef USE_INSTRUMENT
+    instru_io_write(port);
+#endif
+
+    if (io_is_pci_config(port)) {
         pci_writew(port, val, NULL);
         found = 2;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
-    } else if ((pci_flags & FLAG_CONFIG_DEV0_IO_ON) && (port >= 0xc000) && (port < 0xc100)) {
-        pci_writew(port, val, NULL);
+    } else if (p->fast & IO_FAST_OUTW) {
+        p->single->outw(port, val, p->single->priv);
         found = 2;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
     } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->outw) {
-                p->outw(port, val, p->priv);
-                found |= 2;
+        n = io_port_out(port, 2, 0, val);
+        if (n)
+            found |= 2;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+        qfound += n;
 #endif
-            }
-            p = q;
-        }
 
         for (uint8_t i = 0; i < 2; i++) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->outb && !p->outw) {
-                    p->outb(port + i, val >> (i << 3), p->priv);
-                    found |= 1;
+            n = io_port_out((port + i) & 0xffff, 1, 2, (val >> (i << 3)) & 0xff);
+            if (n)
+                found |= 1;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+            qfound += n;
 #endif
-                }
-                p = q;
-            }
         }
     }
 
@@ -600,72 +815,51 @@ outw(uint16_t port, uint16_t val)
 uint32_t
 inl(uint16_t port)
 {
-    io_t    *p;
-    io_t    *q;
-    uint32_t ret = 0xffffffff;
-    uint16_t ret16[2];
-    uint8_t  ret8[4];
-    int      found  = 0;
+    io_port_t *p = &io_ports[port];
+    uint32_t   ret    = 0xffffffff;
+    uint32_t   ret16[2];
+    uint32_t   ret8[4];
+    int        found  = 0;
+    int        n;
 #ifdef ENABLE_IO_LOG
-    int      qfound = 0;
+    int        qfound = 0;
 #endif
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
 #endif
 
-    if ((pci_flags & FLAG_CONFIG_IO_ON) && (port >= pci_base) && (port < (pci_base + pci_size))) {
+    instru_count(instru_io_reads[port]);
+
+    if (io_is_pci_config(port)) {
         ret = pci_readl(port, NULL);
         found = 4;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
-    } else if ((pci_flags & FLAG_CONFIG_DEV0_IO_ON) && (port >= 0xc000) && (port < 0xc100)) {
-        ret = pci_readl(port, NULL);
+    } else if (p->fast & IO_FAST_INL) {
+        ret = p->single->inl(port, p->single->priv);
         found = 4;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
     } else {
-        p = io[port];
-        while (p) {
-            q = p->next;
-            if (p->inl) {
-                ret &= p->inl(port, p->priv);
-                found |= 4;
+        n = io_port_in(port, 4, 0, &ret);
+        if (n)
+            found |= 4;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+        qfound += n;
 #endif
-            }
-            p = q;
-        }
 
         ret16[0] = ret & 0xffff;
         ret16[1] = (ret >> 16) & 0xffff;
-        p        = io[port & 0xffff];
-        while (p) {
-            q = p->next;
-            if (p->inw && !p->inl) {
-                ret16[0] &= p->inw(port, p->priv);
-                found |= 2;
-#ifdef ENABLE_IO_LOG
-                qfound++;
-#endif
-            }
-            p = q;
-        }
-
-        p = io[(port + 2) & 0xffff];
-        while (p) {
-            q = p->next;
-            if (p->inw && !p->inl) {
-                ret16[1] &= p->inw(port + 2, p->priv);
+        for (uint8_t i = 0; i < 2; i++) {
+            n = io_port_in((port + (i << 1)) & 0xffff, 2, 4, &ret16[i]);
+            if (n)
                 found |= 2;
 #ifdef ENABLE_IO_LOG
-                qfound++;
+            qfound += n;
 #endif
-            }
-            p = q;
         }
         ret = (ret16[1] << 16) | ret16[0];
 
@@ -674,30 +868,17 @@ inl(uint16_t port)
         ret8[2] = (ret >> 16) & 0xff;
         ret8[3] = (ret >> 24) & 0xff;
         for (uint8_t i = 0; i < 4; i++) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->inb && !p->inw && !p->inl) {
-                    ret8[i] &= p->inb(port + i, p->priv);
-                    found |= 1;
+            n = io_port_in((port + i) & 0xffff, 1, 6, &ret8[i]);
+            if (n)
+                found |= 1;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+            qfound += n;
 #endif
-                }
-                p = q;
-            }
         }
         ret = (ret8[3] << 24) | (ret8[2] << 16) | (ret8[1] << 8) | ret8[0];
     }
 
-    if (amstrad_latch & 0x80000000) {
-        if (port & 0x80)
-            amstrad_latch = AMSTRAD_NOLATCH | 0x80000000;
-        else if (port & 0x4000)
-            amstrad_latch = AMSTRAD_SW10 | 0x80000000;
-        else
-            amstrad_latch = AMSTRAD_SW9 | 0x80000000;
-    }
+    io_amstrad_latch(port);
 
     if (!found)
         cycles -= io_delay;
@@ -710,74 +891,58 @@ inl(uint16_t port)
 void
 outl(uint16_t port, uint32_t val)
 {
-    io_t *p;
-    io_t *q;
-    int   found  = 0;
+    io_port_t *p = &io_ports[port];
+    int        found  = 0;
+    int        n;
 #ifdef ENABLE_IO_LOG
-    int   qfound = 0;
+    int        qfound = 0;
 #endif
-    int   i      = 0;
+    int        i      = 0;
 
 #ifdef USE_DEBUG_REGS_486
     io_debug_check_addr(port);
 #endif
 
-    if ((pci_flags & FLAG_CONFIG_IO_ON) && (port >= pci_base) && (port < (pci_base + pci_size))) {
+#ifdef USE_INSTRUMENT
+    instru_io_write(port);
+#endif
+
+    if (io_is_pci_config(port)) {
         pci_writel(port, val, NULL);
         found = 4;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
-    } else if ((pci_flags & FLAG_CONFIG_DEV0_IO_ON) && (port >= 0xc000) && (port < 0xc100)) {
-        pci_writel(port, val, NULL);
+    } else if (p->fast & IO_FAST_OUTL) {
+        p->single->outl(port, val, p->single->priv);
         found = 4;
 #ifdef ENABLE_IO_LOG
         qfound = 1;
 #endif
     } else {
-        p = io[port];
-        if (p) {
-            while (p) {
-                q = p->next;
-                if (p->outl) {
-                    p->outl(port, val, p->priv);
-                    found |= 4;
+        n = io_port_out(port, 4, 0, val);
+        if (n)
+            found |= 4;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+        qfound += n;
 #endif
-                }
-                p = q;
-            }
-        }
 
         for (i = 0; i < 4; i += 2) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->outw && !p->outl) {
-                    p->outw(port + i, val >> (i << 3), p->priv);
-                    found |= 2;
+            n = io_port_out((port + i) & 0xffff, 2, 4, (val >> (i << 3)) & 0xffff);
+            if (n)
+                found |= 2;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+            qfound += n;
 #endif
-                }
-                p = q;
-            }
         }
 
         for (i = 0; i < 4; i++) {
-            p = io[(port + i) & 0xffff];
-            while (p) {
-                q = p->next;
-                if (p->outb && !p->outw && !p->outl) {
-                    p->outb(port + i, val >> (i << 3), p->priv);
-                    found |= 1;
+            n = io_port_out((port + i) & 0xffff, 1, 6, (val >> (i << 3)) & 0xff);
+            if (n)
+                found |= 1;
 #ifdef ENABLE_IO_LOG
-                    qfound++;
+            qfound += n;
 #endif
-                }
-                p = q;
-            }
         }
     }
 
@@ -19,6 +19,7 @@
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #define HAVE_STDARG_H
@@ -139,9 +140,22 @@ machine_init(void)
 int
 machine_available(int m)
 {
+    /* 0 = not checked yet, 1 = missing, 2 = available. Every machine is
+       only checked once for each build of the ROM index. */
+    static uint8_t *checked = NULL;
+    static uint32_t checked_generation = 0;
     int             ret;
     const device_t *dev = machine_get_device(m);
 
+    if (checked == NULL)
+        checked = (uint8_t *) calloc(machine_count(), 1);
+    if ((checked != NULL) && (checked_generation != rom_index_generation)) {
+        memset(checked, 0x00, machine_count());
+        checked_generation = rom_index_generation;
+    }
+    if ((checked != NULL) && checked[m])
+        return checked[m] - 1;
+
     bios_only = 1;
 
     ret = device_available(dev);
@@ -152,6 +166,16 @@ machine_available(int m)
 
     bios_only = 0;
 
+    if (checked != NULL) {
+        /* The check itself may have built the index, which makes the
+           other results stale. */
+        if (checked_generation != rom_index_generation) {
+            memset(checked, 0x00, machine_count());
+            checked_generation = rom_index_generation;
+        }
+        checked[m] = 1 + !!ret;
+    }
+
     return !!ret;
 }
 
@@ -39,6 +39,7 @@
 #include <86box/plat.h>
 #include <86box/rom.h>
 #include <86box/gdbstub.h>
+#include <86box/instrument.h>
 #ifdef USE_DYNAREC
 #    include "codegen_public.h"
 #else
@@ -85,12 +86,12 @@ uint32_t pccache;
 uint8_t *pccache2;
 
 int        readlnext;
-int        readlookup[256];
+int        readlookup[MMU_TLB_SIZE];
 uintptr_t *readlookup2;
 uintptr_t  old_rl2;
 uint8_t    uncached = 0;
 int        writelnext;
-int        writelookup[256];
+int        writelookup[MMU_TLB_SIZE];
 uintptr_t *writelookup2;
 
 uint32_t mem_logical_addr;
@@ -99,7 +100,7 @@ int shadowbios = 0;
 int shadowbios_write;
 int readlnum  = 0;
 int writelnum = 0;
-int cachesize = 256;
+int cachesize = MMU_TLB_SIZE;
 
 uint32_t get_phys_virt;
 uint32_t get_phys_phys;
@@ -110,6 +111,7 @@ int mem_a20_state = 0;
 
 int mmuflush = 0;
 int mmu_perm = 4;
+int mmu_global = 0;
 
 #ifdef USE_NEW_DYNAREC
 uint64_t *byte_dirty_mask;
@@ -130,6 +132,13 @@ uint8_t              *_mem_exec[MEM_MAPPINGS_NO];
 static uint8_t       *page_lookupp; /* pagetable mmu_perm lookup */
 static uint8_t       *readlookupp;
 static uint8_t       *writelookupp;
+static uint32_t       readlookupgen[MMU_TLB_SIZE]; /* generation of the entry, 0 = global (PGE) page */
+static uint32_t       writelookupgen[MMU_TLB_SIZE];
+static uint16_t       readlookup_ng[MMU_TLB_SIZE * 2]; /* non-global slots filled this generation */
+static uint16_t       writelookup_ng[MMU_TLB_SIZE * 2];
+static int            readlnum_ng;
+static int            writelnum_ng;
+static uint32_t       mmu_tlb_gen = 1;
 static mem_mapping_t *base_mapping;
 static mem_mapping_t *last_mapping;
 static mem_mapping_t *read_mapping_bus[MEM_MAPPINGS_NO];
@@ -185,9 +194,11 @@ resetreadlookup(void)
     memset(page_lookup, 0x00, (1 << 20) * sizeof(page_t *));
 
     /* Initialize the tables for lower (<= 1024K) RAM. */
-    for (uint16_t c = 0; c < 256; c++) {
-        readlookup[c]  = 0xffffffff;
-        writelookup[c] = 0xffffffff;
+    for (uint16_t c = 0; c < MMU_TLB_SIZE; c++) {
+        readlookup[c]     = 0xffffffff;
+        readlookupgen[c]  = 0;
+        writelookup[c]    = 0xffffffff;
+        writelookupgen[c] = 0;
     }
 
     /* Initialize the tables for high (> 1024K) RAM. */
@@ -197,21 +208,46 @@ resetreadlookup(void)
     memset(writelookup2, 0xff, (1 << 20) * sizeof(uintptr_t));
     memset(writelookupp, 0x04, (1 << 20) * sizeof(uint8_t));
 
-    readlnext  = 0;
-    writelnext = 0;
-    pccache    = 0xffffffff;
+    readlnext    = 0;
+    readlnum     = 0;
+    readlnum_ng  = 0;
+    writelnext   = 0;
+    writelnum    = 0;
+    writelnum_ng = 0;
+    mmu_tlb_gen  = 1;
+    pccache      = 0xffffffff;
     high_page  = 0;
 }
 
-void
-flushmmucache(void)
+/* Start a new generation. The tags are only compared for equality with the
+   current generation, so on wrap-around it is enough to clear them; every
+   non-global slot is dead at this point. */
+static void
+mmu_tlb_next_gen(void)
 {
-    for (uint16_t c = 0; c < 256; c++) {
+    if (++mmu_tlb_gen == 0) {
+        memset(readlookupgen, 0x00, sizeof(readlookupgen));
+        memset(writelookupgen, 0x00, sizeof(writelookupgen));
+        mmu_tlb_gen = 1;
+    }
+}
+
+/* Invalidate every entry of the software TLB. */
+static void
+mmu_tlb_flush(void)
+{
+    for (int c = 0; c < readlnum; c++) {
         if (readlookup[c] != (int) 0xffffffff) {
             readlookup2[readlookup[c]] = LOOKUP_INV;
             readlookupp[readlookup[c]] = 4;
             readlookup[c]              = 0xffffffff;
         }
+    }
+    readlnum    = 0;
+    readlnext   = 0;
+    readlnum_ng = 0;
+
+    for (int c = 0; c < writelnum; c++) {
         if (writelookup[c] != (int) 0xffffffff) {
             page_lookup[writelookup[c]]  = NULL;
             page_lookupp[writelookup[c]] = 4;
@@ -220,33 +256,99 @@ flushmmucache(void)
             writelookup[c]               = 0xffffffff;
         }
     }
-    mmuflush++;
+    writelnum    = 0;
+    writelnext   = 0;
+    writelnum_ng = 0;
 
-    pccache  = (uint32_t) 0xffffffff;
-    pccache2 = (uint8_t *) 0xffffffff;
-
-#ifdef USE_DYNAREC
-    codegen_flush();
-#endif
+    mmu_tlb_next_gen();
 }
 
-void
-flushmmucache_nopc(void)
+/* Invalidate the non-global entries only. Every non-global entry carries
+   the generation it was filled in and is recorded in the readlookup_ng/
+   writelookup_ng lists, so this touches just the slots filled since the
+   previous reload; the global entries and the rest of the victim lists
+   are left alone. Bumping the generation retires the recorded slots. The
+   inline lookups in the interpreter and the code generators read
+   readlookup2/writelookup2 directly, so the retired slots still have their
+   fast path pointers cleared here. A list that overflowed (a slot refilled
+   alternately as global and non-global) falls back to the full flush. */
+static void
+mmu_tlb_flush_nonglobal(void)
 {
-    for (uint16_t c = 0; c < 256; c++) {
-        if (readlookup[c] != (int) 0xffffffff) {
+    int c;
+
+    if ((readlnum_ng > (MMU_TLB_SIZE * 2)) || (writelnum_ng > (MMU_TLB_SIZE * 2))) {
+        mmu_tlb_flush();
+        return;
+    }
+
+    for (int i = 0; i < readlnum_ng; i++) {
+        c = readlookup_ng[i];
+        if ((readlookup[c] != (int) 0xffffffff) && (readlookupgen[c] == mmu_tlb_gen)) {
             readlookup2[readlookup[c]] = LOOKUP_INV;
             readlookupp[readlookup[c]] = 4;
             readlookup[c]              = 0xffffffff;
+            instru_count(instru_tlb_cr3_invalidated);
         }
-        if (writelookup[c] != (int) 0xffffffff) {
+    }
+    readlnum_ng = 0;
+
+    for (int i = 0; i < writelnum_ng; i++) {
+        c = writelookup_ng[i];
+        if ((writelookup[c] != (int) 0xffffffff) && (writelookupgen[c] == mmu_tlb_gen)) {
             page_lookup[writelookup[c]]  = NULL;
             page_lookupp[writelookup[c]] = 4;
             writelookup2[writelookup[c]] = LOOKUP_INV;
             writelookupp[writelookup[c]] = 4;
             writelookup[c]               = 0xffffffff;
+            instru_count(instru_tlb_cr3_invalidated);
         }
     }
+    writelnum_ng = 0;
+
+    mmu_tlb_next_gen();
+}
+
+void
+flushmmucache(void)
+{
+    instru_count(instru_tlb_flushes);
+    mmu_tlb_flush();
+    mmuflush++;
+
+    pccache  = (uint32_t) 0xffffffff;
+    pccache2 = (uint8_t *) 0xffffffff;
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
+}
+
+/* CR3 reload: like flushmmucache(), but translations of global pages
+   survive while CR4.PGE is set, as they do on the real TLB. */
+void
+flushmmucache_nonglobal(void)
+{
+    instru_count(instru_tlb_cr3_flushes);
+    if (cr4 & CR4_PGE)
+        mmu_tlb_flush_nonglobal();
+    else
+        mmu_tlb_flush();
+    mmuflush++;
+
+    pccache  = (uint32_t) 0xffffffff;
+    pccache2 = (uint8_t *) 0xffffffff;
+
+#ifdef USE_DYNAREC
+    codegen_flush();
+#endif
+}
+
+void
+flushmmucache_nopc(void)
+{
+    instru_count(instru_tlb_flushes);
+    mmu_tlb_flush();
 }
 
 void
@@ -257,7 +359,7 @@ mem_flush_write_page(uint32_t addr, uint32_t virt)
     uint32_t a;
 #endif
 
-    for (uint16_t c = 0; c < 256; c++) {
+    for (int c = 0; c < writelnum; c++) {
         if (writelookup[c] != (int) 0xffffffff) {
 #if (defined __amd64__ || defined _M_X64 || defined __aarch64__ || defined _M_ARM64)
             uintptr_t target = (uintptr_t) &ram[(uintptr_t) (addr & ~0xfff) - (virt & ~0xfff)];
@@ -325,7 +427,8 @@ mmutranslatereal_normal(uint32_t addr, int rw)
             return 0xffffffffffffffffULL;
         }
 
-        mmu_perm = temp & 4;
+        mmu_perm   = temp & 4;
+        mmu_global = (cr4 & CR4_PGE) && (temp & 0x100);
         rammap(addr2) |= (rw ? 0x60 : 0x20);
 
         return (temp & ~0x3fffff) + (addr & 0x3fffff);
@@ -345,7 +448,8 @@ mmutranslatereal_normal(uint32_t addr, int rw)
         return 0xffffffffffffffffULL;
     }
 
-    mmu_perm = temp & 4;
+    mmu_perm   = temp & 4;
+    mmu_global = (cr4 & CR4_PGE) && (temp & 0x100);
     rammap(addr2) |= 0x20;
     rammap((temp2 & ~0xfff) + ((addr >> 10) & 0xffc)) |= (rw ? 0x60 : 0x20);
 
@@ -409,7 +513,8 @@ mmutranslatereal_pae(uint32_t addr, int rw)
 
             return 0xffffffffffffffffULL;
         }
-        mmu_perm = temp & 4;
+        mmu_perm   = temp & 4;
+        mmu_global = (cr4 & CR4_PGE) && (temp & 0x100);
         rammap64(addr3) |= (rw ? 0x60 : 0x20);
 
         return ((temp & ~0x1fffffULL) + (addr & 0x1fffffULL)) & 0x000000ffffffffffULL;
@@ -430,7 +535,8 @@ mmutranslatereal_pae(uint32_t addr, int rw)
         return 0xffffffffffffffffULL;
     }
 
-    mmu_perm = temp & 4;
+    mmu_perm   = temp & 4;
+    mmu_global = (cr4 & CR4_PGE) && (temp & 0x100);
     rammap64(addr3) |= 0x20;
     rammap64(addr4) |= (rw ? 0x60 : 0x20);
 
@@ -604,7 +710,20 @@ addreadlookup(uint32_t virt, uint32_t phys)
 #endif
     readlookupp[virt >> 12] = mmu_perm;
 
+    instru_count(instru_tlb_fills);
+    if ((cr0 >> 31) && mmu_global)
+        readlookupgen[readlnext] = 0;
+    else {
+        if (readlookupgen[readlnext] != mmu_tlb_gen) {
+            if (readlnum_ng < (MMU_TLB_SIZE * 2))
+                readlookup_ng[readlnum_ng] = readlnext;
+            if (readlnum_ng <= (MMU_TLB_SIZE * 2))
+                readlnum_ng++;
+        }
+        readlookupgen[readlnext] = mmu_tlb_gen;
+    }
     readlookup[readlnext++] = virt >> 12;
+    readlnum = MAX(readlnum, readlnext);
     readlnext &= (cachesize - 1);
 
     cycles -= 9;
@@ -657,7 +776,20 @@ addwritelookup(uint32_t virt, uint32_t phys)
     }
     writelookupp[virt >> 12] = mmu_perm;
 
+    instru_count(instru_tlb_fills);
+    if ((cr0 >> 31) && mmu_global)
+        writelookupgen[writelnext] = 0;
+    else {
+        if (writelookupgen[writelnext] != mmu_tlb_gen) {
+            if (writelnum_ng < (MMU_TLB_SIZE * 2))
+                writelookup_ng[writelnum_ng] = writelnext;
+            if (writelnum_ng <= (MMU_TLB_SIZE * 2))
+                writelnum_ng++;
+        }
+        writelookupgen[writelnext] = mmu_tlb_gen;
+    }
     writelookup[writelnext++] = virt >> 12;
+    writelnum = MAX(writelnum, writelnext);
     writelnext &= (cachesize - 1);
 
     cycles -= 9;
@@ -1942,6 +2074,62 @@ mem_write_phys(void *src, uint32_t addr, int transfer_size)
     }
 }
 
+/* Returns where a bus master access at addr lands in the RAM blocks, or
+   NULL if it does not land in guest RAM and has to go through the mapping
+   handlers. This follows what the mem_*_phys() functions do: with the
+   exec path they access map->exec directly, otherwise they call the
+   handlers, which only match a plain copy for the RAM ones. */
+static uint8_t *
+mem_phys_ram_ptr(uint32_t addr, int write)
+{
+    const mem_mapping_t *map = (write ? write_mapping_bus : read_mapping_bus)[addr >> MEM_GRANULARITY_BITS];
+    uint8_t             *p;
+
+    if ((map == NULL) || (map->exec == NULL))
+        return NULL;
+
+    p = &(map->exec[(addr - map->base) & map->mask]);
+
+    if (!cpu_use_exec) {
+        if (write ? (map->write_l != mem_write_raml) : (map->read_l != mem_read_raml))
+            return NULL;
+        if (p != &(ram[addr]))
+            return NULL;
+    }
+
+    if ((p >= ram) && (p < (ram + ram_size)))
+        return p;
+#if (!(defined __amd64__ || defined _M_X64 || defined __aarch64__ || defined _M_ARM64))
+    if ((ram2 != NULL) && (p >= ram2) && (p < (ram2 + ram2_size)))
+        return p;
+#endif
+
+    return NULL;
+}
+
+/* Finds the run of guest RAM a bus master transfer of up to size bytes
+   at addr can be copied to or from directly. Returns the host pointer and
+   sets *len to the length of the run, or returns NULL with *len set to 0
+   if the first byte is not plain RAM. */
+uint8_t *
+mem_phys_ram_run(uint32_t addr, uint32_t size, int write, uint32_t *len)
+{
+    uint8_t *p = mem_phys_ram_ptr(addr, write);
+    uint32_t n = MEM_GRANULARITY_SIZE - (addr & MEM_GRANULARITY_MASK);
+
+    *len = 0;
+    if (p == NULL)
+        return NULL;
+
+    /* Extend the run over the following granules while they continue the
+       same host block. */
+    while ((n < size) && ((addr + n) > addr) && (mem_phys_ram_ptr(addr + n, write) == (p + n)))
+        n += MEM_GRANULARITY_SIZE;
+
+    *len = MIN(n, size);
+    return p;
+}
+
 uint8_t
 mem_read_ram(uint32_t addr, UNUSED(void *priv))
 {
@@ -2896,6 +3084,8 @@ mem_reset(void)
 
     m = 1024UL * (size_t) mem_size;
 
+    /* The blocks come from plat_mmap() already cleared. They are not cleared
+       again here, so the host only backs the pages the guest actually uses. */
 #if (!(defined __amd64__ || defined _M_X64 || defined __aarch64__ || defined _M_ARM64))
     if (mem_size > 1048576) {
         ram_size = 1 << 30;
@@ -2904,7 +3094,6 @@ mem_reset(void)
             fatal("Failed to allocate primary RAM block. Make sure you have enough RAM available.\n");
             return;
         }
-        memset(ram, 0x00, ram_size);
         ram2_size = m - (1 << 30);
         /* Allocate 16 extra bytes of RAM to mitigate some dynarec recompiler memory access quirks. */
         ram2      = (uint8_t *) plat_mmap(ram2_size + 16, 0); /* allocate and clear the RAM block above 1 GB */
@@ -2915,7 +3104,6 @@ mem_reset(void)
                 fatal("Failed to allocate secondary RAM block. Make sure you have enough RAM available.\n");
             return;
         }
-        memset(ram2, 0x00, ram2_size + 16);
     } else
 #endif
     {
@@ -2926,7 +3114,6 @@ mem_reset(void)
             fatal("Failed to allocate RAM block. Make sure you have enough RAM available.\n");
             return;
         }
-        memset(ram, 0x00, ram_size + 16);
         if (mem_size > 1048576)
             ram2 = &(ram[1 << 30]);
     }
@@ -22,11 +22,13 @@
  *          Copyright 2016-2019 Miran Grca.
  *          Copyright 2018-2019 Fred N. van Kempen.
  */
+#include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <wchar.h>
 #define HAVE_STDARG_H
 #include <86box/86box.h>
@@ -35,9 +37,21 @@
 #include <86box/rom.h>
 #include <86box/path.h>
 #include <86box/plat.h>
+#include <86box/plat_dir.h>
 #include <86box/machine.h>
 #include <86box/m_xt_xi8088.h>
 
+#ifndef S_ISDIR
+#    define S_ISDIR(m) (((m) &S_IFMT) == S_IFDIR)
+#endif
+
+#ifdef _WIN32
+#    define stat _stat64
+typedef struct __stat64 stat_t;
+#else
+typedef struct stat stat_t;
+#endif
+
 #ifdef ENABLE_ROM_LOG
 int rom_do_log = ENABLE_ROM_LOG;
 
@@ -56,6 +70,441 @@ rom_log(const char *fmt, ...)
 #    define rom_log(fmt, ...)
 #endif
 
+#define ROM_PAGE 4096
+
+/* ROM images mapped from their files, see rom_map(). */
+typedef struct rom_mapped_t {
+    uint8_t             *ptr;
+    size_t               size;
+    struct rom_mapped_t *next;
+} rom_mapped_t;
+
+static rom_mapped_t *rom_mapped = NULL;
+
+/* Index of the files found under the ROM paths. It is built with one
+   directory walk per path, so rom_present() and the machine and device
+   availability checks on top of it become hash lookups instead of a
+   failed open per candidate path. The index is saved together with the
+   modification times of the directories it walked, so the next start
+   only has to stat those to know it is still current. ROM paths that do
+   not exist are saved as well, with ROM_INDEX_MISSING as the time, so
+   that creating one later is noticed too. */
+#define ROM_INDEX_FILE    "romindex.cache"
+#define ROM_INDEX_BUCKETS 4096
+#define ROM_INDEX_DEPTH   8
+#define ROM_INDEX_MISSING -1LL
+
+/* Windows and macOS file systems are case insensitive by default. */
+#if defined(_WIN32) || defined(__APPLE__)
+#    define ROM_INDEX_FOLD(c) tolower((unsigned char) (c))
+#else
+#    define ROM_INDEX_FOLD(c) (c)
+#endif
+
+typedef struct rom_index_entry_t {
+    uint32_t                  hash;
+    int                       path; /* first ROM path holding the file */
+    struct rom_index_entry_t *next;
+    char                      name[];
+} rom_index_entry_t;
+
+typedef struct rom_index_dir_t {
+    int64_t                 mtime;
+    struct rom_index_dir_t *next;
+    char                    path[];
+} rom_index_dir_t;
+
+static rom_index_entry_t *rom_index[ROM_INDEX_BUCKETS];
+static rom_index_dir_t   *rom_index_dirs  = NULL;
+static uint32_t           rom_index_files = 0;
+static int                rom_index_built = 0;
+static int                rom_index_stale = 0; /* saved index missed a file */
+
+/* Bumped every time the index is built, so that anything derived from the
+   ROM set knows to check again. */
+uint32_t rom_index_generation = 0;
+
+static uint32_t
+rom_index_hash(const char *name)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    while (*name) {
+        hash ^= (uint8_t) ROM_INDEX_FOLD(*name++);
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+static int
+rom_index_match(const char *a, const char *b)
+{
+    while (*a && (ROM_INDEX_FOLD(*a) == ROM_INDEX_FOLD(*b))) {
+        a++;
+        b++;
+    }
+
+    return *a == *b;
+}
+
+static rom_index_entry_t *
+rom_index_find(const char *name)
+{
+    uint32_t           hash = rom_index_hash(name);
+    rom_index_entry_t *entry;
+
+    for (entry = rom_index[hash & (ROM_INDEX_BUCKETS - 1)]; entry != NULL; entry = entry->next) {
+        if ((entry->hash == hash) && rom_index_match(entry->name, name))
+            return entry;
+    }
+
+    return NULL;
+}
+
+static void
+rom_index_add(const char *name, int path)
+{
+    rom_index_entry_t *entry;
+    size_t             len = strlen(name) + 1;
+
+    /* Keep the first path, rom_fopen() tries them in order. */
+    if (rom_index_find(name) != NULL)
+        return;
+
+    entry = (rom_index_entry_t *) malloc(sizeof(rom_index_entry_t) + len);
+    if (entry == NULL)
+        return;
+
+    entry->hash = rom_index_hash(name);
+    entry->path = path;
+    memcpy(entry->name, name, len);
+    entry->next                                     = rom_index[entry->hash & (ROM_INDEX_BUCKETS - 1)];
+    rom_index[entry->hash & (ROM_INDEX_BUCKETS - 1)] = entry;
+    rom_index_files++;
+}
+
+static void
+rom_index_add_dir(const char *path, int64_t mtime)
+{
+    size_t           len = strlen(path) + 1;
+    rom_index_dir_t *dir = (rom_index_dir_t *) malloc(sizeof(rom_index_dir_t) + len);
+
+    if (dir == NULL)
+        return;
+
+    dir->mtime = mtime;
+    memcpy(dir->path, path, len);
+    dir->next      = rom_index_dirs;
+    rom_index_dirs = dir;
+}
+
+static void
+rom_index_clear(void)
+{
+    rom_index_entry_t *entry;
+    rom_index_dir_t   *dir;
+
+    for (int i = 0; i < ROM_INDEX_BUCKETS; i++) {
+        while (rom_index[i] != NULL) {
+            entry        = rom_index[i];
+            rom_index[i] = entry->next;
+            free(entry);
+        }
+    }
+
+    while (rom_index_dirs != NULL) {
+        dir            = rom_index_dirs;
+        rom_index_dirs = dir->next;
+        free(dir);
+    }
+
+    rom_index_files = 0;
+    rom_index_built = 0;
+}
+
+/* Windows does not stat a directory given with a trailing separator. */
+static int
+rom_index_stat(const char *path, stat_t *st)
+{
+    char   temp[1024];
+    size_t len;
+
+    snprintf(temp, sizeof(temp), "%s", path);
+    len = strlen(temp);
+    while ((len > 1) && ((temp[len - 1] == '/') || (temp[len - 1] == '\\')) && (temp[len - 2] != ':'))
+        temp[--len] = '\0';
+
+    return stat(temp, st);
+}
+
+/* Directories on the way down from a ROM path, to stop at symbolic links
+   that lead back to one of them. */
+typedef struct rom_index_walk_t {
+    dev_t                          dev;
+    ino_t                          ino;
+    const struct rom_index_walk_t *parent;
+} rom_index_walk_t;
+
+static int
+rom_index_walk_loops(const rom_index_walk_t *walk, const stat_t *st)
+{
+    /* Windows does not report inode numbers, it only gets the depth limit. */
+    if (st->st_ino == 0)
+        return 0;
+
+    for (; walk != NULL; walk = walk->parent) {
+        if ((walk->dev == st->st_dev) && (walk->ino == st->st_ino))
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Walk one directory below a ROM path. The names are kept relative to the
+   ROM path, with forward slashes, as they appear in the "roms/" names. */
+static void
+rom_index_scan(int path, const char *dir, const char *rel, int depth, const rom_index_walk_t *parent)
+{
+    char             full[1024];
+    char             name[1024];
+    struct dirent   *dirent;
+    rom_index_walk_t walk;
+    stat_t           st;
+    DIR             *dirp;
+
+    if ((rom_index_stat(dir, &st) != 0) || !S_ISDIR(st.st_mode)) {
+        if (depth == 0)
+            rom_index_add_dir(dir, ROM_INDEX_MISSING);
+        return;
+    }
+
+    if (rom_index_walk_loops(parent, &st)) {
+        rom_log("ROM index: %s loops back, skipped\n", dir);
+        return;
+    }
+
+    walk.dev    = st.st_dev;
+    walk.ino    = st.st_ino;
+    walk.parent = parent;
+
+    rom_index_add_dir(dir, (int64_t) st.st_mtime);
+
+    dirp = opendir(dir);
+    if (dirp == NULL)
+        return;
+
+    while ((dirent = readdir(dirp)) != NULL) {
+        if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, ".."))
+            continue;
+
+        path_append_filename(full, dir, dirent->d_name);
+        snprintf(name, sizeof(name), "%s%s%s", rel, rel[0] ? "/" : "", dirent->d_name);
+
+        if (stat(full, &st) != 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < ROM_INDEX_DEPTH)
+                rom_index_scan(path, full, name, depth + 1, &walk);
+        } else
+            rom_index_add(name, path);
+    }
+
+    closedir(dirp);
+}
+
+static void
+rom_index_cache_path(char *fn, const char *name)
+{
+    char dir[256] = { 0 };
+
+    plat_get_global_config_dir(dir, sizeof(dir) - 1);
+    path_append_filename(fn, dir, name);
+}
+
+static int
+rom_index_load(void)
+{
+    char        fn[1024];
+    char        line[2048];
+    rom_path_t *rom_path = &rom_paths;
+    stat_t      st;
+    FILE       *fp;
+    char       *p;
+    long long   mtime;
+    int         path;
+    uint32_t    files = 0;
+    uint32_t    count;
+    int         ended = 0;
+    int         ret   = 1;
+
+    rom_index_cache_path(fn, ROM_INDEX_FILE);
+    fp = plat_fopen(fn, "rb");
+    if (fp == NULL)
+        return 0;
+
+    if ((fgets(line, sizeof(line), fp) == NULL) || strcmp(line, "86Box ROM index 1\n"))
+        ret = 0;
+
+    while (ret && (fgets(line, sizeof(line), fp) != NULL)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        /* Nothing may follow the end marker. */
+        if (ended) {
+            ret = 0;
+            break;
+        }
+
+        switch (line[0]) {
+            case 'P':
+                /* The ROM paths must be the same ones, in the same order. */
+                if ((rom_path == NULL) || strcmp(&line[2], rom_path->path))
+                    ret = 0;
+                else
+                    rom_path = rom_path->next;
+                break;
+
+            case 'D':
+                if ((sscanf(&line[2], "%lld", &mtime) != 1) || ((p = strchr(&line[2], ' ')) == NULL))
+                    ret = 0;
+                else if ((rom_index_stat(p + 1, &st) != 0) || !S_ISDIR(st.st_mode)) {
+                    /* Still valid if the directory was already missing. */
+                    if (mtime != ROM_INDEX_MISSING)
+                        ret = 0;
+                } else if ((mtime == ROM_INDEX_MISSING) || ((int64_t) st.st_mtime != mtime))
+                    ret = 0;
+
+                if (ret)
+                    rom_index_add_dir(p + 1, mtime);
+                break;
+
+            case 'F':
+                if ((sscanf(&line[2], "%i", &path) != 1) || ((p = strchr(&line[2], ' ')) == NULL))
+                    ret = 0;
+                else {
+                    rom_index_add(p + 1, path);
+                    files++;
+                }
+                break;
+
+            case 'E':
+                /* The end marker with the number of files, a file cut short
+                   by a crash or by another instance writing it is rejected. */
+                if ((sscanf(&line[2], "%u", &count) != 1) || (count != files))
+                    ret = 0;
+                ended = 1;
+                break;
+
+            default:
+                ret = 0;
+                break;
+        }
+    }
+
+    if ((rom_path != NULL) || !ended)
+        ret = 0;
+
+    fclose(fp);
+
+    if (!ret)
+        rom_index_clear();
+
+    return ret;
+}
+
+/* Writes the index to a temporary file first and renames it over the old
+   one, so that other instances never see a partly written index. */
+static void
+rom_index_save(void)
+{
+    char               fn[1024];
+    char               temp[1024];
+    char               name[256];
+    rom_index_entry_t *entry;
+    uint32_t           files = 0;
+    FILE              *fp;
+    int                ret;
+
+    rom_index_cache_path(fn, ROM_INDEX_FILE);
+    plat_tempfile(name, ROM_INDEX_FILE, ".tmp");
+    rom_index_cache_path(temp, name);
+    fp = plat_fopen(temp, "wb");
+    if (fp == NULL)
+        return;
+
+    fprintf(fp, "86Box ROM index 1\n");
+    for (rom_path_t *rom_path = &rom_paths; rom_path != NULL; rom_path = rom_path->next)
+        fprintf(fp, "P %s\n", rom_path->path);
+    for (rom_index_dir_t *dir = rom_index_dirs; dir != NULL; dir = dir->next)
+        fprintf(fp, "D %lld %s\n", (long long) dir->mtime, dir->path);
+    for (int i = 0; i < ROM_INDEX_BUCKETS; i++) {
+        for (entry = rom_index[i]; entry != NULL; entry = entry->next) {
+            fprintf(fp, "F %i %s\n", entry->path, entry->name);
+            files++;
+        }
+    }
+    fprintf(fp, "E %u\n", files);
+
+    ret = !ferror(fp);
+    if (fclose(fp))
+        ret = 0;
+
+#ifdef _WIN32
+    if (ret)
+        remove(fn);
+#endif
+    if (!ret || rename(temp, fn))
+        remove(temp);
+}
+
+static void
+rom_index_build(void)
+{
+    uint32_t start = plat_get_ticks();
+    int      path  = 0;
+    int      warm;
+
+    warm            = !rom_index_stale && rom_index_load();
+    rom_index_stale = 0;
+    if (!warm) {
+        for (rom_path_t *rom_path = &rom_paths; rom_path != NULL; rom_path = rom_path->next)
+            rom_index_scan(path++, rom_path->path, "", 0, NULL);
+
+        rom_index_save();
+    }
+
+    rom_index_built = 1;
+    rom_index_generation++;
+
+    pclog("ROM index: %u files in %u ms (%s)\n", rom_index_files, plat_get_ticks() - start,
+          warm ? "revalidated" : "scanned");
+}
+
+/* Look up a "roms/" name. Returns the full path of the first copy in s,
+   or 0 if no ROM path has it. */
+static int
+rom_index_lookup(const char *fn, char *s)
+{
+    rom_index_entry_t *entry;
+    rom_path_t        *rom_path = &rom_paths;
+
+    if (!rom_index_built)
+        rom_index_build();
+
+    entry = rom_index_find(fn + 5);
+    if (entry == NULL)
+        return 0;
+
+    for (int i = 0; (i < entry->path) && (rom_path != NULL); i++)
+        rom_path = rom_path->next;
+    if (rom_path == NULL)
+        return 0;
+
+    path_append_filename(s, rom_path->path, fn + 5);
+    return 1;
+}
+
 void
 rom_add_path(const char *path)
 {
@@ -84,25 +533,47 @@ rom_add_path(const char *path)
 
     // Ensure the path ends with a separator.
     path_slash(rom_path->path);
+
+    /* Rebuild the index with the new path on the next lookup. */
+    rom_index_clear();
+}
+
+/* Look for a "roms/" name the index does not have by trying every ROM
+   path, as the index may be out of date: a file added since the last
+   scan, in a directory whose time the file system did not update, or
+   below the depth limit. If it is found, the index is rebuilt on the next
+   lookup. */
+static int
+rom_index_miss(const char *fn, char *s)
+{
+    FILE *fp;
+
+    for (rom_path_t *rom_path = &rom_paths; rom_path != NULL; rom_path = rom_path->next) {
+        path_append_filename(s, rom_path->path, fn + 5);
+
+        if ((fp = plat_fopen(s, "rb")) != NULL) {
+            (void) fclose(fp);
+            rom_log("ROM index: %s is not indexed, rebuilding\n", fn);
+            rom_index_clear();
+            rom_index_stale = 1;
+            return 1;
+        }
+    }
+
+    return 0;
 }
 
 FILE *
 rom_fopen(const char *fn, char *mode)
 {
-    char        temp[1024];
-    FILE       *fp = NULL;
+    char temp[1024];
 
     if (strstr(fn, "roms/") == fn) {
         /* Relative path */
-        for (rom_path_t *rom_path = &rom_paths; rom_path != NULL; rom_path = rom_path->next) {
-            path_append_filename(temp, rom_path->path, fn + 5);
+        if (!rom_index_lookup(fn, temp) && !rom_index_miss(fn, temp))
+            return NULL;
 
-            if ((fp = plat_fopen(temp, mode)) != NULL) {
-                return fp;
-            }
-        }
-
-        return fp;
+        return plat_fopen(temp, mode);
     } else {
         /* Absolute path */
         return plat_fopen(fn, mode);
@@ -112,20 +583,15 @@ rom_fopen(const char *fn, char *mode)
 int
 rom_getfile(char *fn, char *s, int size)
 {
-    char        temp[1024];
+    char temp[1024];
 
     if (strstr(fn, "roms/") == fn) {
         /* Relative path */
-        for (rom_path_t *rom_path = &rom_paths; rom_path != NULL; rom_path = rom_path->next) {
-            path_append_filename(temp, rom_path->path, fn + 5);
-
-            if (rom_present(temp)) {
-                strncpy(s, temp, size);
-                return 1;
-            }
-        }
+        if (!rom_index_lookup(fn, temp) && !rom_index_miss(fn, temp))
+            return 0;
 
-        return 0;
+        strncpy(s, temp, size);
+        return 1;
     } else {
         /* Absolute path */
         if (rom_present(fn)) {
@@ -140,9 +606,13 @@ rom_getfile(char *fn, char *s, int size)
 int
 rom_present(const char *fn)
 {
+    char  temp[1024];
     FILE *fp;
 
-    fp = rom_fopen(fn, "rb");
+    if (strstr(fn, "roms/") == fn)
+        return rom_index_lookup(fn, temp);
+
+    fp = plat_fopen(fn, "rb");
     if (fp != NULL) {
         (void) fclose(fp);
         return 1;
@@ -236,6 +706,59 @@ rom_load_linear_oddeven(const char *fn, uint32_t addr, int sz, int off, uint8_t
     return 1;
 }
 
+/* Maps sz bytes of a ROM image copy-on-write from its file, so all the
+   instances running the same ROM share its pages. Returns NULL if the
+   image can not be mapped whole, the caller then reads it in. */
+static uint8_t *
+rom_map(const char *fn, int off, int sz)
+{
+    char          path[1024];
+    uint8_t      *ptr;
+    rom_mapped_t *mapped;
+
+    if ((sz <= 0) || (sz & (ROM_PAGE - 1)) || (off & (ROM_PAGE - 1)) || !rom_getfile((char *) fn, path, sizeof(path)))
+        return NULL;
+
+    ptr = (uint8_t *) plat_mmap(sz, 0);
+    if (ptr == NULL)
+        return NULL;
+
+    mapped = (rom_mapped_t *) malloc(sizeof(rom_mapped_t));
+    if ((mapped == NULL) || !plat_mmap_file(ptr, sz, path, off)) {
+        free(mapped);
+        plat_munmap(ptr, sz);
+        return NULL;
+    }
+
+    mapped->ptr  = ptr;
+    mapped->size = sz;
+    mapped->next = rom_mapped;
+    rom_mapped   = mapped;
+
+    rom_log("ROM: mapped %i bytes of '%s'\n", sz, path);
+
+    return ptr;
+}
+
+/* Frees a ROM buffer, whether it was mapped or allocated. */
+void
+rom_free(uint8_t *ptr)
+{
+    rom_mapped_t **prev = &rom_mapped;
+
+    for (rom_mapped_t *mapped = rom_mapped; mapped != NULL; mapped = mapped->next) {
+        if (mapped->ptr == ptr) {
+            *prev = mapped->next;
+            plat_munmap(ptr, mapped->size);
+            free(mapped);
+            return;
+        }
+        prev = &mapped->next;
+    }
+
+    free(ptr);
+}
+
 /* Load a ROM BIOS from its chips, interleaved mode. */
 int
 rom_load_linear(const char *fn, uint32_t addr, int sz, int off, uint8_t *ptr)
@@ -377,7 +900,7 @@ rom_reset(uint32_t addr, int sz)
     /* If not done yet, allocate a 128KB buffer for the BIOS ROM. */
     if (rom != NULL) {
         rom_log("ROM allocated, freeing...\n");
-        free(rom);
+        rom_free(rom);
         rom = NULL;
     }
     rom_log("Allocating ROM...\n");
@@ -505,7 +1028,13 @@ bios_load(const char *fn1, const char *fn2, uint32_t addr, int sz, int off, int
         rom_log("%sing %i bytes of %sBIOS starting with ptr[%08X] (ptr = %08X)\n", (bios_only) ? "Check" : "Load", sz, (flags & FLAG_AUX) ? "auxiliary " : "", addr - biosaddr, ptr);
 #endif
 
-    if (flags & FLAG_INT)
+    /* A single image covering the whole BIOS is mapped instead of read. */
+    if (!bios_only && !(flags & (FLAG_AUX | FLAG_INT | FLAG_INV)) && (addr == biosaddr) && (sz == (biosmask + 1)) &&
+        ((ptr = rom_map(fn1, off, sz)) != NULL)) {
+        rom_free(rom);
+        rom = ptr;
+        ret = 1;
+    } else if (flags & FLAG_INT)
         ret = rom_load_interleaved(fn1, fn2, addr - biosaddr, sz, off, ptr);
     else {
         if (flags & FLAG_INV)
@@ -574,16 +1103,21 @@ rom_init(rom_t *rom, const char *fn, uint32_t addr, int sz, int mask, int off, u
 {
     rom_log("rom_init(%08X, %s, %08X, %08X, %08X, %08X, %08X)\n", rom, fn, addr, sz, mask, off, flags);
 
-    /* Allocate a buffer for the image. */
-    rom->rom = malloc(sz);
-    memset(rom->rom, 0xff, sz);
+    /* Images loaded at the start of the buffer are mapped instead, if possible. */
+    rom->rom = ((addr >= 0x40000) || !(addr & 0x03ffff)) ? rom_map(fn, off, sz) : NULL;
 
-    /* Load the image file into the buffer. */
-    if (!rom_load_linear(fn, addr, sz, off, rom->rom)) {
-        /* Nope.. clean up. */
-        free(rom->rom);
-        rom->rom = NULL;
-        return (-1);
+    if (rom->rom == NULL) {
+        /* Allocate a buffer for the image. */
+        rom->rom = malloc(sz);
+        memset(rom->rom, 0xff, sz);
+
+        /* Load the image file into the buffer. */
+        if (!rom_load_linear(fn, addr, sz, off, rom->rom)) {
+            /* Nope.. clean up. */
+            free(rom->rom);
+            rom->rom = NULL;
+            return (-1);
+        }
     }
 
     rom->sz   = sz;
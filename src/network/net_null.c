@@ -52,7 +52,7 @@ enum {
  * excluding NET_EVENT_RX. */
 #define NET_EVENT_TX_MAX NET_EVENT_RX
 
-#define NULL_PKT_BATCH NET_QUEUE_LEN
+#define NULL_PKT_BATCH NET_PKT_BATCH
 
 typedef struct net_null_t {
     uint8_t    mac_addr[6];
@@ -107,10 +107,13 @@ net_null_thread(void *priv)
 
             case NET_EVENT_TX:
                 net_event_clear(&net_null->tx_event);
-                int packets = network_tx_popv(net_null->card, net_null->pktv, NULL_PKT_BATCH);
-                for (int i = 0; i < packets; i++) {
-                    net_null_log("Null Network: Ignoring TX packet (%d bytes)\n", net_null->pktv[i].len);
-                }
+                int packets;
+                do {
+                    packets = network_tx_popv(net_null->card, net_null->pktv, NULL_PKT_BATCH);
+                    for (int i = 0; i < packets; i++) {
+                        net_null_log("Null Network: Ignoring TX packet (%d bytes)\n", net_null->pktv[i].len);
+                    }
+                } while (packets == NULL_PKT_BATCH);
                 break;
 
             default:
@@ -147,10 +150,13 @@ net_null_thread(void *priv)
         if (pfd[NET_EVENT_TX].revents & POLLIN) {
             net_event_clear(&net_null->tx_event);
 
-            int packets = network_tx_popv(net_null->card, net_null->pktv, NULL_PKT_BATCH);
-            for (int i = 0; i < packets; i++) {
-                net_null_log("Null Network: Ignoring TX packet (%d bytes)\n", net_null->pktv[i].len);
-            }
+            int packets;
+            do {
+                packets = network_tx_popv(net_null->card, net_null->pktv, NULL_PKT_BATCH);
+                for (int i = 0; i < packets; i++) {
+                    net_null_log("Null Network: Ignoring TX packet (%d bytes)\n", net_null->pktv[i].len);
+                }
+            } while (packets == NULL_PKT_BATCH);
         }
     }
 
@@ -70,7 +70,7 @@
 #include <86box/network.h>
 #include <86box/net_event.h>
 
-#define PCAP_PKT_BATCH NET_QUEUE_LEN
+#define PCAP_PKT_BATCH NET_PKT_BATCH
 
 enum {
     NET_EVENT_STOP = 0,
@@ -284,13 +284,16 @@ net_pcap_thread(void *priv)
 
             case NET_EVENT_TX:
                 net_event_clear(&pcap->tx_event);
-                int packets = network_tx_popv(pcap->card, pcap->pktv, PCAP_PKT_BATCH);
-                for (int i = 0; i < packets; i++) {
-                    h.caplen = pcap->pktv[i].len;
-                    f_pcap_sendqueue_queue(pcap->pcap_queue, &h, pcap->pktv[i].data);
-                }
-                f_pcap_sendqueue_transmit(pcap->pcap, pcap->pcap_queue, 0);
-                pcap->pcap_queue->len = 0;
+                int packets;
+                do {
+                    packets = network_tx_popv(pcap->card, pcap->pktv, PCAP_PKT_BATCH);
+                    for (int i = 0; i < packets; i++) {
+                        h.caplen = pcap->pktv[i].len;
+                        f_pcap_sendqueue_queue(pcap->pcap_queue, &h, pcap->pktv[i].data);
+                    }
+                    f_pcap_sendqueue_transmit(pcap->pcap, pcap->pcap_queue, 0);
+                    pcap->pcap_queue->len = 0;
+                } while (packets == PCAP_PKT_BATCH);
                 break;
 
             case NET_EVENT_RX:
@@ -334,10 +337,13 @@ net_pcap_thread(void *priv)
         if (pfd[NET_EVENT_TX].revents & POLLIN) {
             net_event_clear(&pcap->tx_event);
 
-            int packets = network_tx_popv(pcap->card, pcap->pktv, PCAP_PKT_BATCH);
-            for (int i = 0; i < packets; i++) {
-                net_pcap_in(pcap->pcap, pcap->pktv[i].data, pcap->pktv[i].len);
-            }
+            int packets;
+            do {
+                packets = network_tx_popv(pcap->card, pcap->pktv, PCAP_PKT_BATCH);
+                for (int i = 0; i < packets; i++) {
+                    net_pcap_in(pcap->pcap, pcap->pktv[i].data, pcap->pktv[i].len);
+                }
+            } while (packets == PCAP_PKT_BATCH);
         }
 
         if (pfd[NET_EVENT_RX].revents & POLLIN) {
@@ -50,7 +50,7 @@
 #endif
 #include <86box/net_event.h>
 
-#define SLIRP_PKT_BATCH NET_QUEUE_LEN
+#define SLIRP_PKT_BATCH NET_PKT_BATCH
 
 enum {
     NET_EVENT_STOP = 0,
@@ -352,10 +352,13 @@ net_slirp_thread(void *priv)
 
             case NET_EVENT_TX:
                 {
-                    int packets = network_tx_popv(slirp->card, slirp->pkt_tx_v, SLIRP_PKT_BATCH);
-                    for (int i = 0; i < packets; i++) {
-                        net_slirp_in(slirp, slirp->pkt_tx_v[i].data, slirp->pkt_tx_v[i].len);
-                    }
+                    int packets;
+                    do {
+                        packets = network_tx_popv(slirp->card, slirp->pkt_tx_v, SLIRP_PKT_BATCH);
+                        for (int i = 0; i < packets; i++) {
+                            net_slirp_in(slirp, slirp->pkt_tx_v[i].data, slirp->pkt_tx_v[i].len);
+                        }
+                    } while (packets == SLIRP_PKT_BATCH);
                 }
                 break;
 
@@ -398,10 +401,13 @@ net_slirp_thread(void *priv)
         if (slirp->pfd[NET_EVENT_TX].revents & POLLIN) {
             net_event_clear(&slirp->tx_event);
 
-            int packets = network_tx_popv(slirp->card, slirp->pkt_tx_v, SLIRP_PKT_BATCH);
-            for (int i = 0; i < packets; i++) {
-                net_slirp_in(slirp, slirp->pkt_tx_v[i].data, slirp->pkt_tx_v[i].len);
-            }
+            int packets;
+            do {
+                packets = network_tx_popv(slirp->card, slirp->pkt_tx_v, SLIRP_PKT_BATCH);
+                for (int i = 0; i < packets; i++) {
+                    net_slirp_in(slirp, slirp->pkt_tx_v[i].data, slirp->pkt_tx_v[i].len);
+                }
+            } while (packets == SLIRP_PKT_BATCH);
         }
     }
 
@@ -46,7 +46,7 @@
 #include <86box/network.h>
 #include <86box/net_event.h>
 
-#define VDE_PKT_BATCH NET_QUEUE_LEN
+#define VDE_PKT_BATCH NET_PKT_BATCH
 #define VDE_DESCRIPTION "86Box virtual card"
 
 enum {
@@ -150,13 +150,16 @@ static void net_vde_thread(void *priv) {
         // There are packets queued to transmit
         if (pfd[NET_EVENT_TX].revents & POLLIN) {
             net_event_clear(&vde->tx_event);
-            int packets = network_tx_popv(vde->card, vde->pktv, VDE_PKT_BATCH);
-            for (int i=0; i<packets; i++) {
-                int nc = f_vde_send(vde->vdeconn, vde->pktv[i].data,vde->pktv[i].len, 0 );
-                if (nc == 0) {
-                    vde_log("VDE: Problem, no bytes sent.\n");
+            int packets;
+            do {
+                packets = network_tx_popv(vde->card, vde->pktv, VDE_PKT_BATCH);
+                for (int i=0; i<packets; i++) {
+                    int nc = f_vde_send(vde->vdeconn, vde->pktv[i].data,vde->pktv[i].len, 0 );
+                    if (nc == 0) {
+                        vde_log("VDE: Problem, no bytes sent.\n");
+                    }
                 }
-            }
+            } while (packets == VDE_PKT_BATCH);
         }
 
         // Packets are available for reading. Read packet and queue it
@@ -120,6 +120,8 @@ int  network_ndev;
 netdev_t network_devs[NET_HOST_INTF_MAX];
 
 /* Local variables. */
+static netcard_t *network_cards[NET_CARD_MAX];
+
 #ifdef ENABLE_NETWORK_LOG
 int             network_do_log = ENABLE_NETWORK_LOG;
 static FILE    *network_dump   = NULL;
@@ -261,26 +263,54 @@ network_init(void)
 #endif
 }
 
-void
-network_queue_init(netqueue_t *queue)
+/*
+ * The packet queues are single-producer, single-consumer rings:
+ *
+ *  RX:      host backend thread -> emulation thread (NIC)
+ *  TX_VM:   emulation thread (NIC) -> emulation thread (pacing timer)
+ *  TX_HOST: emulation thread (pacing timer) -> host backend thread
+ *
+ * The producer only writes the head, and the consumer only writes the tail,
+ * so no locking is needed as long as each side stays on a single thread.
+ */
+struct netqueue_t {
+    netpkt_t  *packets;
+    int        mask;
+    atomic_int head; /* Only written by the producer. */
+    atomic_int tail; /* Only written by the consumer. */
+};
+
+netqueue_t *
+network_queue_init(int len)
 {
-    queue->head = queue->tail = 0;
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
+    netqueue_t *queue = calloc(1, sizeof(netqueue_t));
+
+    queue->packets = calloc(len, sizeof(netpkt_t));
+    queue->mask    = len - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    for (int i = 0; i < len; i++) {
         queue->packets[i].data = calloc(1, NET_MAX_FRAME);
         queue->packets[i].len  = 0;
     }
+
+    return queue;
 }
 
 static bool
 network_queue_full(netqueue_t *queue)
 {
-    return ((queue->head + 1) & NET_QUEUE_LEN_MASK) == queue->tail;
+    int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    return ((head + 1) & queue->mask) == atomic_load_explicit(&queue->tail, memory_order_acquire);
 }
 
 static bool
 network_queue_empty(netqueue_t *queue)
 {
-    return (queue->head == queue->tail);
+    int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    return (atomic_load_explicit(&queue->head, memory_order_acquire) == tail);
 }
 
 static inline void
@@ -291,6 +321,36 @@ network_swap_packet(netpkt_t *pkt1, netpkt_t *pkt2)
     *pkt1        = tmp;
 }
 
+/* Publish the packet at the head to the consumer. */
+static inline void
+network_queue_push(netqueue_t *queue)
+{
+    int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    atomic_store_explicit(&queue->head, (head + 1) & queue->mask, memory_order_release);
+}
+
+/* Hand the packet at the tail back to the producer. */
+static inline void
+network_queue_pop(netqueue_t *queue)
+{
+    int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&queue->tail, (tail + 1) & queue->mask, memory_order_release);
+}
+
+static inline netpkt_t *
+network_queue_head(netqueue_t *queue)
+{
+    return &queue->packets[atomic_load_explicit(&queue->head, memory_order_relaxed)];
+}
+
+static inline netpkt_t *
+network_queue_tail(netqueue_t *queue)
+{
+    return &queue->packets[atomic_load_explicit(&queue->tail, memory_order_relaxed)];
+}
+
 int
 network_queue_put(netqueue_t *queue, uint8_t *data, int len)
 {
@@ -298,10 +358,10 @@ network_queue_put(netqueue_t *queue, uint8_t *data, int len)
         return 0;
     }
 
-    netpkt_t *pkt = &queue->packets[queue->head];
+    netpkt_t *pkt = network_queue_head(queue);
     memcpy(pkt->data, data, len);
-    pkt->len    = len;
-    queue->head = (queue->head + 1) & NET_QUEUE_LEN_MASK;
+    pkt->len = len;
+    network_queue_push(queue);
     return 1;
 }
 
@@ -321,10 +381,10 @@ network_queue_put_swap(netqueue_t *queue, netpkt_t *src_pkt)
         return 0;
     }
 
-    netpkt_t *dst_pkt = &queue->packets[queue->head];
+    netpkt_t *dst_pkt = network_queue_head(queue);
     network_swap_packet(src_pkt, dst_pkt);
 
-    queue->head = (queue->head + 1) & NET_QUEUE_LEN_MASK;
+    network_queue_push(queue);
     return 1;
 }
 
@@ -334,9 +394,9 @@ network_queue_get_swap(netqueue_t *queue, netpkt_t *dst_pkt)
     if (network_queue_empty(queue))
         return 0;
 
-    netpkt_t *src_pkt = &queue->packets[queue->tail];
+    netpkt_t *src_pkt = network_queue_tail(queue);
     network_swap_packet(src_pkt, dst_pkt);
-    queue->tail = (queue->tail + 1) & NET_QUEUE_LEN_MASK;
+    network_queue_pop(queue);
     return 1;
 }
 
@@ -350,12 +410,12 @@ network_queue_move(netqueue_t *dst_q, netqueue_t *src_q)
         return 0;
     }
 
-    netpkt_t *src_pkt = &src_q->packets[src_q->tail];
-    netpkt_t *dst_pkt = &dst_q->packets[dst_q->head];
+    netpkt_t *src_pkt = network_queue_tail(src_q);
+    netpkt_t *dst_pkt = network_queue_head(dst_q);
 
     network_swap_packet(src_pkt, dst_pkt);
-    dst_q->head = (dst_q->head + 1) & NET_QUEUE_LEN_MASK;
-    src_q->tail = (src_q->tail + 1) & NET_QUEUE_LEN_MASK;
+    network_queue_push(dst_q);
+    network_queue_pop(src_q);
 
     return dst_pkt->len;
 }
@@ -363,11 +423,36 @@ network_queue_move(netqueue_t *dst_q, netqueue_t *src_q)
 void
 network_queue_clear(netqueue_t *queue)
 {
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
+    for (int i = 0; i <= queue->mask; i++) {
         free(queue->packets[i].data);
         queue->packets[i].len = 0;
     }
-    queue->tail = queue->head = 0;
+    free(queue->packets);
+    free(queue);
+}
+
+/* Round the configured queue length to a supported power of 2. */
+static int
+network_queue_len(int len)
+{
+    int ret = NET_QUEUE_LEN_MIN;
+
+    if (len <= 0)
+        len = NET_QUEUE_LEN;
+
+    while ((ret < len) && (ret < NET_QUEUE_LEN_MAX))
+        ret <<= 1;
+
+    return ret;
+}
+
+/* Is there anything left for the pacing timer to do? */
+static bool
+network_pending(netcard_t *card)
+{
+    return (card->queued_pkt.len != 0) || !network_queue_empty(card->queues[NET_QUEUE_RX]) ||
+           !network_queue_empty(card->queues[NET_QUEUE_TX_VM]) ||
+           (net_cards_conf[card->card_num].link_state != card->link_state);
 }
 
 static void
@@ -383,11 +468,9 @@ network_rx_queue(void *priv)
     }
 
     uint32_t rx_bytes = 0;
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
+    for (int i = 0; i <= card->queues[NET_QUEUE_RX]->mask; i++) {
         if (card->queued_pkt.len == 0) {
-            thread_wait_mutex(card->rx_mutex);
-            int res = network_queue_get_swap(&card->queues[NET_QUEUE_RX], &card->queued_pkt);
-            thread_release_mutex(card->rx_mutex);
+            int res = network_queue_get_swap(card->queues[NET_QUEUE_RX], &card->queued_pkt);
             if (!res)
                 break;
         }
@@ -402,25 +485,17 @@ network_rx_queue(void *priv)
 
     /* Transmission. */
     uint32_t tx_bytes = 0;
-    thread_wait_mutex(card->tx_mutex);
-    for (int i = 0; i < NET_QUEUE_LEN; i++) {
-        uint32_t bytes = network_queue_move(&card->queues[NET_QUEUE_TX_HOST], &card->queues[NET_QUEUE_TX_VM]);
+    for (int i = 0; i <= card->queues[NET_QUEUE_TX_VM]->mask; i++) {
+        uint32_t bytes = network_queue_move(card->queues[NET_QUEUE_TX_HOST], card->queues[NET_QUEUE_TX_VM]);
         if (!bytes)
             break;
         tx_bytes += bytes;
     }
-    thread_release_mutex(card->tx_mutex);
     if (tx_bytes) {
         /* Notify host that a packet is available in the TX queue */
         card->host_drv.notify_in(card->host_drv.priv);
     }
 
-    double timer_period = card->byte_period * (rx_bytes > tx_bytes ? rx_bytes : tx_bytes);
-    if (timer_period < 200)
-        timer_period = 200;
-
-    timer_on_auto(&card->timer, timer_period);
-
     bool activity = rx_bytes || tx_bytes;
     bool led_on   = card->led_timer & 0x80000000;
     if ((activity && !led_on) || (card->led_timer & 0x7fffffff) >= 150000) {
@@ -428,9 +503,69 @@ network_rx_queue(void *priv)
         card->led_timer = 0 | (activity << 31);
     }
 
+    double timer_period;
+    card->led_wait = 0;
+    if (activity || network_pending(card))
+        timer_period = card->byte_period * (rx_bytes > tx_bytes ? rx_bytes : tx_bytes);
+    else if (card->led_timer & 0x80000000) {
+        /* Nothing to do, come back only to turn the LED off. */
+        timer_period   = 150000 - (card->led_timer & 0x7fffffff);
+        card->led_wait = 1;
+    } else {
+        /* Idle, network_tx() or network_poll() will wake us up. Stopping
+           the timer makes the next wakeup count from the current time
+           rather than from this expiry. */
+        card->led_timer = 0;
+        timer_stop(&card->timer);
+        return;
+    }
+
+    if (timer_period < 200)
+        timer_period = 200;
+
+    timer_on_auto(&card->timer, timer_period);
+
     card->led_timer += timer_period;
 }
 
+static void
+network_wake(netcard_t *card)
+{
+    uint32_t remaining;
+
+    if (!timer_is_enabled(&card->timer)) {
+        timer_on_auto(&card->timer, 200);
+        return;
+    }
+
+    /* A timer waiting to turn the LED off can be up to 150 ms away, bring
+       it forward so that the new packet is handled right away. The time
+       taken off is taken off the LED time as well. */
+    if (card->led_wait) {
+        remaining = timer_get_remaining_us(&card->timer);
+        if (remaining > 200) {
+            timer_set_delay_u64(&card->timer, 200 * TIMER_USEC);
+            card->led_timer -= MIN(remaining - 200, card->led_timer & 0x7fffffff);
+        }
+        card->led_wait = 0;
+    }
+}
+
+/*
+ * Wake up the idle cards that have packets pending.
+ *
+ * Called once per frame from the emulation thread, as the host
+ * backend threads may not touch the timers themselves.
+ */
+void
+network_poll(void)
+{
+    for (int i = 0; i < NET_CARD_MAX; i++) {
+        if (network_cards[i] && network_pending(network_cards[i]))
+            network_wake(network_cards[i]);
+    }
+}
+
 /*
  * Attach a network card to the system.
  *
@@ -447,7 +582,6 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
     card->card_drv        = card_drv;
     card->rx              = rx;
     card->set_link_state  = set_link_state;
-    card->tx_mutex        = thread_create_mutex();
     card->rx_mutex        = thread_create_mutex();
     card->card_num        = net_card_current;
     card->byte_period     = NET_PERIOD_10M;
@@ -456,7 +590,7 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
     wchar_t tempmsg[NET_DRV_ERRBUF_SIZE * 2];
 
     for (int i = 0; i < NET_QUEUE_COUNT; i++) {
-        network_queue_init(&card->queues[i]);
+        card->queues[i] = network_queue_init(network_queue_len(net_cards_conf[net_card_current].queue_len));
     }
 
     if ((!strcmp(network_card_get_internal_name(net_cards_conf[net_card_current].device_num), "modem") ||
@@ -508,10 +642,9 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
         // If null fails, something is very wrong
         // Clean up and fatal
         if(!card->host_drv.priv) {
-            thread_close_mutex(card->tx_mutex);
             thread_close_mutex(card->rx_mutex);
             for (int i = 0; i < NET_QUEUE_COUNT; i++) {
-                network_queue_clear(&card->queues[i]);
+                network_queue_clear(card->queues[i]);
             }
 
             free(card->queued_pkt.data);
@@ -526,19 +659,22 @@ network_attach(void *card_drv, uint8_t *mac, NETRXCB rx, NETSETLINKSTATE set_lin
     timer_add(&card->timer, network_rx_queue, card, 0);
     timer_on_auto(&card->timer, 100);
 
+    network_cards[card->card_num] = card;
+
     return card;
 }
 
 void
 netcard_close(netcard_t *card)
 {
+    network_cards[card->card_num] = NULL;
+
     timer_stop(&card->timer);
     card->host_drv.close(card->host_drv.priv);
 
-    thread_close_mutex(card->tx_mutex);
     thread_close_mutex(card->rx_mutex);
     for (int i = 0; i < NET_QUEUE_COUNT; i++) {
-        network_queue_clear(&card->queues[i]);
+        network_queue_clear(card->queues[i]);
     }
 
     free(card->queued_pkt.data);
@@ -589,19 +725,14 @@ network_reset(void)
 void
 network_tx(netcard_t *card, uint8_t *bufp, int len)
 {
-    network_queue_put(&card->queues[NET_QUEUE_TX_VM], bufp, len);
+    if (network_queue_put(card->queues[NET_QUEUE_TX_VM], bufp, len))
+        network_wake(card);
 }
 
 int
 network_tx_pop(netcard_t *card, netpkt_t *out_pkt)
 {
-    int ret = 0;
-
-    thread_wait_mutex(card->tx_mutex);
-    ret = network_queue_get_swap(&card->queues[NET_QUEUE_TX_HOST], out_pkt);
-    thread_release_mutex(card->tx_mutex);
-
-    return ret;
+    return network_queue_get_swap(card->queues[NET_QUEUE_TX_HOST], out_pkt);
 }
 
 int
@@ -609,8 +740,7 @@ network_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
 {
     int pkt_count = 0;
 
-    netqueue_t *queue = &card->queues[NET_QUEUE_TX_HOST];
-    thread_wait_mutex(card->tx_mutex);
+    netqueue_t *queue = card->queues[NET_QUEUE_TX_HOST];
     for (int i = 0; i < vec_size; i++) {
         if (!network_queue_get_swap(queue, pkt_vec))
             break;
@@ -618,7 +748,6 @@ network_tx_popv(netcard_t *card, netpkt_t *pkt_vec, int vec_size)
         pkt_count++;
         pkt_vec++;
     }
-    thread_release_mutex(card->tx_mutex);
 
     return pkt_count;
 }
@@ -629,7 +758,7 @@ network_rx_put(netcard_t *card, uint8_t *bufp, int len)
     int ret = 0;
 
     thread_wait_mutex(card->rx_mutex);
-    ret = network_queue_put(&card->queues[NET_QUEUE_RX], bufp, len);
+    ret = network_queue_put(card->queues[NET_QUEUE_RX], bufp, len);
     thread_release_mutex(card->rx_mutex);
 
     return ret;
@@ -641,7 +770,7 @@ network_rx_put_pkt(netcard_t *card, netpkt_t *pkt)
     int ret = 0;
 
     thread_wait_mutex(card->rx_mutex);
-    ret = network_queue_put_swap(&card->queues[NET_QUEUE_RX], pkt);
+    ret = network_queue_put_swap(card->queues[NET_QUEUE_RX], pkt);
     thread_release_mutex(card->rx_mutex);
 
     return ret;
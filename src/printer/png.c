@@ -187,9 +187,10 @@ error:
     return 1;
 }
 
-/* Write the given BITMAP-format image as an 8-bit RGBA PNG image file. */
+/* Write the given BITMAP-format image as an 8-bit RGBA PNG image file,
+   with the given zlib compression level (0 = uncompressed, 9 = best). */
 void
-png_write_rgb(char *fn, uint8_t *pix, int16_t w, int16_t h, uint16_t pitch, PALETTE palcol)
+png_write_rgb(char *fn, uint8_t *pix, int16_t w, int16_t h, uint16_t pitch, PALETTE palcol, int level)
 {
     png_structp png  = NULL;
     png_infop   info = NULL;
@@ -228,7 +229,7 @@ error:
     PNGFUNC(init_io)
     (png, fp);
     PNGFUNC(set_compression_level)
-    (png, 9);
+    (png, level);
 
     /* set other zlib parameters */
     PNGFUNC(set_compression_mem_level)
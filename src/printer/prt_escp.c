@@ -65,6 +65,7 @@
 #include <86box/pit.h>
 #include <86box/path.h>
 #include <86box/plat.h>
+#include <86box/thread.h>
 #include <86box/ui.h>
 #include <86box/lpt.h>
 #include <86box/video.h>
@@ -138,6 +139,15 @@ FT_Library ft_lib = NULL;
 #define TYPEFACE_SVBUSABA   30
 #define TYPEFACE_SVJITTRA   31
 
+/* Glyph cache. */
+#define GLYPH_HASH_BITS   10
+#define GLYPH_CACHE_MAX   4096 /* glyphs kept before the cache is flushed */
+#define FONT_VARIANTS_MAX 64
+
+/* Pages waiting for the writer thread; past this, they are written
+   right away. */
+#define PAGES_PENDING_MAX 8
+
 /* Some helper macros. */
 #define PARAM16(x) (dev->esc_parms[x + 1] * 256 + dev->esc_parms[x])
 #define PIXX       ((unsigned) floor(dev->curr_x * dev->dpi + 0.5))
@@ -145,7 +155,7 @@ FT_Library ft_lib = NULL;
 
 typedef struct psurface_t {
     int8_t dirty; /* has the page been printed on? */
-    char   pad;
+    int8_t color; /* has anything but black been printed? */
 
     uint16_t w; /* size and pitch //INFO */
     uint16_t h;
@@ -154,6 +164,39 @@ typedef struct psurface_t {
     uint8_t *pixels; /* grayscale pixel data */
 } psurface_t;
 
+/* A rendered glyph, for one font file, size and transform. */
+typedef struct escp_glyph_t {
+    struct escp_glyph_t *next;
+
+    uint32_t key; /* font variant << 16 | code point */
+    int      left;
+    int      top;
+    FT_Pos   advance_x;
+    unsigned rows;
+    unsigned width;
+    uint8_t  bitmap[]; /* width * rows */
+} escp_glyph_t;
+
+typedef struct escp_font_variant_t {
+    const char *fn;
+    uint16_t    hsize; /* 26.6 points */
+    uint16_t    vsize;
+    uint8_t     italic;
+} escp_font_variant_t;
+
+/* A finished page for the writer thread. */
+typedef struct escp_page_job_t {
+    struct escp_page_job_t *next;
+
+    char     path[1024];
+    uint8_t *pixels;
+    uint16_t w;
+    uint16_t h;
+    uint16_t pitch;
+    int      format;
+    PALETTE  palcol;
+} escp_page_job_t;
+
 typedef struct escp_t {
     const char *name;
 
@@ -162,8 +205,9 @@ typedef struct escp_t {
     pc_timer_t pulse_timer;
     pc_timer_t timeout_timer;
 
-    char    page_fn[260];
-    uint8_t color;
+    char     page_fn[260];
+    uint32_t page_num; /* pages started, to keep the file names unique */
+    uint8_t  color;
 
     /* page data (TODO: make configurable) */
     double   page_width; /* all in inches */
@@ -221,6 +265,8 @@ typedef struct escp_t {
     double      curr_y; /* print head position (y, inch) */
     uint16_t    current_font;
     FT_Face     fontface;
+    const char *font_fn;      /* file fontface was loaded from */
+    int         font_variant; /* index into font_variants */
     int8_t      lq_typeface;
     uint16_t    font_style;
     uint8_t     print_quality;
@@ -251,12 +297,31 @@ typedef struct escp_t {
     uint8_t ctrl;
 
     PALETTE palcol;
+
+    /* rendered glyphs */
+    escp_glyph_t       *glyphs[1 << GLYPH_HASH_BITS];
+    int                 num_glyphs;
+    escp_font_variant_t font_variants[FONT_VARIANTS_MAX];
+    int                 num_font_variants;
+
+    /* page writer thread */
+    thread_t        *writer_thread;
+    event_t         *writer_event;
+    mutex_t         *writer_mutex;
+    escp_page_job_t *jobs_head;
+    escp_page_job_t *jobs_tail;
+    int              jobs_pending;
+    int              writer_quit;
 } escp_t;
 
+int escp_page_format = ESCP_PAGE_PNG;
+
+static const escp_glyph_t no_glyph = { 0 };
+
 static void
 update_font(escp_t *dev);
 static void
-blit_glyph(escp_t *dev, unsigned destx, unsigned desty, int8_t add);
+blit_glyph(escp_t *dev, const escp_glyph_t *glyph, unsigned destx, unsigned desty, int8_t add);
 static void
 draw_hline(escp_t *dev, unsigned from_x, unsigned to_x, unsigned y, int8_t broken);
 static void
@@ -346,20 +411,154 @@ escp_log(const char *fmt, ...)
 #    define escp_log(fmt, ...)
 #endif
 
+/* Write the page as a 1-bit PBM image, any pixel at least half dark is black. */
+static void
+write_pbm(const char *path, const uint8_t *pixels, uint16_t w, uint16_t h, uint16_t pitch)
+{
+    FILE    *fp;
+    uint8_t *row;
+
+    fp = plat_fopen(path, "wb");
+    if (fp == NULL) {
+        escp_log("ESC/P: unable to create page file '%s'\n", path);
+        return;
+    }
+
+    row = (uint8_t *) malloc((w + 7) >> 3);
+
+    fprintf(fp, "P4\n%u %u\n", w, h);
+    for (uint16_t y = 0; y < h; y++) {
+        memset(row, 0x00, (w + 7) >> 3);
+        for (uint16_t x = 0; x < w; x++) {
+            if ((pixels[x + (y * pitch)] & 0x1f) >= 0x10)
+                row[x >> 3] |= 0x80 >> (x & 7);
+        }
+        fwrite(row, 1, (w + 7) >> 3, fp);
+    }
+
+    free(row);
+    fclose(fp);
+}
+
+static void
+write_page(escp_page_job_t *job)
+{
+    switch (job->format) {
+        case ESCP_PAGE_PBM:
+            write_pbm(job->path, job->pixels, job->w, job->h, job->pitch);
+            break;
+
+        case ESCP_PAGE_PNG_FAST:
+            png_write_rgb(job->path, job->pixels, job->w, job->h, job->pitch, job->palcol, 0);
+            break;
+
+        default:
+            png_write_rgb(job->path, job->pixels, job->w, job->h, job->pitch, job->palcol, 9);
+            break;
+    }
+}
+
+/* Encodes the finished pages, so long print jobs do not hold up the
+   emulation while the images are compressed. */
+static void
+writer_thread(void *priv)
+{
+    escp_t          *dev = (escp_t *) priv;
+    escp_page_job_t *job;
+
+    while (1) {
+        thread_wait_event(dev->writer_event, -1);
+        thread_reset_event(dev->writer_event);
+
+        while (1) {
+            thread_wait_mutex(dev->writer_mutex);
+            job = dev->jobs_head;
+            if (job != NULL) {
+                dev->jobs_head = job->next;
+                if (dev->jobs_head == NULL)
+                    dev->jobs_tail = NULL;
+            }
+            thread_release_mutex(dev->writer_mutex);
+
+            if (job == NULL)
+                break;
+
+            write_page(job);
+            free(job->pixels);
+            free(job);
+
+            thread_wait_mutex(dev->writer_mutex);
+            dev->jobs_pending--;
+            thread_release_mutex(dev->writer_mutex);
+        }
+
+        if (dev->writer_quit)
+            break;
+    }
+}
+
 /* Dump the current page into a formatted file. */
 static void
 dump_page(escp_t *dev)
 {
-    char path[1024];
+    escp_page_job_t *job;
+    int              pending;
+    char            *ext;
+
+    job = (escp_page_job_t *) malloc(sizeof(escp_page_job_t));
+    if (job == NULL)
+        return;
+
+    strcpy(job->path, dev->pagepath);
+    strcat(job->path, dev->page_fn);
+    job->pixels = dev->page->pixels;
+    job->w      = dev->page->w;
+    job->h      = dev->page->h;
+    job->pitch  = dev->page->pitch;
+    job->format = escp_page_format;
+    memcpy(job->palcol, dev->palcol, sizeof(PALETTE));
+    job->next = NULL;
+
+    if (job->format == ESCP_PAGE_PBM) {
+        ext = strrchr(job->path, '.');
+        if (dev->page->color || (ext == NULL))
+            job->format = ESCP_PAGE_PNG;
+        else
+            strcpy(ext, ".pbm");
+    }
+
+    thread_wait_mutex(dev->writer_mutex);
+    pending = dev->jobs_pending;
+    thread_release_mutex(dev->writer_mutex);
+
+    /* Hand the page over to the writer, and carry on with a new one. */
+    if (pending < PAGES_PENDING_MAX)
+        dev->page->pixels = (uint8_t *) malloc((size_t) dev->page->pitch * dev->page->h);
 
-    strcpy(path, dev->pagepath);
-    strcat(path, dev->page_fn);
-    png_write_rgb(path, dev->page->pixels, dev->page->w, dev->page->h, dev->page->pitch, dev->palcol);
+    if ((pending >= PAGES_PENDING_MAX) || (dev->page->pixels == NULL)) {
+        dev->page->pixels = job->pixels;
+        write_page(job);
+        free(job);
+        return;
+    }
+
+    thread_wait_mutex(dev->writer_mutex);
+    if (dev->jobs_tail != NULL)
+        dev->jobs_tail->next = job;
+    else
+        dev->jobs_head = job;
+    dev->jobs_tail = job;
+    dev->jobs_pending++;
+    thread_release_mutex(dev->writer_mutex);
+
+    thread_set_event(dev->writer_event);
 }
 
 static void
 new_page(escp_t *dev, int8_t save, int8_t resetx)
 {
+    char suffix[16];
+
     /* Dump the current page if needed. */
     if (save && dev->page)
         dump_page(dev);
@@ -370,11 +569,15 @@ new_page(escp_t *dev, int8_t save, int8_t resetx)
     dev->curr_y = dev->top_margin;
     if (dev->page) {
         dev->page->dirty = 0;
+        dev->page->color = 0;
         memset(dev->page->pixels, 0x00, (size_t) dev->page->pitch * dev->page->h);
     }
 
-    /* Make the page's file name. */
-    plat_tempfile(dev->page_fn, NULL, ".png");
+    /* Make the page's file name. The time stamp alone is not unique, as the
+       pages are written in the background and can come out within the same
+       millisecond, so add the page number. */
+    sprintf(suffix, "-%04u.png", dev->page_num++);
+    plat_tempfile(dev->page_fn, NULL, suffix);
 }
 
 static void
@@ -467,8 +670,10 @@ reset_printer(escp_t *dev)
     dev->num_horizontal_tabs = 32;
     dev->num_vertical_tabs   = -1;
 
-    if (dev->page != NULL)
+    if (dev->page != NULL) {
         dev->page->dirty = 0;
+        dev->page->color = 0;
+    }
 
     escp_log("ESC/P: width=%.1fin,height=%.1fin dpi=%i cpi=%i lpi=%i\n",
              dev->page_width, dev->page_height, (int) dev->dpi,
@@ -492,6 +697,94 @@ init_codepage(escp_t *dev, uint16_t num)
     select_codepage(num, dev->curr_cpmap);
 }
 
+static void
+flush_glyphs(escp_t *dev)
+{
+    escp_glyph_t *glyph;
+
+    for (int i = 0; i < (1 << GLYPH_HASH_BITS); i++) {
+        while (dev->glyphs[i] != NULL) {
+            glyph          = dev->glyphs[i];
+            dev->glyphs[i] = glyph->next;
+            free(glyph);
+        }
+    }
+    dev->num_glyphs = 0;
+}
+
+/* Returns the cache index of a font file, size and transform. */
+static int
+find_font_variant(escp_t *dev, const char *fn, uint16_t hsize, uint16_t vsize, uint8_t italic)
+{
+    escp_font_variant_t *variant;
+
+    for (int i = 0; i < dev->num_font_variants; i++) {
+        variant = &dev->font_variants[i];
+        if (!strcmp(variant->fn, fn) && (variant->hsize == hsize) && (variant->vsize == vsize) && (variant->italic == italic))
+            return i;
+    }
+
+    if (dev->num_font_variants == FONT_VARIANTS_MAX) {
+        flush_glyphs(dev);
+        dev->num_font_variants = 0;
+    }
+
+    variant         = &dev->font_variants[dev->num_font_variants];
+    variant->fn     = fn;
+    variant->hsize  = hsize;
+    variant->vsize  = vsize;
+    variant->italic = italic;
+
+    return dev->num_font_variants++;
+}
+
+/* Returns the glyph for a code point in the current font, rendering it
+   only the first time it is used, or NULL if it cannot be rendered. */
+static const escp_glyph_t *
+get_glyph(escp_t *dev, uint16_t code)
+{
+    uint32_t         key  = ((uint32_t) dev->font_variant << 16) | code;
+    uint32_t         hash = (key * 0x9e3779b1) >> (32 - GLYPH_HASH_BITS);
+    const FT_Bitmap *bitmap;
+    escp_glyph_t    *glyph;
+
+    for (glyph = dev->glyphs[hash]; glyph != NULL; glyph = glyph->next) {
+        if (glyph->key == key)
+            return glyph;
+    }
+
+    /* Leave the glyph out of the cache if it cannot be rendered, the slot
+       would still hold the previous one. */
+    if (FT_Load_Glyph(dev->fontface, FT_Get_Char_Index(dev->fontface, code), FT_LOAD_DEFAULT) ||
+        FT_Render_Glyph(dev->fontface->glyph, FT_RENDER_MODE_NORMAL)) {
+        escp_log("ESC/P: unable to render code point %04X\n", code);
+        return NULL;
+    }
+    bitmap = &dev->fontface->glyph->bitmap;
+
+    if (dev->num_glyphs == GLYPH_CACHE_MAX)
+        flush_glyphs(dev);
+
+    glyph = (escp_glyph_t *) malloc(sizeof(escp_glyph_t) + (size_t) bitmap->rows * bitmap->width);
+    if (glyph == NULL)
+        return NULL;
+
+    glyph->key       = key;
+    glyph->left      = dev->fontface->glyph->bitmap_left;
+    glyph->top       = dev->fontface->glyph->bitmap_top;
+    glyph->advance_x = dev->fontface->glyph->advance.x;
+    glyph->rows      = bitmap->rows;
+    glyph->width     = bitmap->width;
+    for (unsigned int y = 0; y < bitmap->rows; y++)
+        memcpy(&glyph->bitmap[y * bitmap->width], bitmap->buffer + y * bitmap->pitch, bitmap->width);
+
+    glyph->next       = dev->glyphs[hash];
+    dev->glyphs[hash] = glyph;
+    dev->num_glyphs++;
+
+    return glyph;
+}
+
 static void
 update_font(escp_t *dev)
 {
@@ -500,15 +793,12 @@ update_font(escp_t *dev)
     FT_Matrix   matrix;
     double      hpoints = 10.5;
     double      vpoints = 10.5;
+    uint8_t     italic;
 
     /* We need the FreeType library. */
     if (ft_lib == NULL)
         return;
 
-    /* Release current font if we have one. */
-    if (dev->fontface)
-        FT_Done_Face(dev->fontface);
-
     if (dev->print_quality == QUALITY_DRAFT) {
         if (dev->font_style & STYLE_ITALICS)
             fn = FONT_FILE_DOTMATRIX_ITALIC;
@@ -545,11 +835,18 @@ update_font(escp_t *dev)
 
     escp_log("Temp file=%s\n", path);
 
+    /* Keep the current font if it is the same file, only release it if not. */
+    if (dev->fontface && strcmp(dev->font_fn, fn)) {
+        FT_Done_Face(dev->fontface);
+        dev->fontface = NULL;
+    }
+
     /* Load the new font. */
-    if (FT_New_Face(ft_lib, path, 0, &dev->fontface)) {
+    if ((dev->fontface == NULL) && FT_New_Face(ft_lib, path, 0, &dev->fontface)) {
         escp_log("ESC/P: unable to load font '%s'\n", path);
         dev->fontface = NULL;
     }
+    dev->font_fn = fn;
 
     if (!dev->multipoint_mode) {
         dev->actual_cpi = dev->cpi;
@@ -596,14 +893,18 @@ update_font(escp_t *dev)
                      (uint16_t) (hpoints * 64), (uint16_t) (vpoints * 64),
                      dev->dpi, dev->dpi);
 
-    if ((dev->print_quality != QUALITY_DRAFT) && ((dev->font_style & STYLE_ITALICS) || (dev->char_tables[dev->curr_char_table] == 0))) {
+    italic = (dev->print_quality != QUALITY_DRAFT) && ((dev->font_style & STYLE_ITALICS) || (dev->char_tables[dev->curr_char_table] == 0));
+    if (italic) {
         /* Italics transformation. */
         matrix.xx = 0x10000L;
         matrix.xy = (FT_Fixed) (0.20 * 0x10000L);
         matrix.yx = 0;
         matrix.yy = 0x10000L;
         FT_Set_Transform(dev->fontface, &matrix, 0);
-    }
+    } else if (dev->fontface)
+        FT_Set_Transform(dev->fontface, NULL, NULL);
+
+    dev->font_variant = find_font_variant(dev, fn, (uint16_t) (hpoints * 64), (uint16_t) (vpoints * 64), italic);
 }
 
 /* This is the actual ESC/P interpreter. */
@@ -1535,12 +1836,12 @@ process_char(escp_t *dev, uint8_t ch)
 static void
 handle_char(escp_t *dev, uint8_t ch)
 {
-    FT_UInt  char_index;
-    uint16_t pen_x;
-    uint16_t pen_y;
-    uint16_t line_start;
-    uint16_t line_y;
-    double   x_advance;
+    const escp_glyph_t *glyph;
+    uint16_t            pen_x;
+    uint16_t            pen_y;
+    uint16_t            line_start;
+    uint16_t            line_y;
+    double              x_advance;
 
     if (dev->page == NULL)
         return;
@@ -1575,44 +1876,46 @@ handle_char(escp_t *dev, uint8_t ch)
     if (ch == 0x01)
         ch = 0x20;
 
-    /* ok, so we need to print the character now */
-    if (ft_lib) {
-        char_index = FT_Get_Char_Index(dev->fontface, dev->curr_cpmap[ch]);
-        FT_Load_Glyph(dev->fontface, char_index, FT_LOAD_DEFAULT);
-        FT_Render_Glyph(dev->fontface->glyph, FT_RENDER_MODE_NORMAL);
-    }
+    /* ok, so we need to print the character now, leaving a blank if the
+       glyph cannot be rendered */
+    glyph = get_glyph(dev, dev->curr_cpmap[ch]);
+    if (glyph == NULL)
+        glyph = &no_glyph;
 
-    pen_x = PIXX + fmax(0.0, dev->fontface->glyph->bitmap_left);
-    pen_y = (uint16_t) (PIXY + fmax(0.0, -dev->fontface->glyph->bitmap_top + dev->fontface->size->metrics.ascender / 64));
+    pen_x = PIXX + fmax(0.0, glyph->left);
+    pen_y = (uint16_t) (PIXY + fmax(0.0, -glyph->top + dev->fontface->size->metrics.ascender / 64));
 
     if (dev->font_style & STYLE_SUBSCRIPT)
-        pen_y += dev->fontface->glyph->bitmap.rows / 2;
+        pen_y += glyph->rows / 2;
 
     /* mark the page as dirty if anything is drawn */
-    if ((ch != 0x20) || (dev->font_score != SCORE_NONE))
+    if ((ch != 0x20) || (dev->font_score != SCORE_NONE)) {
         dev->page->dirty = 1;
+        if (dev->color != COLOR_BLACK)
+            dev->page->color = 1;
+    }
 
     /* draw the glyph */
-    blit_glyph(dev, pen_x, pen_y, 0);
-    blit_glyph(dev, pen_x + 1, pen_y, 1);
+    blit_glyph(dev, glyph, pen_x, pen_y, 0);
+    blit_glyph(dev, glyph, pen_x + 1, pen_y, 1);
 
     /* doublestrike -> draw glyph a second time, 1px below */
     if (dev->font_style & STYLE_DOUBLESTRIKE) {
-        blit_glyph(dev, pen_x, pen_y + 1, 1);
-        blit_glyph(dev, pen_x + 1, pen_y + 1, 1);
+        blit_glyph(dev, glyph, pen_x, pen_y + 1, 1);
+        blit_glyph(dev, glyph, pen_x + 1, pen_y + 1, 1);
     }
 
     /* bold -> draw glyph a second time, 1px to the right */
     if (dev->font_style & STYLE_BOLD) {
-        blit_glyph(dev, pen_x + 1, pen_y, 1);
-        blit_glyph(dev, pen_x + 2, pen_y, 1);
-        blit_glyph(dev, pen_x + 3, pen_y, 1);
+        blit_glyph(dev, glyph, pen_x + 1, pen_y, 1);
+        blit_glyph(dev, glyph, pen_x + 2, pen_y, 1);
+        blit_glyph(dev, glyph, pen_x + 3, pen_y, 1);
     }
 
     line_start = PIXX;
 
     if (dev->font_style & STYLE_PROP)
-        x_advance = dev->fontface->glyph->advance.x / (dev->dpi * 64.0);
+        x_advance = glyph->advance_x / (dev->dpi * 64.0);
     else {
         if (dev->hmi < 0)
             x_advance = 1.0 / dev->actual_cpi;
@@ -1651,19 +1954,14 @@ handle_char(escp_t *dev, uint8_t ch)
 
 /* TODO: This can be optimized quite a bit... I'm just too lazy right now ;-) */
 static void
-blit_glyph(escp_t *dev, unsigned destx, unsigned desty, int8_t add)
+blit_glyph(escp_t *dev, const escp_glyph_t *glyph, unsigned destx, unsigned desty, int8_t add)
 {
-    const FT_Bitmap *bitmap = &dev->fontface->glyph->bitmap;
-    uint8_t          src;
-    uint8_t         *dst;
+    uint8_t  src;
+    uint8_t *dst;
 
-    /* check if freetype is available */
-    if (ft_lib == NULL)
-        return;
-
-    for (unsigned int y = 0; y < bitmap->rows; y++) {
-        for (unsigned int x = 0; x < bitmap->width; x++) {
-            src = *(bitmap->buffer + x + y * bitmap->pitch);
+    for (unsigned int y = 0; y < glyph->rows; y++) {
+        for (unsigned int x = 0; x < glyph->width; x++) {
+            src = glyph->bitmap[x + y * glyph->width];
             /* ignore background, and respect page size */
             if (src > 0 && (destx + x < (unsigned) dev->page->w) && (desty + y < (unsigned) dev->page->h)) {
                 dst = (uint8_t *) dev->page->pixels + (x + destx) + (y + desty) * dev->page->pitch;
@@ -1860,6 +2158,8 @@ print_bit_graph(escp_t *dev, uint8_t ch)
 
     /* Mark page dirty. */
     dev->page->dirty = 1;
+    if (dev->color != COLOR_BLACK)
+        dev->page->color = 1;
 
     /* Restore Y-position. */
     dev->curr_y = old_y;
@@ -2025,6 +2325,10 @@ escp_init(void *lpt)
     dev->fontface = 0;
     dev->autofeed = 0;
 
+    dev->writer_mutex  = thread_create_mutex();
+    dev->writer_event  = thread_create_event();
+    dev->writer_thread = thread_create(writer_thread, dev);
+
     reset_printer(dev);
 
     escp_log("ESC/P: created a virtual page of dimensions %d x %d pixels.\n",
@@ -2054,6 +2358,17 @@ escp_close(void *priv)
         free(dev->page);
     }
 
+    /* Let the writer finish the pages still queued. */
+    dev->writer_quit = 1;
+    thread_set_event(dev->writer_event);
+    thread_wait(dev->writer_thread);
+    thread_destroy_event(dev->writer_event);
+    thread_close_mutex(dev->writer_mutex);
+
+    flush_glyphs(dev);
+    if (dev->fontface)
+        FT_Done_Face(dev->fontface);
+
     free(dev);
 }
 
@@ -55,6 +55,7 @@ extern "C" {
 #include <86box/plat.h>
 #include <86box/ui.h>
 #include <86box/video.h>
+#include <86box/instrument.h>
 #ifdef DISCORD
 #   include <86box/discord.h>
 #endif
@@ -109,6 +110,11 @@ main_thread_fn()
 #endif
             drawits += static_cast<int>(new_time - old_time);
         old_time = new_time;
+#ifdef USE_INSTRUMENT
+        /* Benchmark runs are not paced to real time. */
+        if (instru_enabled && !dopause)
+            drawits = 10;
+#endif
         if (drawits > 0 && !dopause) {
             /* Yes, so do one frame now. */
             drawits -= 10;
@@ -123,10 +129,9 @@ main_thread_fn()
 
 #ifdef USE_INSTRUMENT
             if (instru_enabled) {
-                uint64_t elapsed_us       = (elapsed_timer.nsecsElapsed() - start_time) / 1000;
-                uint64_t total_elapsed_ms = (uint64_t) ((double) tsc / cpu_s->rspeed * 1000);
-                printf("[instrument] %llu, %llu\n", total_elapsed_ms, elapsed_us);
-                if (instru_run_ms && total_elapsed_ms >= instru_run_ms)
+                uint64_t elapsed_us = (elapsed_timer.nsecsElapsed() - start_time) / 1000;
+
+                if (instru_frame(elapsed_us))
                     break;
             }
 #endif
@@ -144,6 +149,10 @@ main_thread_fn()
         }
     }
 
+#ifdef USE_INSTRUMENT
+    if (instru_enabled)
+        instru_report();
+#endif
     is_quit = 1;
     for (uint8_t i = 1; i < GFXCARD_MAX; i ++) {
         if (gfxcard[i]) {
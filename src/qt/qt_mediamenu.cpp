@@ -523,7 +523,13 @@ MediaMenu::cdromMount(int i, int dir, const QString &arg)
     else {
         filename = QFileDialog::getOpenFileName(parentWidget, QString(),
                                                 QString(),
-            tr("CD-ROM images") % util::DlgFilter({ "iso", "cue" }) % tr("All files") % util::DlgFilter({ "*" }, true));
+            tr("CD-ROM images") %
+#ifdef USE_CHD
+            util::DlgFilter({ "iso", "cue", "chd" }) %
+#else
+            util::DlgFilter({ "iso", "cue" }) %
+#endif
+            tr("All files") % util::DlgFilter({ "*" }, true));
     }
 
     if (filename.isEmpty())
@@ -52,6 +52,10 @@
 #ifdef Q_OS_UNIX
 #    include <pthread.h>
 #    include <sys/mman.h>
+#    include <sys/resource.h>
+#    include <sys/stat.h>
+#    include <fcntl.h>
+#    include <unistd.h>
 #endif
 
 #if 0
@@ -96,6 +100,7 @@ extern "C" {
 #        define NOMINMAX
 #    endif
 #    include <windows.h>
+#    include <psapi.h>
 #    include <86box/win.h>
 #else
 #    include <strings.h>
@@ -373,6 +378,75 @@ plat_munmap(void *ptr, size_t size)
 #endif
 }
 
+/* Replaces the pages at ptr with a copy-on-write mapping of the file, so
+   every process mapping the same file shares the pages it does not write.
+   Windows can not map a view over memory that is already allocated, so
+   the callers read the file there instead. */
+int
+plat_mmap_file(void *ptr, size_t size, const char *path, uint64_t offset)
+{
+#if defined Q_OS_WINDOWS
+    return 0;
+#else
+    struct stat st;
+    void       *ret;
+    int         fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+
+    /* Pages past the end of the file would fault on access. */
+    if ((fstat(fd, &st) < 0) || ((uint64_t) st.st_size < (offset + size))) {
+        close(fd);
+        return 0;
+    }
+
+    ret = mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t) offset);
+    close(fd);
+
+    return ret != MAP_FAILED;
+#endif
+}
+
+void
+plat_get_mem_stats(plat_mem_stats_t *stats)
+{
+    memset(stats, 0x00, sizeof(plat_mem_stats_t));
+
+#if defined Q_OS_WINDOWS
+    PROCESS_MEMORY_COUNTERS pmc;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        stats->rss      = pmc.WorkingSetSize;
+        stats->peak_rss = pmc.PeakWorkingSetSize;
+        /* Windows does not tell soft and hard faults apart. */
+        stats->minor_faults = pmc.PageFaultCount;
+    }
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#    ifdef Q_OS_MACOS
+        stats->peak_rss = usage.ru_maxrss;
+#    else
+        stats->peak_rss = (uint64_t) usage.ru_maxrss << 10;
+#    endif
+        stats->minor_faults = usage.ru_minflt;
+        stats->major_faults = usage.ru_majflt;
+    }
+
+    stats->rss = stats->peak_rss;
+
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+
+        if (fields.size() > 1)
+            stats->rss = fields[1].toULongLong() * sysconf(_SC_PAGESIZE);
+    }
+#endif
+}
+
 void
 plat_pause(int p)
 {
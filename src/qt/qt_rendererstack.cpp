@@ -409,9 +409,11 @@ RendererStack::createRenderer(Renderer renderer)
 void
 RendererStack::blit(int x, int y, int w, int h)
 {
+    bitmap_t *buffer = video_get_blit_buffer_monitor(m_monitor_index);
+
     if ((x < 0) || (y < 0) || (w <= 0) || (h <= 0) ||
         (w > 2048) || (h > 2048) ||
-        (monitors[m_monitor_index].target_buffer == NULL) || imagebufs.empty() ||
+        (buffer == NULL) || imagebufs.empty() ||
         std::get<std::atomic_flag *>(imagebufs[currentBuf])->test_and_set()) {
         video_blit_complete_monitor(m_monitor_index);
         return;
@@ -423,7 +425,7 @@ RendererStack::blit(int x, int y, int w, int h)
     uint8_t *imagebits = std::get<uint8_t *>(imagebufs[currentBuf]);
     for (int y1 = y; y1 < (y + h); y1++) {
         auto scanline = imagebits + (y1 * rendererWindow->getBytesPerRow()) + (x * 4);
-        video_copy(scanline, &(monitors[m_monitor_index].target_buffer->line[y1][x]), w * 4);
+        video_copy(scanline, &(buffer->line[y1][x]), w * 4);
     }
 
     if (monitors[m_monitor_index].mon_screenshots) {
@@ -43,6 +43,7 @@ const int DataBus                = Qt::UserRole;
 const int DataBusChannel         = Qt::UserRole + 1;
 const int DataBusPrevious        = Qt::UserRole + 2;
 const int DataBusChannelPrevious = Qt::UserRole + 3;
+const int DataIoEngine           = Qt::UserRole + 4;
 
 #if 0
 static void
@@ -86,6 +87,7 @@ addRow(QAbstractItemModel *model, hard_disk_t *hd)
     model->setData(model->index(row, ColumnBus), hd->bus, DataBusPrevious);
     model->setData(model->index(row, ColumnBus), hd->channel, DataBusChannel);
     model->setData(model->index(row, ColumnBus), hd->channel, DataBusChannelPrevious);
+    model->setData(model->index(row, ColumnBus), hd->io_engine, DataIoEngine);
     Harddrives::busTrackClass->device_track(1, DEV_HDD, hd->bus, hd->channel);
     QString fileName = hd->fn;
     if (fileName.startsWith(userPath, Qt::CaseInsensitive)) {
@@ -159,6 +161,7 @@ SettingsHarddisks::save()
         hdd[i].hpc          = idx.siblingAtColumn(ColumnHeads).data().toUInt();
         hdd[i].spt          = idx.siblingAtColumn(ColumnSectors).data().toUInt();
         hdd[i].speed_preset = idx.siblingAtColumn(ColumnSpeed).data(Qt::UserRole).toUInt();
+        hdd[i].io_engine    = idx.data(DataIoEngine).toUInt();
 
         QByteArray fileName = idx.siblingAtColumn(ColumnFilename).data(Qt::UserRole).toString().toUtf8();
         strncpy(hdd[i].fn, fileName.data(), sizeof(hdd[i].fn) - 1);
@@ -1,5 +1,6 @@
 #include <inttypes.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,6 +17,7 @@
 #include <86box/rom.h>
 #include <86box/sound.h>
 #include <86box/snd_emu8k.h>
+#include <86box/thread.h>
 #include <86box/timer.h>
 #include <86box/plat_unused.h>
 
@@ -307,6 +309,44 @@ uint32_t rep_count_w = 0;
 #    define WRITE16(addr, var, val) WRITE16_SWITCH(addr, var, val)
 #endif // EMU8K_DEBUG_REGISTERS
 
+/* With the worker thread, the register writes are queued with the sample
+   they were made at and the synthesis runs in the worker, which is woken up
+   every EMU8K_WAKE_WRITES writes and at the end of every buffer. The output
+   is handed to the mixer one buffer late, so it lags by one WTBUFLEN
+   (~22 ms at 44.1 kHz); this is why the option is off by default. */
+#define EMU8K_QUEUE_SIZE    8192 /* must be a power of 2 */
+#define EMU8K_WAKE_WRITES   256
+#define EMU8K_END_OF_BUFFER 0    /* queued address marking the end of a buffer */
+
+typedef struct emu8k_write_t {
+    uint16_t pos;
+    uint16_t addr;
+    uint16_t val;
+} emu8k_write_t;
+
+typedef struct emu8k_worker_t {
+    emu8k_t  *emu8k;
+    thread_t *thread;
+    event_t  *wake_event;
+    mutex_t  *mutex;
+    int       quit;
+
+    /* head is only written by the emulation thread, tail by whoever holds
+       the mutex. */
+    atomic_uint   head;
+    atomic_uint   tail;
+    emu8k_write_t queue[EMU8K_QUEUE_SIZE];
+    unsigned int  woken_head;
+
+    /* Buffers queued and finished so far, buffer n is rendered to out[n & 1]. */
+    uint32_t    buffers_queued;
+    atomic_uint buffers_done;
+    int32_t     out[2][WTBUFLEN * 2];
+} emu8k_worker_t;
+
+static void emu8k_worker_push(emu8k_worker_t *worker, int pos, uint16_t addr, uint16_t val);
+static void emu8k_worker_sync(emu8k_worker_t *worker);
+
 #ifdef ENABLE_EMU8K_LOG
 int emu8k_do_log = ENABLE_EMU8K_LOG;
 
@@ -401,6 +441,10 @@ emu8k_inw(uint16_t addr, void *priv)
     emu8k_t *emu8k = (emu8k_t *) priv;
     uint16_t ret   = 0xffff;
 
+    /* Let the pending writes take effect before looking at the registers. */
+    if (emu8k->worker)
+        emu8k_worker_sync(emu8k->worker);
+
 #ifdef EMU8K_DEBUG_REGISTERS
     if (addr == 0xE22) {
         emu8k_log("EMU8K READ POINTER: %d\n",
@@ -788,15 +832,11 @@ emu8k_inw(uint16_t addr, void *priv)
     return 0xffff;
 }
 
-void
-emu8k_outw(uint16_t addr, uint16_t val, void *priv)
+static void
+emu8k_write(uint16_t addr, uint16_t val, void *priv)
 {
     emu8k_t *emu8k = (emu8k_t *) priv;
 
-    /*TODO: I would like to not call this here, but i found it was needed or else cubic player would not finish opening (take a looot more of time than usual).
-     * Basically, being here means that the audio is generated in the emulation thread, instead of the audio thread.*/
-    emu8k_update(emu8k);
-
 #ifdef EMU8K_DEBUG_REGISTERS
     if (addr == 0xE22) {
         // emu8k_log("EMU8K WRITE POINTER: %d\n", val);
@@ -1529,6 +1569,22 @@ emu8k_outw(uint16_t addr, uint16_t val, void *priv)
               emu8k->cur_reg, emu8k->cur_voice, val);
 }
 
+void
+emu8k_outw(uint16_t addr, uint16_t val, void *priv)
+{
+    emu8k_t *emu8k = (emu8k_t *) priv;
+
+    if (emu8k->worker) {
+        emu8k_worker_push(emu8k->worker, wavetable_pos_global, addr, val);
+        return;
+    }
+
+    /* The write has to land at the right sample, so render up to now first.
+       Cubic Player also takes much longer to start without this. */
+    emu8k_update(emu8k);
+    emu8k_write(addr, val, priv);
+}
+
 uint8_t
 emu8k_inb(uint16_t addr, void *priv)
 {
@@ -1755,10 +1811,10 @@ int32_t old_pitch[32] = { 0 };
 int32_t old_cut[32]   = { 0 };
 int32_t old_vol[32]   = { 0 };
 #endif
-void
-emu8k_update(emu8k_t *emu8k)
+static void
+emu8k_render(emu8k_t *emu8k, int end)
 {
-    if (emu8k->pos >= wavetable_pos_global)
+    if (emu8k->pos >= end)
         return;
 
     int32_t       *buf;
@@ -1767,16 +1823,16 @@ emu8k_update(emu8k_t *emu8k)
 
     /* Clean the buffers since we will accumulate into them. */
     buf = &emu8k->buffer[emu8k->pos * 2];
-    memset(buf, 0, 2 * (wavetable_pos_global - emu8k->pos) * sizeof(emu8k->buffer[0]));
-    memset(&emu8k->chorus_in_buffer[emu8k->pos], 0, (wavetable_pos_global - emu8k->pos) * sizeof(emu8k->chorus_in_buffer[0]));
-    memset(&emu8k->reverb_in_buffer[emu8k->pos], 0, (wavetable_pos_global - emu8k->pos) * sizeof(emu8k->reverb_in_buffer[0]));
+    memset(buf, 0, 2 * (end - emu8k->pos) * sizeof(emu8k->buffer[0]));
+    memset(&emu8k->chorus_in_buffer[emu8k->pos], 0, (end - emu8k->pos) * sizeof(emu8k->chorus_in_buffer[0]));
+    memset(&emu8k->reverb_in_buffer[emu8k->pos], 0, (end - emu8k->pos) * sizeof(emu8k->reverb_in_buffer[0]));
 
     /* Voices section  */
     for (uint8_t c = 0; c < 32; c++) {
         emu_voice = &emu8k->voice[c];
         buf       = &emu8k->buffer[emu8k->pos * 2];
 
-        for (pos = emu8k->pos; pos < wavetable_pos_global; pos++) {
+        for (pos = emu8k->pos; pos < end; pos++) {
             int32_t dat;
 
             if (emu_voice->cvcf_curr_volume) {
@@ -2120,14 +2176,164 @@ emu8k_update(emu8k_t *emu8k)
     }
 
     buf = &emu8k->buffer[emu8k->pos * 2];
-    emu8k_work_reverb(&emu8k->reverb_in_buffer[emu8k->pos], buf, &emu8k->reverb_engine, wavetable_pos_global - emu8k->pos);
-    emu8k_work_chorus(&emu8k->chorus_in_buffer[emu8k->pos], buf, &emu8k->chorus_engine, wavetable_pos_global - emu8k->pos);
-    emu8k_work_eq(buf, wavetable_pos_global - emu8k->pos);
+    emu8k_work_reverb(&emu8k->reverb_in_buffer[emu8k->pos], buf, &emu8k->reverb_engine, end - emu8k->pos);
+    emu8k_work_chorus(&emu8k->chorus_in_buffer[emu8k->pos], buf, &emu8k->chorus_engine, end - emu8k->pos);
+    emu8k_work_eq(buf, end - emu8k->pos);
 
     /* Update EMU clock. */
-    emu8k->wc += (wavetable_pos_global - emu8k->pos);
+    emu8k->wc += (end - emu8k->pos);
 
-    emu8k->pos = wavetable_pos_global;
+    emu8k->pos = end;
+}
+
+void
+emu8k_update(emu8k_t *emu8k)
+{
+    emu8k_render(emu8k, wavetable_pos_global);
+}
+
+/* Apply the queued writes, rendering the samples between them. Called
+   with the mutex held, from the worker or from the emulation thread when
+   it cannot wait for the worker. */
+static void
+emu8k_worker_process(emu8k_worker_t *worker)
+{
+    emu8k_t             *emu8k = worker->emu8k;
+    unsigned int         tail  = atomic_load_explicit(&worker->tail, memory_order_relaxed);
+    unsigned int         head  = atomic_load_explicit(&worker->head, memory_order_acquire);
+    const emu8k_write_t *w;
+
+    while (tail != head) {
+        w = &worker->queue[tail & (EMU8K_QUEUE_SIZE - 1)];
+
+        emu8k_render(emu8k, w->pos);
+        if (w->addr == EMU8K_END_OF_BUFFER) {
+            uint32_t done = atomic_load_explicit(&worker->buffers_done, memory_order_relaxed) + 1;
+
+            memcpy(worker->out[done & 1], emu8k->buffer, sizeof(worker->out[0]));
+            emu8k->pos = 0;
+            atomic_store_explicit(&worker->buffers_done, done, memory_order_release);
+        } else
+            emu8k_write(w->addr, w->val, emu8k);
+
+        tail++;
+        atomic_store_explicit(&worker->tail, tail, memory_order_release);
+    }
+}
+
+static void
+emu8k_worker_sync(emu8k_worker_t *worker)
+{
+    if (atomic_load_explicit(&worker->tail, memory_order_acquire) ==
+        atomic_load_explicit(&worker->head, memory_order_relaxed))
+        return;
+
+    thread_wait_mutex(worker->mutex);
+    emu8k_worker_process(worker);
+    thread_release_mutex(worker->mutex);
+}
+
+static void
+emu8k_worker_push(emu8k_worker_t *worker, int pos, uint16_t addr, uint16_t val)
+{
+    unsigned int   head = atomic_load_explicit(&worker->head, memory_order_relaxed);
+    emu8k_write_t *w;
+
+    /* Queue full, do the work here rather than wait for the worker. */
+    if ((head - atomic_load_explicit(&worker->tail, memory_order_acquire)) == EMU8K_QUEUE_SIZE)
+        emu8k_worker_sync(worker);
+
+    w       = &worker->queue[head & (EMU8K_QUEUE_SIZE - 1)];
+    w->pos  = pos;
+    w->addr = addr;
+    w->val  = val;
+    head++;
+    atomic_store_explicit(&worker->head, head, memory_order_release);
+
+    if ((addr == EMU8K_END_OF_BUFFER) || ((head - worker->woken_head) >= EMU8K_WAKE_WRITES)) {
+        worker->woken_head = head;
+        thread_set_event(worker->wake_event);
+    }
+}
+
+static void
+emu8k_worker_thread(void *priv)
+{
+    emu8k_worker_t *worker = (emu8k_worker_t *) priv;
+
+    while (1) {
+        thread_wait_event(worker->wake_event, -1);
+        thread_reset_event(worker->wake_event);
+
+        if (worker->quit)
+            break;
+
+        thread_wait_mutex(worker->mutex);
+        emu8k_worker_process(worker);
+        thread_release_mutex(worker->mutex);
+    }
+}
+
+/* Returns the next buffer of output, called by the mixer when the
+   wavetable buffer is full. */
+const int32_t *
+emu8k_get_buffer(emu8k_t *emu8k)
+{
+    emu8k_worker_t *worker = emu8k->worker;
+    uint32_t        n;
+
+    if (!worker) {
+        emu8k_update(emu8k);
+        emu8k->pos = 0;
+        return emu8k->buffer;
+    }
+
+    emu8k_worker_push(worker, WTBUFLEN, EMU8K_END_OF_BUFFER, 0);
+    n = worker->buffers_queued++;
+
+    /* Hand out the previous buffer, the worker had a whole buffer's time
+       for it so it is normally done already. */
+    if ((int32_t) (atomic_load_explicit(&worker->buffers_done, memory_order_acquire) - (n - 1)) < 0)
+        emu8k_worker_sync(worker);
+
+    return worker->out[(n - 1) & 1];
+}
+
+static void
+emu8k_worker_start(emu8k_t *emu8k)
+{
+    emu8k_worker_t *worker = calloc(1, sizeof(emu8k_worker_t));
+
+    worker->emu8k = emu8k;
+    atomic_init(&worker->head, 0);
+    atomic_init(&worker->tail, 0);
+    atomic_init(&worker->buffers_done, 0);
+    worker->buffers_queued = 1;
+
+    worker->mutex      = thread_create_mutex();
+    worker->wake_event = thread_create_event();
+    worker->thread     = thread_create(emu8k_worker_thread, worker);
+
+    emu8k->worker = worker;
+}
+
+static void
+emu8k_worker_stop(emu8k_t *emu8k)
+{
+    emu8k_worker_t *worker = emu8k->worker;
+
+    if (!worker)
+        return;
+
+    worker->quit = 1;
+    thread_set_event(worker->wake_event);
+    thread_wait(worker->thread);
+
+    thread_destroy_event(worker->wake_event);
+    thread_close_mutex(worker->mutex);
+    free(worker);
+
+    emu8k->worker = NULL;
 }
 
 void
@@ -2149,7 +2355,7 @@ emu8k_change_addr(emu8k_t *emu8k, uint16_t emu_addr)
 
 /* onboard_ram in kilobytes */
 void
-emu8k_init(emu8k_t *emu8k, uint16_t emu_addr, int onboard_ram)
+emu8k_init(emu8k_t *emu8k, uint16_t emu_addr, int onboard_ram, int threaded)
 {
     uint32_t const BLOCK_SIZE_WORDS = 0x10000;
     FILE          *fp;
@@ -2369,11 +2575,16 @@ emu8k_init(emu8k_t *emu8k, uint16_t emu_addr, int onboard_ram)
     emu8k->hwcf2 = 0x20;
     /* Initial state is muted. 0x04 is unmuted. */
     emu8k->hwcf3 = 0x00;
+
+    if (threaded)
+        emu8k_worker_start(emu8k);
 }
 
 void
 emu8k_close(emu8k_t *emu8k)
 {
+    emu8k_worker_stop(emu8k);
+
     free(emu8k->rom);
     free(emu8k->ram);
 }
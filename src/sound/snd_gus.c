@@ -22,6 +22,12 @@
 #include <86box/plat_fallthrough.h>
 #include <86box/plat_unused.h>
 
+/* The voices are rendered in blocks of up to GUS_BLOCK samples, whenever the
+   guest touches the card, the mixer asks for the output, or a wave or volume
+   ramp IRQ is due, and at least every GUS_MAX_AHEAD samples. */
+#define GUS_BLOCK     64
+#define GUS_MAX_AHEAD 1024
+
 enum {
     MIDI_INT_RECEIVE  = 0x01,
     MIDI_INT_TRANSMIT = 0x02,
@@ -94,6 +100,8 @@ typedef struct gus_t {
 
     pc_timer_t samp_timer;
     uint64_t   samp_latch;
+    uint64_t   samp_next;  /* timestamp of the first sample not rendered yet */
+    uint64_t   samp_armed; /* what samp_timer was last armed with */
 
     uint8_t *ram;
     uint32_t gus_end_ram;
@@ -248,8 +256,11 @@ gus_midi_update_int_status(gus_t *gus)
     gus_update_int_status(gus);
 }
 
-void
-writegus(uint16_t addr, uint8_t val, void *priv)
+static void gus_catch_up_now(gus_t *gus);
+static void gus_schedule(gus_t *gus);
+
+static void
+gus_write(uint16_t addr, uint8_t val, void *priv)
 {
     gus_t   *gus = (gus_t *) priv;
     int      c;
@@ -711,8 +722,18 @@ writegus(uint16_t addr, uint8_t val, void *priv)
     }
 }
 
-uint8_t
-readgus(uint16_t addr, void *priv)
+void
+writegus(uint16_t addr, uint8_t val, void *priv)
+{
+    gus_t *gus = (gus_t *) priv;
+
+    gus_catch_up_now(gus);
+    gus_write(addr, val, priv);
+    gus_schedule(gus);
+}
+
+static uint8_t
+gus_read(uint16_t addr, void *priv)
 {
     gus_t   *gus = (gus_t *) priv;
     uint8_t  val = 0xff;
@@ -955,6 +976,22 @@ readgus(uint16_t addr, void *priv)
     return val;
 }
 
+uint8_t
+readgus(uint16_t addr, void *priv)
+{
+    gus_t  *gus = (gus_t *) priv;
+    uint8_t ret;
+
+    gus_catch_up_now(gus);
+    ret = gus_read(addr, priv);
+
+    /* Reading the voice IRQ source acknowledges the voice's IRQs. */
+    if ((addr & 0xf0f) == 0x304 || (addr & 0xf0f) == 0x305)
+        gus_schedule(gus);
+
+    return ret;
+}
+
 void
 gus_poll_timer_1(void *priv)
 {
@@ -1006,9 +1043,9 @@ gus_poll_timer_2(void *priv)
 }
 
 static void
-gus_update(gus_t *gus)
+gus_update(gus_t *gus, int end)
 {
-    for (; gus->pos < sound_pos_global; gus->pos++) {
+    for (; gus->pos < end; gus->pos++) {
         if (gus->out_l < -32768)
             gus->buffer[0][gus->pos] = -32768;
         else if (gus->out_l > 32767)
@@ -1024,24 +1061,17 @@ gus_update(gus_t *gus)
     }
 }
 
-void
-gus_poll_wave(void *priv)
+/* Run one voice for n samples, adding its output to the mix. Returns 1 if
+   it raised a wave or volume ramp IRQ. */
+static int
+gus_render_voice(gus_t *gus, int d, int n, int32_t *mix_l, int32_t *mix_r)
 {
-    gus_t   *gus = (gus_t *) priv;
     uint32_t addr;
     int16_t  v;
     int32_t  vl;
     int      update_irqs = 0;
 
-    gus_update(gus);
-
-    timer_advance_u64(&gus->samp_timer, gus->samp_latch);
-
-    gus->out_l = gus->out_r = 0;
-
-    if ((gus->reset & 3) != 3)
-        return;
-    for (uint8_t d = 0; d < 32; d++) {
+    for (int c = 0; c < n; c++) {
         if (!(gus->ctrl[d] & 3)) {
             if (gus->ctrl[d] & 4) {
                 addr = gus->cur[d] >> 9;
@@ -1088,8 +1118,8 @@ gus_poll_wave(void *priv)
             else
                 v = (int16_t) (float) (v) *24.0 * vol16bit[(gus->rcur[d] >> 10) & 4095];
 
-            gus->out_l += (v * gus->pan_l[d]) / 7;
-            gus->out_r += (v * gus->pan_r[d]) / 7;
+            mix_l[c] += (v * gus->pan_l[d]) / 7;
+            mix_r[c] += (v * gus->pan_r[d]) / 7;
 
             if (gus->ctrl[d] & 0x40) {
                 gus->cur[d] -= (gus->freq[d] >> 1);
@@ -1173,20 +1203,160 @@ gus_poll_wave(void *priv)
         }
     }
 
+    return update_irqs;
+}
+
+/* Render the next n (at most GUS_BLOCK) samples, one voice at a time, then
+   place them in the output buffer where the per-sample timer used to: each
+   sample is held until the first sound_poll() after it. The voices are not
+   run side by side in SIMD lanes, as every one of them branches per sample
+   on its own loop, direction and ramp state and fetches from its own
+   address in the card's RAM. */
+static void
+gus_render(gus_t *gus, int n)
+{
+    int32_t  mix_l[GUS_BLOCK] = { 0 };
+    int32_t  mix_r[GUS_BLOCK] = { 0 };
+    uint64_t poll_next;
+    uint64_t poll_period;
+    uint64_t poll_last;
+    int64_t  diff;
+    int      update_irqs = 0;
+    int      end;
+
+    if ((gus->reset & 3) == 3) {
+        for (int d = 0; d < 32; d++) {
+            if ((gus->ctrl[d] & 3) && (gus->rctrl[d] & 3))
+                continue;
+
+            update_irqs |= gus_render_voice(gus, d, n, mix_l, mix_r);
+        }
+    }
+
+    sound_poll_get_ts(&poll_next, &poll_period);
+    poll_last = poll_next - poll_period;
+
+    for (int c = 0; c < n; c++) {
+        /* Leave out the sound_poll() runs that came after this sample. */
+        end  = sound_pos_global;
+        diff = (int64_t) (poll_last - gus->samp_next);
+        if (diff > 0)
+            end -= (int) ((diff + poll_period - 1) / poll_period);
+
+        gus_update(gus, end);
+
+        gus->out_l = mix_l[c];
+        gus->out_r = mix_r[c];
+        gus->samp_next += gus->samp_latch;
+    }
+
     if (update_irqs)
         gus_update_int_status(gus);
 }
 
+/* Render every sample due before end, a 32:32 timestamp. */
 static void
-gus_get_buffer(int32_t *buffer, int len, void *priv)
+gus_catch_up(gus_t *gus, uint64_t end)
+{
+    uint64_t n;
+
+    /* timer_set_new_tsc() moves the armed timers, follow it. */
+    gus->samp_next += gus->samp_timer.ts.ts64 - gus->samp_armed;
+    gus->samp_armed = gus->samp_timer.ts.ts64;
+
+    while ((int64_t) (gus->samp_next - end) < 0) {
+        n = ((end - gus->samp_next) + gus->samp_latch - 1) / gus->samp_latch;
+        gus_render(gus, (int) MIN(n, GUS_BLOCK));
+    }
+}
+
+/* Bring the voices up to date before the guest looks at or changes them.
+   This stops at a sound_poll() that is due but has not run yet, so that
+   the samples after it still land in the right place of the buffer. */
+static void
+gus_catch_up_now(gus_t *gus)
+{
+    uint64_t poll_next;
+    uint64_t poll_period;
+    uint64_t end = ((uint64_t) (uint32_t) (tsc + 1)) << 32;
+
+    sound_poll_get_ts(&poll_next, &poll_period);
+    if ((int64_t) (poll_next - end) < 0)
+        end = poll_next;
+
+    gus_catch_up(gus, end);
+}
+
+/* Samples until a wave or volume ramp position first crosses its end,
+   at most max. Wrap-around of the position can only make the crossing
+   come later than this, in which case the timer looks again then. */
+static int
+gus_irq_distance(int64_t cur, int64_t start, int64_t end, int64_t step, int back, int max)
+{
+    int64_t n;
+
+    if (back) {
+        if ((cur - step) <= start)
+            return 1;
+        n = step ? ((cur - start + step - 1) / step) : max;
+    } else {
+        if ((cur + step) >= end)
+            return 1;
+        n = step ? ((end - cur + step - 1) / step) : max;
+    }
+
+    return (int) MIN(n, max);
+}
+
+/* Arm the timer for the first sample that can raise a wave or volume ramp
+   IRQ, so those still happen at the right time. Without one due, it only
+   runs every GUS_MAX_AHEAD samples to keep the rendering from falling far
+   behind. */
+static void
+gus_schedule(gus_t *gus)
+{
+    int n = GUS_MAX_AHEAD;
+
+    if ((gus->reset & 3) == 3) {
+        for (int d = 0; d < 32; d++) {
+            if (!(gus->ctrl[d] & 3) && (gus->ctrl[d] & 0x20) && !gus->waveirqs[d])
+                n = gus_irq_distance(gus->cur[d], gus->start[d], gus->end[d], gus->freq[d] >> 1,
+                                     gus->ctrl[d] & 0x40, n);
+            if (!(gus->rctrl[d] & 3) && (gus->rctrl[d] & 0x20) && !gus->rampirqs[d])
+                n = gus_irq_distance(gus->rcur[d], gus->rstart[d], gus->rend[d], gus->rfreq[d],
+                                     gus->rctrl[d] & 0x40, n);
+        }
+    }
+
+    timer_disable(&gus->samp_timer);
+    gus->samp_timer.ts.ts64 = gus->samp_next + ((uint64_t) (n - 1) * gus->samp_latch);
+    gus->samp_armed         = gus->samp_timer.ts.ts64;
+    timer_enable(&gus->samp_timer);
+}
+
+void
+gus_poll_wave(void *priv)
 {
     gus_t *gus = (gus_t *) priv;
 
+    gus_catch_up(gus, gus->samp_timer.ts.ts64 + 1);
+    gus_schedule(gus);
+}
+
+static void
+gus_get_buffer(int32_t *buffer, int len, void *priv)
+{
+    gus_t   *gus = (gus_t *) priv;
+    uint64_t poll_next;
+    uint64_t poll_period;
+
 #if defined(DEV_BRANCH) && defined(USE_GUSMAX)
     if ((gus->type == GUS_MAX) && (gus->max_ctrl))
         ad1848_update(&gus->ad1848);
 #endif
-    gus_update(gus);
+    sound_poll_get_ts(&poll_next, &poll_period);
+    gus_catch_up(gus, poll_next - poll_period);
+    gus_update(gus, sound_pos_global);
 
     for (int c = 0; c < len * 2; c++) {
 #if defined(DEV_BRANCH) && defined(USE_GUSMAX)
@@ -1253,6 +1423,8 @@ gus_reset(void *priv)
     if (gus == NULL)
         return;
 
+    gus_catch_up_now(gus);
+
     memset(gus->ram, 0x00, (gus->gus_end_ram));
 
     for (c = 0; c < 32; c++) {
@@ -1340,6 +1512,8 @@ gus_reset(void *priv)
     gus->midi_irq_state = 0;
 
     gus_update_int_status(gus);
+
+    gus_schedule(gus);
 }
 
 void *
@@ -1394,6 +1568,8 @@ gus_init(UNUSED(const device_t *info))
 #endif
 
     timer_add(&gus->samp_timer, gus_poll_wave, gus, 1);
+    gus->samp_next  = gus->samp_timer.ts.ts64;
+    gus->samp_armed = gus->samp_timer.ts.ts64;
     timer_add(&gus->timer_1, gus_poll_timer_1, gus, 1);
     timer_add(&gus->timer_2, gus_poll_timer_2, gus, 1);
 
@@ -1419,11 +1595,15 @@ gus_speed_changed(void *priv)
 {
     gus_t *gus = (gus_t *) priv;
 
+    gus_catch_up_now(gus);
+
     if (gus->voices < 14)
         gus->samp_latch = (uint64_t) (TIMER_USEC * (1000000.0 / 44100.0));
     else
         gus->samp_latch = (uint64_t) (TIMER_USEC * (1000000.0 / gusfreqs[gus->voices - 14]));
 
+    gus_schedule(gus);
+
 #if defined(DEV_BRANCH) && defined(USE_GUSMAX)
     if ((gus->type == GUS_MAX) && (gus->max_ctrl))
         ad1848_speed_changed(&gus->ad1848);
@@ -495,16 +495,15 @@ sb_get_wavetable_buffer_sb16_awe32(int32_t *buffer, const int len, void *priv)
 {
     sb_t                    *sb      = (sb_t *) priv;
     const sb_ct1745_mixer_t *mixer   = &sb->mixer_sb16;
+    const int32_t           *emu_buf = emu8k_get_buffer(&sb->emu8k);
     double                   bass_treble;
 
-    emu8k_update(&sb->emu8k);
-
     for (int c = 0; c < len * 2; c += 2) {
         double out_l = 0.0;
         double out_r = 0.0;
 
-        out_l += (((double) sb->emu8k.buffer[c]) * mixer->fm_l);
-        out_r += (((double) sb->emu8k.buffer[c + 1]) * mixer->fm_r);
+        out_l += (((double) emu_buf[c]) * mixer->fm_l);
+        out_r += (((double) emu_buf[c + 1]) * mixer->fm_r);
 
         out_l *= mixer->master_l;
         out_r *= mixer->master_r;
@@ -550,8 +549,6 @@ sb_get_wavetable_buffer_sb16_awe32(int32_t *buffer, const int len, void *priv)
         buffer[c] += (int32_t) (out_l * mixer->output_gain_L);
         buffer[c + 1] += (int32_t) (out_r * mixer->output_gain_R);
     }
-
-    sb->emu8k.pos = 0;
 }
 
 void
@@ -3539,7 +3536,7 @@ sb_awe32_init(UNUSED(const device_t *info))
         sb->mpu = NULL;
     sb_dsp_set_mpu(&sb->dsp, sb->mpu);
 
-    emu8k_init(&sb->emu8k, emu_addr, onboard_ram);
+    emu8k_init(&sb->emu8k, emu_addr, onboard_ram, device_get_config_int("emu8k_thread"));
 
     if (device_get_config_int("receive_input"))
         midi_in_handler(1, sb_dsp_input_msg, sb_dsp_input_sysex, &sb->dsp);
@@ -3584,7 +3581,7 @@ sb_awe32_pnp_init(const device_t *info)
     mpu401_init(sb->mpu, 0, 0, M_UART, device_get_config_int("receive_input401"));
     sb_dsp_set_mpu(&sb->dsp, sb->mpu);
 
-    emu8k_init(&sb->emu8k, 0, onboard_ram);
+    emu8k_init(&sb->emu8k, 0, onboard_ram, device_get_config_int("emu8k_thread"));
 
     if (device_get_config_int("receive_input"))
         midi_in_handler(1, sb_dsp_input_msg, sb_dsp_input_sysex, &sb->dsp);
@@ -4683,6 +4680,13 @@ static const device_config_t sb_32_pnp_config[] = {
             { .description = "" }
         }
     },
+    {
+        .name = "emu8k_thread",
+        .description = "Render EMU8000 on a separate thread (adds ~22 ms latency)",
+        .type = CONFIG_BINARY,
+        .default_string = "",
+        .default_int = 0
+    },
     {
         .name = "control_pc_speaker",
         .description = "Control PC speaker",
@@ -4896,6 +4900,13 @@ static const device_config_t sb_awe32_config[] = {
             { "" }
         }
     },
+    {
+        .name = "emu8k_thread",
+        .description = "Render EMU8000 on a separate thread (adds ~22 ms latency)",
+        .type = CONFIG_BINARY,
+        .default_string = "",
+        .default_int = 0
+    },
     {
         .name = "opl",
         .description = "Enable OPL",
@@ -4960,6 +4971,13 @@ static const device_config_t sb_awe32_pnp_config[] = {
             { .description = "" }
         }
     },
+    {
+        .name = "emu8k_thread",
+        .description = "Render EMU8000 on a separate thread (adds ~22 ms latency)",
+        .type = CONFIG_BINARY,
+        .default_string = "",
+        .default_int = 0
+    },
     {
         .name = "control_pc_speaker",
         .description = "Control PC speaker",
@@ -5037,6 +5055,13 @@ static const device_config_t sb_awe64_value_config[] = {
             { .description = "" }
         }
     },
+    {
+        .name = "emu8k_thread",
+        .description = "Render EMU8000 on a separate thread (adds ~22 ms latency)",
+        .type = CONFIG_BINARY,
+        .default_string = "",
+        .default_int = 0
+    },
     {
         .name = "control_pc_speaker",
         .description = "Control PC speaker",
@@ -5110,6 +5135,13 @@ static const device_config_t sb_awe64_config[] = {
             { .description = "" }
         }
     },
+    {
+        .name = "emu8k_thread",
+        .description = "Render EMU8000 on a separate thread (adds ~22 ms latency)",
+        .type = CONFIG_BINARY,
+        .default_string = "",
+        .default_int = 0
+    },
     {
         .name = "control_pc_speaker",
         .description = "Control PC speaker",
@@ -5175,6 +5207,13 @@ static const device_config_t sb_awe64_gold_config[] = {
             { .description = "" }
         }
     },
+    {
+        .name = "emu8k_thread",
+        .description = "Render EMU8000 on a separate thread (adds ~22 ms latency)",
+        .type = CONFIG_BINARY,
+        .default_string = "",
+        .default_int = 0
+    },
     {
         .name = "control_pc_speaker",
         .description = "Control PC speaker",
@@ -82,6 +82,7 @@ static pc_timer_t wavetable_poll_timer;
 static uint64_t   wavetable_poll_latch;
 
 static int16_t      cd_buffer[CDROM_NUM][CD_BUFLEN * 2];
+static float        cd_mix_buffer[CD_BUFLEN * 2];
 static float        cd_out_buffer[CD_BUFLEN * 2];
 static int16_t      cd_out_buffer_int16[CD_BUFLEN * 2];
 static unsigned int cd_vol_l;
@@ -236,16 +237,12 @@ sound_set_cd_volume(unsigned int vol_l, unsigned int vol_r)
 static void
 sound_cd_clean_buffers(void)
 {
-    if (sound_is_float)
-        memset(cd_out_buffer, 0, (CD_BUFLEN * 2) * sizeof(float));
-    else
-        memset(cd_out_buffer_int16, 0, (CD_BUFLEN * 2) * sizeof(int16_t));
+    memset(cd_mix_buffer, 0, (CD_BUFLEN * 2) * sizeof(float));
 }
 
 static void
 sound_cd_thread(UNUSED(void *param))
 {
-    int      temp_buffer[2];
     int      channel_select[2];
     double   audio_vol_l;
     double   audio_vol_r;
@@ -262,8 +259,6 @@ sound_cd_thread(UNUSED(void *param))
 
         sound_cd_clean_buffers();
 
-        temp_buffer[0] = temp_buffer[1] = 0;
-
         for (uint8_t i = 0; i < CDROM_NUM; i++) {
             if ((cdrom[i].bus_type == CDROM_BUS_DISABLED) || (cdrom[i].cd_status == CD_STATUS_EMPTY))
                 continue;
@@ -324,32 +319,18 @@ sound_cd_thread(UNUSED(void *param))
                     filter_cd_audio(1, &(cd_buffer_temp[1]), filter_cd_audio_p);
                 }
 
-                if (sound_is_float) {
-                    cd_out_buffer[c] += (float) (cd_buffer_temp[0] / 32768.0);
-                    cd_out_buffer[c + 1] += (float) (cd_buffer_temp[1] / 32768.0);
-                } else {
-                    temp_buffer[0] += (int) trunc(cd_buffer_temp[0]);
-                    temp_buffer[1] += (int) trunc(cd_buffer_temp[1]);
-
-                    if (temp_buffer[0] > 32767)
-                        temp_buffer[0] = 32767;
-                    if (temp_buffer[0] < -32768)
-                        temp_buffer[0] = -32768;
-                    if (temp_buffer[1] > 32767)
-                        temp_buffer[1] = 32767;
-                    if (temp_buffer[1] < -32768)
-                        temp_buffer[1] = -32768;
-
-                    cd_out_buffer_int16[c]     = (int16_t) temp_buffer[0];
-                    cd_out_buffer_int16[c + 1] = (int16_t) temp_buffer[1];
-                }
+                cd_mix_buffer[c] += (float) cd_buffer_temp[0];
+                cd_mix_buffer[c + 1] += (float) cd_buffer_temp[1];
             }
         }
 
-        if (sound_is_float)
+        if (sound_is_float) {
+            sound_mix_float_to_float(cd_out_buffer, cd_mix_buffer, CD_BUFLEN * 2);
             givealbuffer_cd(cd_out_buffer);
-        else
+        } else {
+            sound_mix_float_to_int16(cd_out_buffer_int16, cd_mix_buffer, CD_BUFLEN * 2);
             givealbuffer_cd(cd_out_buffer_int16);
+        }
     }
 }
 
@@ -539,23 +520,13 @@ sound_poll(UNUSED(void *priv))
         for (c = 0; c < sound_handlers_num; c++)
             sound_handlers[c].get_buffer(outbuffer, SOUNDBUFLEN, sound_handlers[c].priv);
 
-        for (c = 0; c < SOUNDBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_ex[c] = ((float) outbuffer[c]) / (float) 32768.0;
-            else {
-                if (outbuffer[c] > 32767)
-                    outbuffer[c] = 32767;
-                if (outbuffer[c] < -32768)
-                    outbuffer[c] = -32768;
-
-                outbuffer_ex_int16[c] = (int16_t) outbuffer[c];
-            }
-        }
-
-        if (sound_is_float)
+        if (sound_is_float) {
+            sound_mix_int32_to_float(outbuffer_ex, outbuffer, SOUNDBUFLEN * 2);
             givealbuffer(outbuffer_ex);
-        else
+        } else {
+            sound_mix_int32_to_int16(outbuffer_ex_int16, outbuffer, SOUNDBUFLEN * 2);
             givealbuffer(outbuffer_ex_int16);
+        }
 
         if (cd_thread_enable) {
             cd_buf_update--;
@@ -569,6 +540,15 @@ sound_poll(UNUSED(void *priv))
     }
 }
 
+/* Timestamp of the next sound_poll() and the period between them, for the
+   devices that render their output behind the emulated time. */
+void
+sound_poll_get_ts(uint64_t *next, uint64_t *period)
+{
+    *next   = sound_poll_timer.ts.ts64;
+    *period = sound_poll_latch;
+}
+
 void
 music_poll(UNUSED(void *priv))
 {
@@ -583,23 +563,13 @@ music_poll(UNUSED(void *priv))
         for (c = 0; c < music_handlers_num; c++)
             music_handlers[c].get_buffer(outbuffer_m, MUSICBUFLEN, music_handlers[c].priv);
 
-        for (c = 0; c < MUSICBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_m_ex[c] = ((float) outbuffer_m[c]) / (float) 32768.0;
-            else {
-                if (outbuffer_m[c] > 32767)
-                    outbuffer_m[c] = 32767;
-                if (outbuffer_m[c] < -32768)
-                    outbuffer_m[c] = -32768;
-
-                outbuffer_m_ex_int16[c] = (int16_t) outbuffer_m[c];
-            }
-        }
-
-        if (sound_is_float)
+        if (sound_is_float) {
+            sound_mix_int32_to_float(outbuffer_m_ex, outbuffer_m, MUSICBUFLEN * 2);
             givealbuffer_music(outbuffer_m_ex);
-        else
+        } else {
+            sound_mix_int32_to_int16(outbuffer_m_ex_int16, outbuffer_m, MUSICBUFLEN * 2);
             givealbuffer_music(outbuffer_m_ex_int16);
+        }
 
         music_pos_global = 0;
     }
@@ -619,23 +589,13 @@ wavetable_poll(UNUSED(void *priv))
         for (c = 0; c < wavetable_handlers_num; c++)
             wavetable_handlers[c].get_buffer(outbuffer_w, WTBUFLEN, wavetable_handlers[c].priv);
 
-        for (c = 0; c < WTBUFLEN * 2; c++) {
-            if (sound_is_float)
-                outbuffer_w_ex[c] = ((float) outbuffer_w[c]) / (float) 32768.0;
-            else {
-                if (outbuffer_w[c] > 32767)
-                    outbuffer_w[c] = 32767;
-                if (outbuffer_w[c] < -32768)
-                    outbuffer_w[c] = -32768;
-
-                outbuffer_w_ex_int16[c] = (int16_t) outbuffer_w[c];
-            }
-        }
-
-        if (sound_is_float)
+        if (sound_is_float) {
+            sound_mix_int32_to_float(outbuffer_w_ex, outbuffer_w, WTBUFLEN * 2);
             givealbuffer_wt(outbuffer_w_ex);
-        else
+        } else {
+            sound_mix_int32_to_int16(outbuffer_w_ex_int16, outbuffer_w, WTBUFLEN * 2);
             givealbuffer_wt(outbuffer_w_ex_int16);
+        }
 
         wavetable_pos_global = 0;
     }
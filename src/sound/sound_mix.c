@@ -0,0 +1,152 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Sample format conversion for the sound core.
+ *
+ *          The poll routines mix every source into a 32-bit buffer and
+ *          then hand the result to the audio backend as either float or
+ *          saturated 16-bit samples. These helpers do that conversion a
+ *          vector at a time instead of branching on the output format
+ *          once per sample. The results are identical to the scalar
+ *          loops they replace.
+ *
+ *
+ *
+ * Authors: Sarah Walker, <https://pcem-emulator.co.uk/>
+ *          Miran Grca, <mgrca8@gmail.com>
+ *
+ *          Copyright 2008-2020 Sarah Walker.
+ *          Copyright 2016-2025 Miran Grca.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <86box/86box.h>
+#include <86box/sound.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define USE_SSE2
+#    include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#    define USE_NEON
+#    include <arm_neon.h>
+#endif
+
+#define SAMPLE_SCALE (1.0f / 32768.0f)
+
+/* Saturate 32-bit mixed samples to 16 bits. */
+void
+sound_mix_int32_to_int16(int16_t *dst, const int32_t *src, int len)
+{
+    int c = 0;
+
+#if defined(USE_SSE2)
+    for (; c <= (len - 8); c += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *) &src[c]);
+        __m128i hi = _mm_loadu_si128((const __m128i *) &src[c + 4]);
+
+        _mm_storeu_si128((__m128i *) &dst[c], _mm_packs_epi32(lo, hi));
+    }
+#elif defined(USE_NEON)
+    for (; c <= (len - 8); c += 8) {
+        int16x4_t lo = vqmovn_s32(vld1q_s32(&src[c]));
+        int16x4_t hi = vqmovn_s32(vld1q_s32(&src[c + 4]));
+
+        vst1q_s16(&dst[c], vcombine_s16(lo, hi));
+    }
+#endif
+
+    for (; c < len; c++) {
+        int32_t s = src[c];
+
+        if (s > 32767)
+            s = 32767;
+        if (s < -32768)
+            s = -32768;
+        dst[c] = (int16_t) s;
+    }
+}
+
+/* Convert 32-bit mixed samples to float, full scale being 32768. */
+void
+sound_mix_int32_to_float(float *dst, const int32_t *src, int len)
+{
+    int c = 0;
+
+#if defined(USE_SSE2)
+    const __m128 scale = _mm_set1_ps(SAMPLE_SCALE);
+
+    for (; c <= (len - 4); c += 4) {
+        __m128 f = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) &src[c]));
+
+        _mm_storeu_ps(&dst[c], _mm_mul_ps(f, scale));
+    }
+#elif defined(USE_NEON)
+    for (; c <= (len - 4); c += 4)
+        vst1q_f32(&dst[c], vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(&src[c])), SAMPLE_SCALE));
+#endif
+
+    for (; c < len; c++)
+        dst[c] = ((float) src[c]) * SAMPLE_SCALE;
+}
+
+/* Truncate and saturate float samples (in 16-bit units) to 16 bits. */
+void
+sound_mix_float_to_int16(int16_t *dst, const float *src, int len)
+{
+    int c = 0;
+
+#if defined(USE_SSE2)
+    /* Clamp first, _mm_cvttps_epi32() turns out of range values into INT_MIN. */
+    const __m128 max = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+
+    for (; c <= (len - 8); c += 8) {
+        __m128 lo = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[c]), min), max);
+        __m128 hi = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[c + 4]), min), max);
+
+        _mm_storeu_si128((__m128i *) &dst[c], _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+    }
+#elif defined(USE_NEON)
+    for (; c <= (len - 8); c += 8) {
+        int16x4_t lo = vqmovn_s32(vcvtq_s32_f32(vld1q_f32(&src[c])));
+        int16x4_t hi = vqmovn_s32(vcvtq_s32_f32(vld1q_f32(&src[c + 4])));
+
+        vst1q_s16(&dst[c], vcombine_s16(lo, hi));
+    }
+#endif
+
+    for (; c < len; c++) {
+        float s = src[c];
+
+        if (s > 32767.0f)
+            s = 32767.0f;
+        if (s < -32768.0f)
+            s = -32768.0f;
+        dst[c] = (int16_t) s;
+    }
+}
+
+/* Scale float samples in 16-bit units to the [-1.0, 1.0] range. */
+void
+sound_mix_float_to_float(float *dst, const float *src, int len)
+{
+    int c = 0;
+
+#if defined(USE_SSE2)
+    const __m128 scale = _mm_set1_ps(SAMPLE_SCALE);
+
+    for (; c <= (len - 4); c += 4)
+        _mm_storeu_ps(&dst[c], _mm_mul_ps(_mm_loadu_ps(&src[c]), scale));
+#elif defined(USE_NEON)
+    for (; c <= (len - 4); c += 4)
+        vst1q_f32(&dst[c], vmulq_n_f32(vld1q_f32(&src[c]), SAMPLE_SCALE));
+#endif
+
+    for (; c < len; c++)
+        dst[c] = src[c] * SAMPLE_SCALE;
+}
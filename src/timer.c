@@ -4,6 +4,7 @@
 #include <wchar.h>
 #include <86box/86box.h>
 #include <86box/timer.h>
+#include <86box/instrument.h>
 
 uint64_t TIMER_USEC;
 uint32_t timer_target;
@@ -110,10 +111,7 @@ timer_process(void)
 {
     pc_timer_t *timer;
 
-    if (!timer_head)
-        return;
-
-    while (1) {
+    while (timer_head) {
         timer = timer_head;
 
         if (!TIMER_LESS_THAN_VAL(timer, (uint32_t) tsc))
@@ -134,12 +132,15 @@ timer_process(void)
                have a NULL callback when no operation
                is needed. */
             timer->in_callback = 1;
+            instru_count(instru_timer_callbacks);
             timer->callback(timer->priv);
             timer->in_callback = 0;
         }
     }
 
-    timer_target = timer_head->ts.ts32.integer;
+    /* A callback may have disabled the last enabled timer. */
+    if (timer_head)
+        timer_target = timer_head->ts.ts32.integer;
 }
 
 void
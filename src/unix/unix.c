@@ -13,6 +13,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 #include <inttypes.h>
@@ -44,6 +46,7 @@
 #include <86box/video.h>
 #include <86box/ui.h>
 #include <86box/gdbstub.h>
+#include <86box/instrument.h>
 
 #define __USE_GNU 1 /* shouldn't be done, yet it is */
 #include <pthread.h>
@@ -421,6 +424,57 @@ plat_munmap(void *ptr, size_t size)
     munmap(ptr, size);
 }
 
+/* Replaces the pages at ptr with a copy-on-write mapping of the file, so
+   every process mapping the same file shares the pages it does not write. */
+int
+plat_mmap_file(void *ptr, size_t size, const char *path, uint64_t offset)
+{
+    struct stat st;
+    void       *ret;
+    int         fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+
+    /* Pages past the end of the file would fault on access. */
+    if ((fstat(fd, &st) < 0) || ((uint64_t) st.st_size < (offset + size))) {
+        close(fd);
+        return 0;
+    }
+
+    ret = mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t) offset);
+    close(fd);
+
+    return ret != MAP_FAILED;
+}
+
+void
+plat_get_mem_stats(plat_mem_stats_t *stats)
+{
+    struct rusage usage;
+    FILE         *fp;
+    unsigned long pages;
+
+    memset(stats, 0x00, sizeof(plat_mem_stats_t));
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        stats->peak_rss = usage.ru_maxrss;
+#else
+        stats->peak_rss = (uint64_t) usage.ru_maxrss << 10;
+#endif
+        stats->minor_faults = usage.ru_minflt;
+        stats->major_faults = usage.ru_majflt;
+    }
+
+    stats->rss = stats->peak_rss;
+    if ((fp = fopen("/proc/self/statm", "r")) != NULL) {
+        if (fscanf(fp, "%*u %lu", &pages) == 1)
+            stats->rss = (uint64_t) pages * sysconf(_SC_PAGESIZE);
+        fclose(fp);
+    }
+}
+
 uint64_t
 plat_timer_read(void)
 {
@@ -553,15 +607,34 @@ main_thread(void *param)
 #endif
             drawits += (new_time - old_time);
         old_time = new_time;
+#ifdef USE_INSTRUMENT
+        /* Benchmark runs are not paced to real time. */
+        if (instru_enabled && !dopause)
+            drawits = 10;
+#endif
         if (drawits > 0 && !dopause) {
             /* Yes, so do one frame now. */
             drawits -= 10;
             if (drawits > 50)
                 drawits = 0;
 
+#ifdef USE_INSTRUMENT
+            uint64_t start_time = SDL_GetPerformanceCounter();
+#endif
             /* Run a block of code. */
             pc_run();
 
+#ifdef USE_INSTRUMENT
+            if (instru_enabled) {
+                uint64_t elapsed_us = ((SDL_GetPerformanceCounter() - start_time) * 1000000) / SDL_GetPerformanceFrequency();
+
+                if (instru_frame(elapsed_us)) {
+                    instru_report();
+                    exit_event = 1;
+                    return;
+                }
+            }
+#endif
             /* Every 200 frames we save the machine status. */
             if (++frames >= 200 && nvr_dosave) {
                 nvr_save();
@@ -581,6 +654,10 @@ main_thread(void *param)
         }
     }
 
+#ifdef USE_INSTRUMENT
+    if (instru_enabled)
+        instru_report();
+#endif
     is_quit = 1;
 }
 
@@ -1184,6 +1261,11 @@ main(int argc, char **argv)
     ret = pc_init(argc, argv);
     if (ret == 0)
         return 0;
+#ifdef USE_INSTRUMENT
+    /* Benchmark runs need no display, use the dummy driver unless told otherwise. */
+    if (instru_enabled)
+        setenv("SDL_VIDEODRIVER", "dummy", 0);
+#endif
     if (!pc_init_modules()) {
         ui_msgbox_header(MBX_FATAL, L"No ROMs found.", L"86Box could not find any usable ROM images.\n\nPlease download a ROM set and extract it into the \"roms\" directory.");
         SDL_Quit();
@@ -1220,6 +1220,8 @@ svga_poll(void *priv)
             wx = x;
 
             if (!svga->override) {
+                /* No line was rendered, so target_buffer still holds the last frame. */
+                svga->monitor->mon_frame_unchanged = (svga->firstline_draw == 2000);
                 if (svga->vertical_linedbl) {
                     wy = (svga->lastline - svga->firstline) << 1;
                     svga_doblit(wx, wy, svga);
@@ -1227,6 +1229,7 @@ svga_poll(void *priv)
                     wy = svga->lastline - svga->firstline;
                     svga_doblit(wx, wy, svga);
                 }
+                svga->monitor->mon_frame_unchanged = 0;
             }
 
             svga->firstline = 2000;
@@ -1354,6 +1357,8 @@ svga_init(const device_t *info, svga_t *svga, void *priv, int memsize,
     svga->conv_16to32                         = svga_conv_16to32;
     svga->render                              = svga_render_blank;
 
+    svga_render_line_init();
+
     svga->hwcursor.cur_xsize = svga->hwcursor.cur_ysize = 32;
 
     svga->dac_hwcursor.cur_xsize = svga->dac_hwcursor.cur_ysize = 32;
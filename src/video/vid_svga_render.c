@@ -44,6 +44,58 @@ svga_lookup_lut_ram(svga_t* svga, uint32_t val)
 
 #define lookup_lut(val) svga_lookup_lut_ram(svga, val)
 
+/* Convert a whole non-remapped line at once when VRAM is contiguous over it
+   and the card uses the stock conversion, returns the number of pixels
+   drawn or 0 if the caller has to fall back to the per-pixel loop. */
+static int
+svga_render_line_direct(svga_t *svga, uint32_t *p, int bpp, int pixels)
+{
+    uint32_t mask = svga->vram_display_mask;
+    uint32_t addr = svga->ma & mask;
+    uint32_t bytes;
+
+    if ((pixels <= 0) || ((mask + 1) & mask))
+        return 0;
+
+    switch (bpp) {
+        case 15:
+        case 16:
+            if (svga->conv_16to32 != svga_conv_16to32)
+                return 0;
+            bytes = pixels << 1;
+            break;
+        case 24:
+            bytes = pixels * 3;
+            break;
+        default:
+            bytes = pixels << 2;
+            break;
+    }
+
+    if ((bpp >= 24) && svga->lut_map)
+        return 0;
+
+    if ((addr + bytes) > (mask + 1))
+        return 0;
+
+    switch (bpp) {
+        case 15:
+            svga_line_funcs.conv_15to32(p, &svga->vram[addr], pixels);
+            break;
+        case 16:
+            svga_line_funcs.conv_16to32(p, &svga->vram[addr], pixels);
+            break;
+        case 24:
+            svga_line_funcs.conv_24to32(p, &svga->vram[addr], pixels);
+            break;
+        default:
+            svga_line_funcs.conv_32to32(p, &svga->vram[addr], pixels);
+            break;
+    }
+
+    return pixels;
+}
+
 void
 svga_render_null(svga_t *svga)
 {
@@ -1375,22 +1427,25 @@ svga_render_15bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 4) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 8) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 12) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                x = svga_render_line_direct(svga, p, 15, ((svga->hdisp + svga->scrollcache) & ~7) + 8);
+                if (!x) {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 4) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 8) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 12) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                    }
                 }
                 svga->ma += x << 1;
             } else {
@@ -1607,22 +1662,25 @@ svga_render_16bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 4) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 8) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 12) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                x = svga_render_line_direct(svga, p, 16, ((svga->hdisp + svga->scrollcache) & ~7) + 8);
+                if (!x) {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1)) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 4) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 8) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 1) + 12) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                    }
                 }
                 svga->ma += x << 1;
             } else {
@@ -1768,17 +1826,22 @@ svga_render_24bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-                    dat0 = *(uint32_t *) (&svga->vram[svga->ma & svga->vram_display_mask]);
-                    dat1 = *(uint32_t *) (&svga->vram[(svga->ma + 4) & svga->vram_display_mask]);
-                    dat2 = *(uint32_t *) (&svga->vram[(svga->ma + 8) & svga->vram_display_mask]);
+                x = svga_render_line_direct(svga, p, 24, ((svga->hdisp + svga->scrollcache) & ~3) + 4);
+                if (x) {
+                    svga->ma += x * 3;
+                } else {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+                        dat0 = *(uint32_t *) (&svga->vram[svga->ma & svga->vram_display_mask]);
+                        dat1 = *(uint32_t *) (&svga->vram[(svga->ma + 4) & svga->vram_display_mask]);
+                        dat2 = *(uint32_t *) (&svga->vram[(svga->ma + 8) & svga->vram_display_mask]);
 
-                    *p++ = lookup_lut(dat0 & 0xffffff);
-                    *p++ = lookup_lut((dat0 >> 24) | ((dat1 & 0xffff) << 8));
-                    *p++ = lookup_lut((dat1 >> 16) | ((dat2 & 0xff) << 16));
-                    *p++ = lookup_lut(dat2 >> 8);
+                        *p++ = lookup_lut(dat0 & 0xffffff);
+                        *p++ = lookup_lut((dat0 >> 24) | ((dat1 & 0xffff) << 8));
+                        *p++ = lookup_lut((dat1 >> 16) | ((dat2 & 0xff) << 16));
+                        *p++ = lookup_lut(dat2 >> 8);
 
-                    svga->ma += 12;
+                        svga->ma += 12;
+                    }
                 }
             } else {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
@@ -1896,9 +1959,12 @@ svga_render_32bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
-                    dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
-                    *p++ = lookup_lut(dat & 0xffffff);
+                x = svga_render_line_direct(svga, p, 32, svga->hdisp + svga->scrollcache + 1);
+                if (!x) {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x++) {
+                        dat  = *(uint32_t *) (&svga->vram[(svga->ma + (x << 2)) & svga->vram_display_mask]);
+                        *p++ = lookup_lut(dat & 0xffffff);
+                    }
                 }
                 svga->ma += (x * 4);
             } else {
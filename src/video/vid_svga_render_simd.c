@@ -0,0 +1,392 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Vectorized line converters for the direct colour SVGA
+ *          renderers.
+ *
+ *          These handle whole scanlines of contiguous VRAM for the
+ *          common case where the card uses the stock 16-to-32 tables
+ *          and no RAMDAC LUT, turning one indirect call per pixel into
+ *          a handful of vector operations per 8 or 16 pixels.
+ *
+ *          The 5 and 6-bit channel expansions below are bit-exact with
+ *          the tables built by calc_15to32() and calc_16to32():
+ *
+ *              (c * 255) / 31 == (c * 2106) >> 8
+ *              (c * 255) / 63 == ((c << 6) * 4145) >> 16
+ *
+ *          for every possible channel value.
+ *
+ *
+ *
+ * Authors: Sarah Walker, <https://pcem-emulator.co.uk/>
+ *          Miran Grca, <mgrca8@gmail.com>
+ *
+ *          Copyright 2008-2019 Sarah Walker.
+ *          Copyright 2016-2025 Miran Grca.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_svga_render.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    define USE_SSE2
+#    include <emmintrin.h>
+#    if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#        define USE_AVX2
+#        include <immintrin.h>
+#        define AVX2_FUNC __attribute__((target("avx2")))
+#    endif
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#    define USE_NEON
+#    include <arm_neon.h>
+#endif
+
+svga_line_funcs_t svga_line_funcs;
+
+static void
+svga_line_15to32_c(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const uint16_t *s = (const uint16_t *) src;
+
+    for (int x = 0; x < pixels; x++)
+        dst[x] = video_15to32[s[x]];
+}
+
+static void
+svga_line_16to32_c(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const uint16_t *s = (const uint16_t *) src;
+
+    for (int x = 0; x < pixels; x++)
+        dst[x] = video_16to32[s[x]];
+}
+
+static void
+svga_line_24to32_c(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    for (int x = 0; x < pixels; x++) {
+        dst[x] = src[0] | (src[1] << 8) | (src[2] << 16);
+        src += 3;
+    }
+}
+
+static void
+svga_line_32to32_c(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const uint32_t *s = (const uint32_t *) src;
+
+    for (int x = 0; x < pixels; x++)
+        dst[x] = s[x] & 0x00ffffff;
+}
+
+#ifdef USE_SSE2
+static __inline __m128i
+svga_expand_555_sse2(__m128i v, __m128i *hi)
+{
+    const __m128i m5 = _mm_set1_epi16(0x1f);
+    const __m128i k5 = _mm_set1_epi16(2106);
+    __m128i       b  = _mm_and_si128(v, m5);
+    __m128i       g  = _mm_and_si128(_mm_srli_epi16(v, 5), m5);
+    __m128i       r  = _mm_and_si128(_mm_srli_epi16(v, 10), m5);
+
+    b = _mm_srli_epi16(_mm_mullo_epi16(b, k5), 8);
+    g = _mm_srli_epi16(_mm_mullo_epi16(g, k5), 8);
+    r = _mm_srli_epi16(_mm_mullo_epi16(r, k5), 8);
+
+    b   = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    *hi = _mm_unpackhi_epi16(b, r);
+    return _mm_unpacklo_epi16(b, r);
+}
+
+static __inline __m128i
+svga_expand_565_sse2(__m128i v, __m128i *hi)
+{
+    const __m128i m5 = _mm_set1_epi16(0x1f);
+    const __m128i k5 = _mm_set1_epi16(2106);
+    const __m128i k6 = _mm_set1_epi16(4145);
+    __m128i       b  = _mm_and_si128(v, m5);
+    __m128i       g  = _mm_and_si128(_mm_slli_epi16(v, 1), _mm_set1_epi16(0x0fc0));
+    __m128i       r  = _mm_srli_epi16(v, 11);
+
+    b = _mm_srli_epi16(_mm_mullo_epi16(b, k5), 8);
+    g = _mm_mulhi_epu16(g, k6);
+    r = _mm_srli_epi16(_mm_mullo_epi16(r, k5), 8);
+
+    b   = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    *hi = _mm_unpackhi_epi16(b, r);
+    return _mm_unpacklo_epi16(b, r);
+}
+
+static void
+svga_line_15to32_sse2(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    __m128i lo;
+    __m128i hi;
+    int     x;
+
+    for (x = 0; x <= (pixels - 8); x += 8) {
+        lo = svga_expand_555_sse2(_mm_loadu_si128((const __m128i *) &src[x << 1]), &hi);
+        _mm_storeu_si128((__m128i *) &dst[x], lo);
+        _mm_storeu_si128((__m128i *) &dst[x + 4], hi);
+    }
+
+    svga_line_15to32_c(&dst[x], &src[x << 1], pixels - x);
+}
+
+static void
+svga_line_16to32_sse2(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    __m128i lo;
+    __m128i hi;
+    int     x;
+
+    for (x = 0; x <= (pixels - 8); x += 8) {
+        lo = svga_expand_565_sse2(_mm_loadu_si128((const __m128i *) &src[x << 1]), &hi);
+        _mm_storeu_si128((__m128i *) &dst[x], lo);
+        _mm_storeu_si128((__m128i *) &dst[x + 4], hi);
+    }
+
+    svga_line_16to32_c(&dst[x], &src[x << 1], pixels - x);
+}
+
+static void
+svga_line_32to32_sse2(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const __m128i mask = _mm_set1_epi32(0x00ffffff);
+    int           x;
+
+    for (x = 0; x <= (pixels - 8); x += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &src[x << 2]);
+        __m128i b = _mm_loadu_si128((const __m128i *) &src[(x << 2) + 16]);
+
+        _mm_storeu_si128((__m128i *) &dst[x], _mm_and_si128(a, mask));
+        _mm_storeu_si128((__m128i *) &dst[x + 4], _mm_and_si128(b, mask));
+    }
+
+    svga_line_32to32_c(&dst[x], &src[x << 2], pixels - x);
+}
+#endif
+
+#ifdef USE_AVX2
+static __inline AVX2_FUNC void
+svga_store_pairs_avx2(uint32_t *dst, __m256i gb, __m256i r)
+{
+    /* The unpacks work per 128-bit lane, so put the halves back in pixel order. */
+    __m256i lo = _mm256_unpacklo_epi16(gb, r);
+    __m256i hi = _mm256_unpackhi_epi16(gb, r);
+
+    _mm256_storeu_si256((__m256i *) dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i *) &dst[8], _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+static AVX2_FUNC void
+svga_line_15to32_avx2(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const __m256i m5 = _mm256_set1_epi16(0x1f);
+    const __m256i k5 = _mm256_set1_epi16(2106);
+    int           x;
+
+    for (x = 0; x <= (pixels - 16); x += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) &src[x << 1]);
+        __m256i b = _mm256_and_si256(v, m5);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi16(v, 5), m5);
+        __m256i r = _mm256_and_si256(_mm256_srli_epi16(v, 10), m5);
+
+        b = _mm256_srli_epi16(_mm256_mullo_epi16(b, k5), 8);
+        g = _mm256_srli_epi16(_mm256_mullo_epi16(g, k5), 8);
+        r = _mm256_srli_epi16(_mm256_mullo_epi16(r, k5), 8);
+
+        svga_store_pairs_avx2(&dst[x], _mm256_or_si256(b, _mm256_slli_epi16(g, 8)), r);
+    }
+
+    svga_line_15to32_c(&dst[x], &src[x << 1], pixels - x);
+}
+
+static AVX2_FUNC void
+svga_line_16to32_avx2(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const __m256i m5 = _mm256_set1_epi16(0x1f);
+    const __m256i k5 = _mm256_set1_epi16(2106);
+    const __m256i k6 = _mm256_set1_epi16(4145);
+    int           x;
+
+    for (x = 0; x <= (pixels - 16); x += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) &src[x << 1]);
+        __m256i b = _mm256_and_si256(v, m5);
+        __m256i g = _mm256_and_si256(_mm256_slli_epi16(v, 1), _mm256_set1_epi16(0x0fc0));
+        __m256i r = _mm256_srli_epi16(v, 11);
+
+        b = _mm256_srli_epi16(_mm256_mullo_epi16(b, k5), 8);
+        g = _mm256_mulhi_epu16(g, k6);
+        r = _mm256_srli_epi16(_mm256_mullo_epi16(r, k5), 8);
+
+        svga_store_pairs_avx2(&dst[x], _mm256_or_si256(b, _mm256_slli_epi16(g, 8)), r);
+    }
+
+    svga_line_16to32_c(&dst[x], &src[x << 1], pixels - x);
+}
+
+static AVX2_FUNC void
+svga_line_24to32_avx2(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const __m128i shuf = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    int           x;
+
+    /* Each load covers 16 bytes but only consumes 12, so stop early enough
+       to never read past the end of the span. */
+    for (x = 0; ((x * 3) + 28) <= (pixels * 3); x += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) &src[x * 3]);
+        __m128i b = _mm_loadu_si128((const __m128i *) &src[(x * 3) + 12]);
+
+        _mm256_storeu_si256((__m256i *) &dst[x],
+                            _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_shuffle_epi8(a, shuf)),
+                                                    _mm_shuffle_epi8(b, shuf), 1));
+    }
+
+    svga_line_24to32_c(&dst[x], &src[x * 3], pixels - x);
+}
+
+static AVX2_FUNC void
+svga_line_32to32_avx2(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const __m256i mask = _mm256_set1_epi32(0x00ffffff);
+    int           x;
+
+    for (x = 0; x <= (pixels - 8); x += 8)
+        _mm256_storeu_si256((__m256i *) &dst[x],
+                            _mm256_and_si256(_mm256_loadu_si256((const __m256i *) &src[x << 2]), mask));
+
+    svga_line_32to32_c(&dst[x], &src[x << 2], pixels - x);
+}
+#endif
+
+#ifdef USE_NEON
+static __inline uint8x8_t
+svga_expand_6_neon(uint16x8_t g)
+{
+    /* ((c << 6) * 4145) >> 16, done as a widening multiply. */
+    const uint16x4_t k6 = vdup_n_u16(4145);
+    uint16x4_t       lo = vshrn_n_u32(vmull_u16(vget_low_u16(g), k6), 16);
+    uint16x4_t       hi = vshrn_n_u32(vmull_u16(vget_high_u16(g), k6), 16);
+
+    return vmovn_u16(vcombine_u16(lo, hi));
+}
+
+static void
+svga_line_15to32_neon(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const uint16x8_t m5 = vdupq_n_u16(0x1f);
+    const uint16x8_t k5 = vdupq_n_u16(2106);
+    uint8x8x4_t      out;
+    int              x;
+
+    out.val[3] = vdup_n_u8(0);
+    for (x = 0; x <= (pixels - 8); x += 8) {
+        uint16x8_t v = vld1q_u16((const uint16_t *) &src[x << 1]);
+
+        out.val[0] = vshrn_n_u16(vmulq_u16(vandq_u16(v, m5), k5), 8);
+        out.val[1] = vshrn_n_u16(vmulq_u16(vandq_u16(vshrq_n_u16(v, 5), m5), k5), 8);
+        out.val[2] = vshrn_n_u16(vmulq_u16(vandq_u16(vshrq_n_u16(v, 10), m5), k5), 8);
+        vst4_u8((uint8_t *) &dst[x], out);
+    }
+
+    svga_line_15to32_c(&dst[x], &src[x << 1], pixels - x);
+}
+
+static void
+svga_line_16to32_neon(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const uint16x8_t m5 = vdupq_n_u16(0x1f);
+    const uint16x8_t k5 = vdupq_n_u16(2106);
+    uint8x8x4_t      out;
+    int              x;
+
+    out.val[3] = vdup_n_u8(0);
+    for (x = 0; x <= (pixels - 8); x += 8) {
+        uint16x8_t v = vld1q_u16((const uint16_t *) &src[x << 1]);
+
+        out.val[0] = vshrn_n_u16(vmulq_u16(vandq_u16(v, m5), k5), 8);
+        out.val[1] = svga_expand_6_neon(vandq_u16(vshlq_n_u16(v, 1), vdupq_n_u16(0x0fc0)));
+        out.val[2] = vshrn_n_u16(vmulq_u16(vshrq_n_u16(v, 11), k5), 8);
+        vst4_u8((uint8_t *) &dst[x], out);
+    }
+
+    svga_line_16to32_c(&dst[x], &src[x << 1], pixels - x);
+}
+
+static void
+svga_line_24to32_neon(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    uint8x8x3_t in;
+    uint8x8x4_t out;
+    int         x;
+
+    out.val[3] = vdup_n_u8(0);
+    for (x = 0; x <= (pixels - 8); x += 8) {
+        in         = vld3_u8(&src[x * 3]);
+        out.val[0] = in.val[0];
+        out.val[1] = in.val[1];
+        out.val[2] = in.val[2];
+        vst4_u8((uint8_t *) &dst[x], out);
+    }
+
+    svga_line_24to32_c(&dst[x], &src[x * 3], pixels - x);
+}
+
+static void
+svga_line_32to32_neon(uint32_t *dst, const uint8_t *src, int pixels)
+{
+    const uint32x4_t mask = vdupq_n_u32(0x00ffffff);
+    int              x;
+
+    for (x = 0; x <= (pixels - 4); x += 4)
+        vst1q_u32(&dst[x], vandq_u32(vld1q_u32((const uint32_t *) &src[x << 2]), mask));
+
+    svga_line_32to32_c(&dst[x], &src[x << 2], pixels - x);
+}
+#endif
+
+void
+svga_render_line_init(void)
+{
+    svga_line_funcs.conv_15to32 = svga_line_15to32_c;
+    svga_line_funcs.conv_16to32 = svga_line_16to32_c;
+    svga_line_funcs.conv_24to32 = svga_line_24to32_c;
+    svga_line_funcs.conv_32to32 = svga_line_32to32_c;
+
+#if defined(USE_SSE2)
+    svga_line_funcs.conv_15to32 = svga_line_15to32_sse2;
+    svga_line_funcs.conv_16to32 = svga_line_16to32_sse2;
+    svga_line_funcs.conv_32to32 = svga_line_32to32_sse2;
+
+#    ifdef USE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        svga_line_funcs.conv_15to32 = svga_line_15to32_avx2;
+        svga_line_funcs.conv_16to32 = svga_line_16to32_avx2;
+        svga_line_funcs.conv_24to32 = svga_line_24to32_avx2;
+        svga_line_funcs.conv_32to32 = svga_line_32to32_avx2;
+    }
+#    endif
+#elif defined(USE_NEON)
+    svga_line_funcs.conv_15to32 = svga_line_15to32_neon;
+    svga_line_funcs.conv_16to32 = svga_line_16to32_neon;
+    svga_line_funcs.conv_24to32 = svga_line_24to32_neon;
+    svga_line_funcs.conv_32to32 = svga_line_32to32_neon;
+#endif
+}
@@ -921,8 +921,7 @@ voodoo_card_init(void)
     voodoo->texture_mask      = (voodoo->texture_size << 20) - 1;
     voodoo->fb_size           = device_get_config_int("framebuffer_memory");
     voodoo->fb_mask           = (voodoo->fb_size << 20) - 1;
-    voodoo->render_threads    = device_get_config_int("render_threads");
-    voodoo->odd_even_mask     = voodoo->render_threads - 1;
+    voodoo->render_threads    = MIN(MAX(device_get_config_int("render_threads"), 1), VOODOO_RENDER_THREADS_MAX);
 #ifndef NO_CODEGEN
     voodoo->use_recompiler = device_get_config_int("recompiler");
 #endif
@@ -958,47 +957,19 @@ voodoo_card_init(void)
     voodoo->tex_mem_w[0] = (uint16_t *) voodoo->tex_mem[0];
     voodoo->tex_mem_w[1] = (uint16_t *) voodoo->tex_mem[1];
 
-    for (c = 0; c < TEX_CACHE_MAX; c++) {
-        voodoo->texture_cache[0][c].data     = malloc((256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4);
-        voodoo->texture_cache[0][c].base     = -1; /*invalid*/
-        voodoo->texture_cache[0][c].refcount = 0;
-        if (voodoo->dual_tmus) {
-            voodoo->texture_cache[1][c].data     = malloc((256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4);
-            voodoo->texture_cache[1][c].base     = -1; /*invalid*/
-            voodoo->texture_cache[1][c].refcount = 0;
-        }
-    }
+    voodoo_texture_cache_init(voodoo);
 
     timer_add(&voodoo->timer, voodoo_callback, voodoo, 1);
 
     voodoo->svga     = svga_get_pri();
     voodoo->fbiInit0 = 0;
 
-    voodoo->wake_fifo_thread         = thread_create_event();
-    voodoo->wake_render_thread[0]    = thread_create_event();
-    voodoo->wake_render_thread[1]    = thread_create_event();
-    voodoo->wake_render_thread[2]    = thread_create_event();
-    voodoo->wake_render_thread[3]    = thread_create_event();
-    voodoo->wake_main_thread         = thread_create_event();
-    voodoo->fifo_not_full_event      = thread_create_event();
-    voodoo->render_not_full_event[0] = thread_create_event();
-    voodoo->render_not_full_event[1] = thread_create_event();
-    voodoo->render_not_full_event[2] = thread_create_event();
-    voodoo->render_not_full_event[3] = thread_create_event();
-    voodoo->fifo_thread_run          = 1;
-    voodoo->fifo_thread              = thread_create(voodoo_fifo_thread, voodoo);
-    voodoo->render_thread_run[0]     = 1;
-    voodoo->render_thread[0]         = thread_create(voodoo_render_thread_1, voodoo);
-    if (voodoo->render_threads >= 2) {
-        voodoo->render_thread_run[1] = 1;
-        voodoo->render_thread[1]     = thread_create(voodoo_render_thread_2, voodoo);
-    }
-    if (voodoo->render_threads == 4) {
-        voodoo->render_thread_run[2] = 1;
-        voodoo->render_thread[2]     = thread_create(voodoo_render_thread_3, voodoo);
-        voodoo->render_thread_run[3] = 1;
-        voodoo->render_thread[3]     = thread_create(voodoo_render_thread_4, voodoo);
-    }
+    voodoo->wake_fifo_thread    = thread_create_event();
+    voodoo->wake_main_thread    = thread_create_event();
+    voodoo->fifo_not_full_event = thread_create_event();
+    voodoo->fifo_thread_run     = 1;
+    voodoo->fifo_thread         = thread_create(voodoo_fifo_thread, voodoo);
+    voodoo_render_threads_start(voodoo);
     voodoo->swap_mutex = thread_create_mutex();
     timer_add(&voodoo->wake_timer, voodoo_wake_timer, (void *) voodoo, 0);
 
@@ -1072,8 +1043,7 @@ voodoo_2d3d_card_init(int type)
     voodoo->bilinear_enabled  = device_get_config_int("bilinear");
     voodoo->dithersub_enabled = device_get_config_int("dithersub");
     voodoo->scrfilter         = device_get_config_int("dacfilter");
-    voodoo->render_threads    = device_get_config_int("render_threads");
-    voodoo->odd_even_mask     = voodoo->render_threads - 1;
+    voodoo->render_threads    = MIN(MAX(device_get_config_int("render_threads"), 1), VOODOO_RENDER_THREADS_MAX);
 #ifndef NO_CODEGEN
     voodoo->use_recompiler = device_get_config_int("recompiler");
 #endif
@@ -1083,46 +1053,18 @@ voodoo_2d3d_card_init(int type)
     /*generate filter lookup tables*/
     voodoo_generate_filter_v2(voodoo);
 
-    for (c = 0; c < TEX_CACHE_MAX; c++) {
-        voodoo->texture_cache[0][c].data     = malloc((256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4);
-        voodoo->texture_cache[0][c].base     = -1; /*invalid*/
-        voodoo->texture_cache[0][c].refcount = 0;
-        if (voodoo->dual_tmus) {
-            voodoo->texture_cache[1][c].data     = malloc((256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4);
-            voodoo->texture_cache[1][c].base     = -1; /*invalid*/
-            voodoo->texture_cache[1][c].refcount = 0;
-        }
-    }
+    voodoo_texture_cache_init(voodoo);
 
     timer_add(&voodoo->timer, voodoo_callback, voodoo, 1);
 
     voodoo->fbiInit0 = 0;
 
-    voodoo->wake_fifo_thread         = thread_create_event();
-    voodoo->wake_render_thread[0]    = thread_create_event();
-    voodoo->wake_render_thread[1]    = thread_create_event();
-    voodoo->wake_render_thread[2]    = thread_create_event();
-    voodoo->wake_render_thread[3]    = thread_create_event();
-    voodoo->wake_main_thread         = thread_create_event();
-    voodoo->fifo_not_full_event      = thread_create_event();
-    voodoo->render_not_full_event[0] = thread_create_event();
-    voodoo->render_not_full_event[1] = thread_create_event();
-    voodoo->render_not_full_event[2] = thread_create_event();
-    voodoo->render_not_full_event[3] = thread_create_event();
-    voodoo->fifo_thread_run          = 1;
-    voodoo->fifo_thread              = thread_create(voodoo_fifo_thread, voodoo);
-    voodoo->render_thread_run[0]     = 1;
-    voodoo->render_thread[0]         = thread_create(voodoo_render_thread_1, voodoo);
-    if (voodoo->render_threads >= 2) {
-        voodoo->render_thread_run[1] = 1;
-        voodoo->render_thread[1]     = thread_create(voodoo_render_thread_2, voodoo);
-    }
-    if (voodoo->render_threads == 4) {
-        voodoo->render_thread_run[2] = 1;
-        voodoo->render_thread[2]     = thread_create(voodoo_render_thread_3, voodoo);
-        voodoo->render_thread_run[3] = 1;
-        voodoo->render_thread[3]     = thread_create(voodoo_render_thread_4, voodoo);
-    }
+    voodoo->wake_fifo_thread    = thread_create_event();
+    voodoo->wake_main_thread    = thread_create_event();
+    voodoo->fifo_not_full_event = thread_create_event();
+    voodoo->fifo_thread_run     = 1;
+    voodoo->fifo_thread         = thread_create(voodoo_fifo_thread, voodoo);
+    voodoo_render_threads_start(voodoo);
     voodoo->swap_mutex = thread_create_mutex();
     timer_add(&voodoo->wake_timer, voodoo_wake_timer, (void *) voodoo, 0);
 
@@ -1249,35 +1191,12 @@ voodoo_card_close(voodoo_t *voodoo)
     voodoo->fifo_thread_run = 0;
     thread_set_event(voodoo->wake_fifo_thread);
     thread_wait(voodoo->fifo_thread);
-    voodoo->render_thread_run[0] = 0;
-    thread_set_event(voodoo->wake_render_thread[0]);
-    thread_wait(voodoo->render_thread[0]);
-    if (voodoo->render_threads >= 2) {
-        voodoo->render_thread_run[1] = 0;
-        thread_set_event(voodoo->wake_render_thread[1]);
-        thread_wait(voodoo->render_thread[1]);
-    }
-    if (voodoo->render_threads == 4) {
-        voodoo->render_thread_run[2] = 0;
-        thread_set_event(voodoo->wake_render_thread[2]);
-        thread_wait(voodoo->render_thread[2]);
-        voodoo->render_thread_run[3] = 0;
-        thread_set_event(voodoo->wake_render_thread[3]);
-        thread_wait(voodoo->render_thread[3]);
-    }
+    voodoo_render_threads_stop(voodoo);
     thread_destroy_event(voodoo->fifo_not_full_event);
     thread_destroy_event(voodoo->wake_main_thread);
     thread_destroy_event(voodoo->wake_fifo_thread);
-    thread_destroy_event(voodoo->wake_render_thread[0]);
-    thread_destroy_event(voodoo->wake_render_thread[1]);
-    thread_destroy_event(voodoo->render_not_full_event[0]);
-    thread_destroy_event(voodoo->render_not_full_event[1]);
 
-    for (uint8_t c = 0; c < TEX_CACHE_MAX; c++) {
-        if (voodoo->dual_tmus)
-            free(voodoo->texture_cache[1][c].data);
-        free(voodoo->texture_cache[0][c].data);
-    }
+    voodoo_texture_cache_close(voodoo);
 #ifndef NO_CODEGEN
     voodoo_codegen_close(voodoo);
 #endif
@@ -1389,25 +1308,39 @@ static const device_config_t voodoo_config[] = {
     {
         .name = "render_threads",
         .description = "Render threads",
+        .type = CONFIG_SPINNER,
+        .spinner = {
+            .min = 1,
+            .max = VOODOO_RENDER_THREADS_MAX
+        },
+        .default_int = 2
+    },
+    {
+        .name = "texture_cache",
+        .description = "Texture cache size",
         .type = CONFIG_SELECTION,
         .selection = {
             {
-                .description = "1",
-                .value = 1
+                .description = "64 textures",
+                .value = 64
             },
             {
-                .description = "2",
-                .value = 2
+                .description = "128 textures",
+                .value = 128
             },
             {
-                .description = "4",
-                .value = 4
+                .description = "256 textures",
+                .value = 256
+            },
+            {
+                .description = "512 textures",
+                .value = 512
             },
             {
                 .description = ""
             }
         },
-        .default_int = 2
+        .default_int = 64
     },
     {
         .name = "sli",
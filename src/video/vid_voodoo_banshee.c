@@ -1084,9 +1084,12 @@ banshee_status(banshee_t *banshee)
     int           fifo_entries = FIFO_ENTRIES;
     int           swap_count   = voodoo->swap_count;
     int           written      = voodoo->cmd_written + voodoo->cmd_written_fifo;
-    int           busy         = (written - voodoo->cmd_read) || (voodoo->cmdfifo_depth_rd != voodoo->cmdfifo_depth_wr) || voodoo->render_voodoo_busy[0] || voodoo->render_voodoo_busy[1] || voodoo->render_voodoo_busy[2] || voodoo->render_voodoo_busy[3] || voodoo->voodoo_busy;
+    int           busy         = (written - voodoo->cmd_read) || (voodoo->cmdfifo_depth_rd != voodoo->cmdfifo_depth_wr) || voodoo->voodoo_busy;
     uint32_t      ret          = 0;
 
+    for (int c = 0; c < voodoo->render_threads; c++)
+        busy |= voodoo->render_voodoo_busy[c];
+
     if (fifo_entries < 0x20)
         ret |= 0x1f - fifo_entries;
     else
@@ -3070,25 +3073,39 @@ static const device_config_t banshee_sgram_config[] = {
     {
         .name = "render_threads",
         .description = "Render threads",
+        .type = CONFIG_SPINNER,
+        .spinner = {
+            .min = 1,
+            .max = VOODOO_RENDER_THREADS_MAX
+        },
+        .default_int = 2
+    },
+    {
+        .name = "texture_cache",
+        .description = "Texture cache size",
         .type = CONFIG_SELECTION,
         .selection = {
             {
-                .description = "1",
-                .value = 1
+                .description = "64 textures",
+                .value = 64
             },
             {
-                .description = "2",
-                .value = 2
+                .description = "128 textures",
+                .value = 128
             },
             {
-                .description = "4",
-                .value = 4
+                .description = "256 textures",
+                .value = 256
+            },
+            {
+                .description = "512 textures",
+                .value = 512
             },
             {
                 .description = ""
             }
         },
-        .default_int = 2
+        .default_int = 64
     },
 #ifndef NO_CODEGEN
     {
@@ -3125,25 +3142,39 @@ static const device_config_t banshee_sgram_16mbonly_config[] = {
     {
         .name = "render_threads",
         .description = "Render threads",
+        .type = CONFIG_SPINNER,
+        .spinner = {
+            .min = 1,
+            .max = VOODOO_RENDER_THREADS_MAX
+        },
+        .default_int = 2
+    },
+    {
+        .name = "texture_cache",
+        .description = "Texture cache size",
         .type = CONFIG_SELECTION,
         .selection = {
             {
-                .description = "1",
-                .value = 1
+                .description = "64 textures",
+                .value = 64
+            },
+            {
+                .description = "128 textures",
+                .value = 128
             },
             {
-                .description = "2",
-                .value = 2
+                .description = "256 textures",
+                .value = 256
             },
             {
-                .description = "4",
-                .value = 4
+                .description = "512 textures",
+                .value = 512
             },
             {
                 .description = ""
             }
         },
-        .default_int = 2
+        .default_int = 64
     },
 #ifndef NO_CODEGEN
     {
@@ -3180,25 +3211,39 @@ static const device_config_t banshee_sdram_config[] = {
     {
         .name = "render_threads",
         .description = "Render threads",
+        .type = CONFIG_SPINNER,
+        .spinner = {
+            .min = 1,
+            .max = VOODOO_RENDER_THREADS_MAX
+        },
+        .default_int = 2
+    },
+    {
+        .name = "texture_cache",
+        .description = "Texture cache size",
         .type = CONFIG_SELECTION,
         .selection = {
             {
-                .description = "1",
-                .value = 1
+                .description = "64 textures",
+                .value = 64
             },
             {
-                .description = "2",
-                .value = 2
+                .description = "128 textures",
+                .value = 128
             },
             {
-                .description = "4",
-                .value = 4
+                .description = "256 textures",
+                .value = 256
+            },
+            {
+                .description = "512 textures",
+                .value = 512
             },
             {
                 .description = ""
             }
         },
-        .default_int = 2
+        .default_int = 64
     },
 #ifndef NO_CODEGEN
     {
@@ -831,10 +831,10 @@ voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *
             real_y >>= 4;
 
         if (SLI_ENABLED) {
-            if (((real_y >> 1) & voodoo->odd_even_mask) != odd_even)
+            if (((uint32_t) (real_y >> 1) % voodoo->render_threads) != odd_even)
                 goto next_line;
         } else {
-            if ((real_y & voodoo->odd_even_mask) != odd_even)
+            if (((uint32_t) real_y % voodoo->render_threads) != odd_even)
                 goto next_line;
         }
 
@@ -1570,25 +1570,43 @@ render_thread(void *param, int odd_even)
     }
 }
 
-void
-voodoo_render_thread_1(void *param)
-{
-    render_thread(param, 0);
-}
-void
-voodoo_render_thread_2(void *param)
+static void
+voodoo_render_thread(void *param)
 {
-    render_thread(param, 1);
+    const voodoo_render_thread_t *data = (voodoo_render_thread_t *) param;
+
+    render_thread(data->voodoo, data->index);
 }
+
 void
-voodoo_render_thread_3(void *param)
+voodoo_render_threads_start(voodoo_t *voodoo)
 {
-    render_thread(param, 2);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        voodoo->wake_render_thread[c]    = thread_create_event();
+        voodoo->render_not_full_event[c] = thread_create_event();
+    }
+
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        voodoo->render_thread_data[c].voodoo = voodoo;
+        voodoo->render_thread_data[c].index  = c;
+        voodoo->render_thread_run[c]         = 1;
+        voodoo->render_thread[c]             = thread_create(voodoo_render_thread, &voodoo->render_thread_data[c]);
+    }
 }
+
 void
-voodoo_render_thread_4(void *param)
+voodoo_render_threads_stop(voodoo_t *voodoo)
 {
-    render_thread(param, 3);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        voodoo->render_thread_run[c] = 0;
+        thread_set_event(voodoo->wake_render_thread[c]);
+        thread_wait(voodoo->render_thread[c]);
+    }
+
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        thread_destroy_event(voodoo->wake_render_thread[c]);
+        thread_destroy_event(voodoo->render_not_full_event[c]);
+    }
 }
 
 void
@@ -1596,22 +1614,12 @@ voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 {
     voodoo_params_t *params_new = &voodoo->params_buffer[voodoo->params_write_idx & PARAM_MASK];
 
-    while (PARAM_FULL(0) || (voodoo->render_threads >= 2 && PARAM_FULL(1)) || (voodoo->render_threads == 4 && (PARAM_FULL(2) || PARAM_FULL(3)))) {
-        thread_reset_event(voodoo->render_not_full_event[0]);
-        if (voodoo->render_threads >= 2)
-            thread_reset_event(voodoo->render_not_full_event[1]);
-        if (voodoo->render_threads == 4) {
-            thread_reset_event(voodoo->render_not_full_event[2]);
-            thread_reset_event(voodoo->render_not_full_event[3]);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        while (PARAM_FULL(c)) {
+            thread_reset_event(voodoo->render_not_full_event[c]);
+            if (PARAM_FULL(c))
+                thread_wait_event(voodoo->render_not_full_event[c], -1); /*Wait for room in ringbuffer*/
         }
-        if (PARAM_FULL(0))
-            thread_wait_event(voodoo->render_not_full_event[0], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads >= 2 && PARAM_FULL(1))
-            thread_wait_event(voodoo->render_not_full_event[1], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads == 4 && PARAM_FULL(2))
-            thread_wait_event(voodoo->render_not_full_event[2], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads == 4 && PARAM_FULL(3))
-            thread_wait_event(voodoo->render_not_full_event[3], -1); /*Wait for room in ringbuffer*/
     }
 
     voodoo_use_texture(voodoo, params, 0);
@@ -1622,6 +1630,10 @@ voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 
     voodoo->params_write_idx++;
 
-    if (PARAM_ENTRIES(0) < 4 || (voodoo->render_threads >= 2 && PARAM_ENTRIES(1) < 4) || (voodoo->render_threads == 4 && (PARAM_ENTRIES(2) < 4 || PARAM_ENTRIES(3) < 4)))
-        voodoo_wake_render_thread(voodoo);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        if (PARAM_ENTRIES(c) < 4) {
+            voodoo_wake_render_thread(voodoo);
+            break;
+        }
+    }
 }
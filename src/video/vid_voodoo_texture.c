@@ -239,15 +239,175 @@ voodoo_recalc_tex3(voodoo_t *voodoo, int tmu)
 
 #define makergba(r, g, b, a) ((b) | ((g) << 8) | ((r) << 16) | ((a) << 24))
 
+#define TEX_DATA_SIZE  ((256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4)
+#define TEX_HASH_BASIS 0xcbf29ce484222325ULL
+#define TEX_HASH_PRIME 0x100000001b3ULL
+
+/*A texture is in use until every render thread has consumed all the triangles referencing it*/
+static int
+voodoo_texture_in_use(voodoo_t *voodoo, const texture_t *texture)
+{
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        if (texture->refcount != texture->refcount_r[c])
+            return 1;
+    }
+
+    return 0;
+}
+
+static __inline int
+voodoo_texture_bucket(uint32_t base, uint32_t tLOD, uint32_t palette_checksum)
+{
+    uint32_t hash = (base >> 3) ^ (tLOD * 0x9e3779b1) ^ (palette_checksum * 0x85ebca6b);
+
+    return (hash ^ (hash >> 16)) & (TEX_CACHE_HASH - 1);
+}
+
+static void
+voodoo_texture_link(voodoo_t *voodoo, int tmu, int c)
+{
+    texture_t *texture = &voodoo->texture_cache[tmu][c];
+    int       *head    = &voodoo->texture_hash[tmu][voodoo_texture_bucket(texture->base, texture->tLOD, texture->palette_checksum)];
+
+    texture->next = *head;
+    *head         = c;
+}
+
+/*Remove an entry from the cache and drop its reference to the decoded data*/
+static void
+voodoo_texture_unlink(voodoo_t *voodoo, int tmu, int c)
+{
+    texture_t *texture = &voodoo->texture_cache[tmu][c];
+    int       *link;
+
+    if (texture->base == -1)
+        return;
+
+    link = &voodoo->texture_hash[tmu][voodoo_texture_bucket(texture->base, texture->tLOD, texture->palette_checksum)];
+    while (*link != -1) {
+        if (*link == c) {
+            *link = texture->next;
+            break;
+        }
+        link = &voodoo->texture_cache[tmu][*link].next;
+    }
+
+    if (texture->buf != -1)
+        voodoo->texture_buf[tmu][texture->buf].users--;
+    texture->buf  = -1;
+    texture->base = -1;
+}
+
+/*Pick the least recently used entry that no queued triangle refers to. If
+  every entry is queued, wait for the oldest one only rather than draining
+  the whole render pipeline*/
+static int
+voodoo_texture_evict(voodoo_t *voodoo, int tmu)
+{
+    texture_t *cache  = voodoo->texture_cache[tmu];
+    int        victim = -1;
+    int        oldest = 0;
+
+    for (int c = 0; c < voodoo->texture_cache_size; c++) {
+        if (voodoo_texture_in_use(voodoo, &cache[c])) {
+            if ((int32_t) (cache[c].last_used - cache[oldest].last_used) < 0)
+                oldest = c;
+            continue;
+        }
+        if (cache[c].base == -1)
+            return c;
+        if ((victim == -1) || ((int32_t) (cache[c].last_used - cache[victim].last_used) < 0))
+            victim = c;
+    }
+
+    if (victim == -1) {
+        voodoo->texture_stats.stalls++;
+        while (voodoo_texture_in_use(voodoo, &cache[oldest])) {
+            voodoo_wake_render_thread(voodoo);
+            for (int c = 0; c < voodoo->render_threads; c++) {
+                if (voodoo_render_thread_busy(voodoo, c))
+                    thread_wait_event(voodoo->render_not_full_event[c], 1);
+            }
+        }
+        victim = oldest;
+    }
+
+    voodoo_texture_unlink(voodoo, tmu, victim);
+    return victim;
+}
+
+/*NCC decoding depends on tables outside texture memory, so those formats are never shared*/
+static __inline int
+voodoo_texture_can_share(int tformat)
+{
+    return (tformat != TEX_Y4I2Q2) && (tformat != TEX_A8Y4I2Q2);
+}
+
+/*Hash the texels a decode of the current texture would read, together with
+  the layout of each LOD*/
+static uint64_t
+voodoo_texture_hash(voodoo_t *voodoo, voodoo_params_t *params, int tmu, int lod_min, int lod_max)
+{
+    uint64_t hash = TEX_HASH_BASIS;
+    int      bpp  = (params->tformat[tmu] & 8) ? 2 : 1;
+
+    for (int lod = lod_min; lod <= lod_max; lod++) {
+        uint32_t tex_addr = params->tex_base[tmu][lod] & voodoo->texture_mask;
+        uint32_t w        = (voodoo->params.tex_w_mask[tmu][lod] + 1) * bpp;
+        uint32_t h        = voodoo->params.tex_h_mask[tmu][lod] + 1;
+
+        hash = (hash ^ (w | (h << 16) | ((uint64_t) params->tex_lod[tmu][lod] << 32))) * TEX_HASH_PRIME;
+
+        for (uint32_t y = 0; y < h; y++) {
+            uint32_t x = 0;
+
+            if ((tex_addr + w) <= (voodoo->texture_mask + 1)) {
+                for (; (x + 8) <= w; x += 8) {
+                    uint64_t dat;
+
+                    memcpy(&dat, &voodoo->tex_mem[tmu][tex_addr + x], 8);
+                    hash = (hash ^ dat) * TEX_HASH_PRIME;
+                }
+            }
+            for (; x < w; x++)
+                hash = (hash ^ voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask]) * TEX_HASH_PRIME;
+
+            tex_addr = (tex_addr + (1 << (voodoo->params.tex_shift[tmu][lod] + bpp - 1))) & voodoo->texture_mask;
+        }
+    }
+
+    return hash;
+}
+
+static void
+voodoo_texture_frame_stats(voodoo_t *voodoo)
+{
+    if (voodoo->frame_count == voodoo->texture_stats_frame_nr)
+        return;
+
+    voodoo_texture_log("Texture cache: %i hits, %i misses, %i shared, %i stalls\n",
+                       voodoo->texture_stats.hits, voodoo->texture_stats.misses,
+                       voodoo->texture_stats.shared, voodoo->texture_stats.stalls);
+
+    voodoo->texture_stats_frame    = voodoo->texture_stats;
+    voodoo->texture_stats_frame_nr = voodoo->frame_count;
+    memset(&voodoo->texture_stats, 0, sizeof(texture_stats_t));
+}
+
 void
 voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
 {
-    int      c;
-    int      lod_min;
-    int      lod_max;
-    uint32_t addr = 0;
-    uint32_t addr_end;
-    uint32_t palette_checksum;
+    texture_t *texture;
+    int        c;
+    int        lod_min;
+    int        lod_max;
+    int        shared = 0;
+    uint32_t   addr   = 0;
+    uint32_t   addr_end;
+    uint32_t   palette_checksum;
+    uint32_t   tLOD = params->tLOD[tmu] & 0xf00fff;
+
+    voodoo_texture_frame_stats(voodoo);
 
     lod_min = (params->tLOD[tmu] >> 2) & 15;
     lod_max = (params->tLOD[tmu] >> 8) & 15;
@@ -272,35 +432,29 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
         addr = params->texBaseAddr[tmu];
 
     /*Try to find texture in cache*/
-    for (c = 0; c < TEX_CACHE_MAX; c++) {
-        if (voodoo->texture_cache[tmu][c].base == addr && voodoo->texture_cache[tmu][c].tLOD == (params->tLOD[tmu] & 0xf00fff) && voodoo->texture_cache[tmu][c].palette_checksum == palette_checksum) {
+    for (c = voodoo->texture_hash[tmu][voodoo_texture_bucket(addr, tLOD, palette_checksum)]; c != -1; c = voodoo->texture_cache[tmu][c].next) {
+        texture = &voodoo->texture_cache[tmu][c];
+
+        if (texture->base == addr && texture->tLOD == tLOD && texture->palette_checksum == palette_checksum) {
             params->tex_entry[tmu] = c;
-            voodoo->texture_cache[tmu][c].refcount++;
+            texture->last_used     = ++voodoo->texture_stamp;
+            texture->refcount++;
+            voodoo->texture_stats.hits++;
             return;
         }
     }
 
-    /*Texture not found, search for unused texture*/
-    do {
-        for (c = 0; c < TEX_CACHE_MAX; c++) {
-            voodoo->texture_last_removed++;
-            voodoo->texture_last_removed &= (TEX_CACHE_MAX - 1);
-            if (voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[0] && (voodoo->render_threads == 1 || voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[1]))
-                break;
-        }
-        if (c == TEX_CACHE_MAX)
-            voodoo_wait_for_render_thread_idle(voodoo);
-    } while (c == TEX_CACHE_MAX);
-    if (c == TEX_CACHE_MAX)
-        fatal("Texture cache full!\n");
+    voodoo->texture_stats.misses++;
 
-    c = voodoo->texture_last_removed;
+    /*Texture not found, replace the least recently used one*/
+    c       = voodoo_texture_evict(voodoo, tmu);
+    texture = &voodoo->texture_cache[tmu][c];
 
-    if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-        voodoo->texture_cache[tmu][c].base = params->texBaseAddr1[tmu];
-    else
-        voodoo->texture_cache[tmu][c].base = params->texBaseAddr[tmu];
-    voodoo->texture_cache[tmu][c].tLOD = params->tLOD[tmu] & 0xf00fff;
+    texture->base             = addr;
+    texture->tLOD             = tLOD;
+    texture->tformat          = params->tformat[tmu];
+    texture->palette_checksum = palette_checksum;
+    texture->last_used        = ++voodoo->texture_stamp;
 
     lod_min = (params->tLOD[tmu] >> 2) & 15;
     lod_max = (params->tLOD[tmu] >> 8) & 15;
@@ -309,8 +463,39 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
 #endif
     lod_min = MIN(lod_min, 8);
     lod_max = MIN(lod_max, 8);
-    for (int lod = lod_min; lod <= lod_max; lod++) {
-        uint32_t     *base     = &voodoo->texture_cache[tmu][c].data[texture_offset[lod]];
+
+    /*Share the decoded data of an identical texture uploaded elsewhere*/
+    if (voodoo_texture_can_share(texture->tformat)) {
+        texture->content_hash = voodoo_texture_hash(voodoo, params, tmu, lod_min, lod_max);
+
+        for (int d = 0; d < voodoo->texture_cache_size; d++) {
+            const texture_t *other = &voodoo->texture_cache[tmu][d];
+
+            if ((d != c) && (other->base != -1) && (other->buf != -1) && (other->tLOD == tLOD) && (other->tformat == texture->tformat) && (other->palette_checksum == palette_checksum) && (other->content_hash == texture->content_hash) && voodoo_texture_can_share(other->tformat)) {
+                texture->buf = other->buf;
+                shared       = 1;
+                voodoo->texture_stats.shared++;
+                break;
+            }
+        }
+    } else
+        texture->content_hash = 0;
+
+    if (!shared) {
+        for (int d = 0; d < voodoo->texture_cache_size; d++) {
+            if (!voodoo->texture_buf[tmu][d].users) {
+                texture->buf = d;
+                break;
+            }
+        }
+        if (!voodoo->texture_buf[tmu][texture->buf].data)
+            voodoo->texture_buf[tmu][texture->buf].data = malloc(TEX_DATA_SIZE);
+    }
+    voodoo->texture_buf[tmu][texture->buf].users++;
+    texture->data = voodoo->texture_buf[tmu][texture->buf].data;
+
+    for (int lod = lod_min; (lod <= lod_max) && !shared; lod++) {
+        uint32_t     *base     = &texture->data[texture_offset[lod]];
         uint32_t      tex_addr = params->tex_base[tmu][lod] & voodoo->texture_mask;
         int           x;
         int           y;
@@ -507,11 +692,6 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
 
     voodoo->texture_cache[tmu][c].is16 = voodoo->params.tformat[tmu] & 8;
 
-    if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
-        voodoo->texture_cache[tmu][c].palette_checksum = palette_checksum;
-    else
-        voodoo->texture_cache[tmu][c].palette_checksum = 0;
-
     if (lod_min == 0) {
         voodoo->texture_cache[tmu][c].addr_start[0] = voodoo->params.tex_base[tmu][0];
         voodoo->texture_cache[tmu][c].addr_end[0]   = voodoo->params.tex_end[tmu][0];
@@ -546,8 +726,42 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
         }
     }
 
+    voodoo_texture_link(voodoo, tmu, c);
+
     params->tex_entry[tmu] = c;
-    voodoo->texture_cache[tmu][c].refcount++;
+    texture->refcount++;
+}
+
+void
+voodoo_texture_cache_init(voodoo_t *voodoo)
+{
+    voodoo->texture_cache_size = MIN(MAX(device_get_config_int("texture_cache"), TEX_CACHE_MAX), TEX_CACHE_LIMIT);
+
+    /*Entries for TMU 1 always exist as the renderer touches its refcounts
+      unconditionally, the data buffers are only allocated on first use*/
+    for (uint8_t tmu = 0; tmu < 2; tmu++) {
+        voodoo->texture_cache[tmu] = calloc(voodoo->texture_cache_size, sizeof(texture_t));
+        voodoo->texture_buf[tmu]   = calloc(voodoo->texture_cache_size, sizeof(texture_buf_t));
+
+        for (int c = 0; c < voodoo->texture_cache_size; c++) {
+            voodoo->texture_cache[tmu][c].base = -1; /*invalid*/
+            voodoo->texture_cache[tmu][c].next = -1;
+            voodoo->texture_cache[tmu][c].buf  = -1;
+        }
+        for (int c = 0; c < TEX_CACHE_HASH; c++)
+            voodoo->texture_hash[tmu][c] = -1;
+    }
+}
+
+void
+voodoo_texture_cache_close(voodoo_t *voodoo)
+{
+    for (uint8_t tmu = 0; tmu < 2; tmu++) {
+        for (int c = 0; c < voodoo->texture_cache_size; c++)
+            free(voodoo->texture_buf[tmu][c].data);
+        free(voodoo->texture_buf[tmu]);
+        free(voodoo->texture_cache[tmu]);
+    }
 }
 
 void
@@ -559,7 +773,7 @@ flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
 #if 0
     voodoo_texture_log("Evict %08x %i\n", dirty_addr, sizeof(voodoo->texture_present));
 #endif
-    for (uint8_t c = 0; c < TEX_CACHE_MAX; c++) {
+    for (int c = 0; c < voodoo->texture_cache_size; c++) {
         if (voodoo->texture_cache[tmu][c].base != -1) {
             for (uint8_t d = 0; d < 4; d++) {
                 int addr_start = voodoo->texture_cache[tmu][c].addr_start[d];
@@ -576,10 +790,11 @@ flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
                         voodoo_texture_log("  Evict texture %i %08x\n", c, voodoo->texture_cache[tmu][c].base);
 #endif
 
-                        if (voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[0] || (voodoo->render_threads == 2 && voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[1]))
+                        if (voodoo_texture_in_use(voodoo, &voodoo->texture_cache[tmu][c]))
                             wait_for_idle = 1;
 
-                        voodoo->texture_cache[tmu][c].base = -1;
+                        voodoo_texture_unlink(voodoo, tmu, c);
+                        break;
                     } else {
                         for (; addr_start <= addr_end; addr_start += (1 << TEX_DIRTY_SHIFT))
                             voodoo->texture_present[tmu][(addr_start & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
@@ -234,12 +234,37 @@ const uint32_t shade[5][256] = {
     }
 };
 
+/* Frames are handed from the emulation thread to the blit thread through
+   a lock-free triple buffer: the emulation thread fills write_frame and
+   swaps it into ready_frame, the blit thread swaps ready_frame with
+   read_frame whenever a new one is flagged. A frame still waiting in
+   ready_frame when the next one comes in is dropped instead of stalling
+   the emulation thread. */
+#define BLIT_FRAMES      3
+#define BLIT_FRAME_MASK  0x03
+#define BLIT_FRAME_NEW   0x04
+
+typedef struct blit_frame_t {
+    bitmap_t *buffer;
+    int       x, y, w, h;
+    uint32_t  serial; /* Same serial, same contents. */
+} blit_frame_t;
+
 typedef struct blit_data_struct {
-    int x, y, w, h;
-    int busy;
-    int buffer_in_use;
-    int thread_run;
-    int monitor_index;
+    blit_frame_t frames[BLIT_FRAMES];
+    int          write_frame; /* Owned by the emulation thread. */
+    int          read_frame;  /* Owned by the blit thread. */
+    atomic_int   ready_frame;
+    uint32_t     change_serial; /* Owned by the emulation thread. */
+
+    atomic_int busy;
+    atomic_int buffer_in_use;
+    int        thread_run;
+    int        monitor_index;
+
+    atomic_uint frames_blitted;
+    atomic_uint frames_dropped;
+    atomic_uint frames_late;
 
     thread_t *blit_thread;
     event_t  *wake_blit_thread;
@@ -289,19 +314,50 @@ video_wait_for_blit_monitor(int monitor_index)
 {
     blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
 
-    while (blit_data_ptr->busy)
-        thread_wait_event(blit_data_ptr->blit_complete, -1);
+    while (blit_data_ptr->busy || (blit_data_ptr->ready_frame & BLIT_FRAME_NEW)) {
+        thread_set_event(blit_data_ptr->wake_blit_thread);
+        thread_wait_event(blit_data_ptr->blit_complete, 1);
+    }
     thread_reset_event(blit_data_ptr->blit_complete);
 }
 
 void
-video_wait_for_buffer_monitor(int monitor_index)
+video_wait_for_buffer_monitor(UNUSED(int monitor_index))
+{
+    /* The renderer only ever reads the blit frames, never target_buffer,
+       so the card can always write to it right away. */
+}
+
+bitmap_t *
+video_get_blit_buffer_monitor(int monitor_index)
+{
+    const blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    return blit_data_ptr->frames[blit_data_ptr->read_frame].buffer;
+}
+
+/* Frames that carry the same serial have the same contents, which lets a
+   renderer skip a frame outright. This survives dropped frames as the
+   serial moves on with every changed frame, blitted or not. */
+uint32_t
+video_get_blit_serial_monitor(int monitor_index)
+{
+    const blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+
+    return blit_data_ptr->frames[blit_data_ptr->read_frame].serial;
+}
+
+void
+video_get_blit_stats_monitor(int monitor_index, uint32_t *blitted, uint32_t *dropped, uint32_t *late)
 {
     blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
 
-    while (blit_data_ptr->buffer_in_use)
-        thread_wait_event(blit_data_ptr->buffer_not_in_use, -1);
-    thread_reset_event(blit_data_ptr->buffer_not_in_use);
+    if (blitted)
+        *blitted = blit_data_ptr->frames_blitted;
+    if (dropped)
+        *dropped = blit_data_ptr->frames_dropped;
+    if (late)
+        *late = blit_data_ptr->frames_late;
 }
 
 static png_structp png_ptr[MONITORS_NUM];
@@ -310,10 +366,11 @@ static png_infop   info_ptr[MONITORS_NUM];
 static void
 video_take_screenshot_monitor(const char *fn, uint32_t *buf, int start_x, int start_y, int row_len, int monitor_index)
 {
-    png_bytep         *b_rgb         = NULL;
-    FILE              *fp            = NULL;
-    uint32_t           temp          = 0x00000000;
-    const blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+    png_bytep          *b_rgb         = NULL;
+    FILE               *fp            = NULL;
+    uint32_t            temp          = 0x00000000;
+    const blit_data_t  *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+    const blit_frame_t *frame         = &blit_data_ptr->frames[blit_data_ptr->read_frame];
 
     /* create file */
     fp = plat_fopen(fn, (const char *) "wb");
@@ -340,20 +397,20 @@ video_take_screenshot_monitor(const char *fn, uint32_t *buf, int start_x, int st
 
     png_init_io(png_ptr[monitor_index], fp);
 
-    png_set_IHDR(png_ptr[monitor_index], info_ptr[monitor_index], blit_data_ptr->w, blit_data_ptr->h,
+    png_set_IHDR(png_ptr[monitor_index], info_ptr[monitor_index], frame->w, frame->h,
                  8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
                  PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
-    b_rgb = (png_bytep *) malloc(sizeof(png_bytep) * blit_data_ptr->h);
+    b_rgb = (png_bytep *) malloc(sizeof(png_bytep) * frame->h);
     if (b_rgb == NULL) {
         video_log("[video_take_screenshot] Unable to Allocate RGB Bitmap Memory");
         fclose(fp);
         return;
     }
 
-    for (int y = 0; y < blit_data_ptr->h; ++y) {
+    for (int y = 0; y < frame->h; ++y) {
         b_rgb[y] = (png_byte *) malloc(png_get_rowbytes(png_ptr[monitor_index], info_ptr[monitor_index]));
-        for (int x = 0; x < blit_data_ptr->w; ++x) {
+        for (int x = 0; x < frame->w; ++x) {
             if (buf == NULL)
                 memset(&(b_rgb[y][x * 3]), 0x00, 3);
             else {
@@ -372,7 +429,7 @@ video_take_screenshot_monitor(const char *fn, uint32_t *buf, int start_x, int st
     png_write_end(png_ptr[monitor_index], NULL);
 
     /* cleanup heap allocation */
-    for (int i = 0; i < blit_data_ptr->h; i++)
+    for (int i = 0; i < frame->h; i++)
         if (b_rgb[i])
             free(b_rgb[i]);
 
@@ -444,40 +501,93 @@ video_transform_copy(void *__restrict _Dst, const void *__restrict _Src, size_t
 static void
 blit_thread(void *param)
 {
-    blit_data_t *data = param;
+    blit_data_t        *data = param;
+    const blit_frame_t *frame;
+
     while (data->thread_run) {
         thread_wait_event(data->wake_blit_thread, -1);
         thread_reset_event(data->wake_blit_thread);
-        MTR_BEGIN("video", "blit_thread");
 
-        if (blit_func)
-            blit_func(data->x, data->y, data->w, data->h, data->monitor_index);
+        while (data->thread_run && (data->ready_frame & BLIT_FRAME_NEW)) {
+            MTR_BEGIN("video", "blit_thread");
+            data->busy = 1;
+
+            /* Hand the frame we are done with back and take the newest one. */
+            data->read_frame = atomic_exchange(&data->ready_frame, data->read_frame) & BLIT_FRAME_MASK;
+            frame            = &data->frames[data->read_frame];
+
+            data->buffer_in_use = 1;
+            if (blit_func)
+                blit_func(frame->x, frame->y, frame->w, frame->h, data->monitor_index);
+            else
+                data->buffer_in_use = 0;
+
+            /* The renderer may finish with the frame asynchronously. */
+            while (data->buffer_in_use && data->thread_run)
+                thread_wait_event(data->buffer_not_in_use, 1);
+            thread_reset_event(data->buffer_not_in_use);
 
-        data->busy = 0;
+            data->frames_blitted++;
+            data->busy = 0;
 
-        MTR_END("video", "blit_thread");
-        thread_set_event(data->blit_complete);
+            MTR_END("video", "blit_thread");
+            thread_set_event(data->blit_complete);
+        }
     }
 }
 
 void
 video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
 {
+    blit_data_t    *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
+    const bitmap_t *src           = monitors[monitor_index].target_buffer;
+    blit_frame_t   *frame;
+    int             prev;
+    int             x1;
+    int             y1;
+    int             x2;
+    int             y2;
+
     MTR_BEGIN("video", "video_blit_memtoscreen");
 
     if ((w <= 0) || (h <= 0))
         return;
 
-    video_wait_for_blit_monitor(monitor_index);
-
-    monitors[monitor_index].mon_blit_data_ptr->busy          = 1;
-    monitors[monitor_index].mon_blit_data_ptr->buffer_in_use = 1;
-    monitors[monitor_index].mon_blit_data_ptr->x             = x;
-    monitors[monitor_index].mon_blit_data_ptr->y             = y;
-    monitors[monitor_index].mon_blit_data_ptr->w             = w;
-    monitors[monitor_index].mon_blit_data_ptr->h             = h;
+    if (blit_data_ptr->busy)
+        blit_data_ptr->frames_late++;
+
+    /* Snapshot the dirty area so the card can carry on drawing the next frame. */
+    frame = &blit_data_ptr->frames[blit_data_ptr->write_frame];
+    x1    = MAX(x, 0);
+    y1    = MAX(y, 0);
+    x2    = MIN(x + w, src->w);
+    y2    = MIN(y + h, src->h);
+    if ((x2 > x1) && (y2 > y1)) {
+        if ((frame->buffer == NULL) || (frame->buffer->w < x2) || (frame->buffer->h < y2)) {
+            if (frame->buffer != NULL)
+                destroy_bitmap(frame->buffer);
+            frame->buffer = create_bitmap(x2, y2);
+        }
+        for (int row = y1; row < y2; row++)
+            memcpy(&frame->buffer->line[row][x1], &src->line[row][x1], (x2 - x1) << 2);
+    }
+    frame->x = x;
+    frame->y = y;
+    frame->w = w;
+    frame->h = h;
+
+    if (!monitors[monitor_index].mon_frame_unchanged)
+        blit_data_ptr->change_serial++;
+    frame->serial = blit_data_ptr->change_serial;
+
+    prev                       = atomic_exchange(&blit_data_ptr->ready_frame, blit_data_ptr->write_frame | BLIT_FRAME_NEW);
+    blit_data_ptr->write_frame = prev & BLIT_FRAME_MASK;
+    if (prev & BLIT_FRAME_NEW) {
+        blit_data_ptr->frames_dropped++;
+        video_log("Video: monitor %i dropped a frame\n", monitor_index);
+    }
 
-    thread_set_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
+    thread_set_event(blit_data_ptr->wake_blit_thread);
     MTR_END("video", "video_blit_memtoscreen");
 }
 
@@ -864,6 +974,9 @@ video_monitor_init(int index)
     monitors[index].mon_blit_data_ptr->buffer_not_in_use = thread_create_event();
     monitors[index].mon_blit_data_ptr->thread_run        = 1;
     monitors[index].mon_blit_data_ptr->monitor_index     = index;
+    monitors[index].mon_blit_data_ptr->write_frame       = 0;
+    monitors[index].mon_blit_data_ptr->read_frame        = 1;
+    atomic_init(&monitors[index].mon_blit_data_ptr->ready_frame, 2);
     monitors[index].mon_pal_lookup                       = calloc(sizeof(uint32_t), 256);
     monitors[index].mon_cga_palette                      = calloc(1, sizeof(int));
     monitors[index].mon_force_resize                     = 1;
@@ -884,6 +997,10 @@ video_monitor_close(int monitor_index)
     monitors[monitor_index].mon_blit_data_ptr->thread_run = 0;
     thread_set_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
     thread_wait(monitors[monitor_index].mon_blit_data_ptr->blit_thread);
+    for (int c = 0; c < BLIT_FRAMES; c++) {
+        if (monitors[monitor_index].mon_blit_data_ptr->frames[c].buffer != NULL)
+            destroy_bitmap(monitors[monitor_index].mon_blit_data_ptr->frames[c].buffer);
+    }
     if (monitor_index >= 1)
         ui_deinit_monitor(monitor_index);
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->buffer_not_in_use);
@@ -15,6 +15,7 @@
  *
  *          Copyright 2017-2019 Fred N. van Kempen.
  */
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -36,6 +37,16 @@
 #define VNC_MAX_X 2048
 #define VNC_MIN_Y 200
 #define VNC_MAX_Y 2048
+#define VNC_TILE  32
+
+typedef struct vnc_stats_t {
+    uint32_t time;
+    long     sent_gone;  /* bytes sent to clients that have since left */
+    long     sent_last;
+    uint64_t marked;     /* raw bytes marked as modified */
+    uint32_t frames;
+    uint32_t skipped;
+} vnc_stats_t;
 
 static rfbScreenInfoPtr rfb = NULL;
 static int              clients;
@@ -45,6 +56,10 @@ static int              allowedY;
 static int              ptr_x;
 static int              ptr_y;
 static int              ptr_but;
+static int              full_update;
+static uint32_t         last_serial;
+static uint8_t          tile_dirty[VNC_MAX_X / VNC_TILE];
+static vnc_stats_t      stats;
 
 #ifdef ENABLE_VNC_LOG
 int vnc_do_log = ENABLE_VNC_LOG;
@@ -115,6 +130,8 @@ vnc_clientgone(UNUSED(rfbClientPtr cl))
 {
     vnc_log("VNC: client disconnected: %s\n", cl->host);
 
+    stats.sent_gone += rfbStatGetSentBytes(cl);
+
     if (clients > 0)
         clients--;
     if (clients == 0) {
@@ -175,24 +192,135 @@ vnc_display(rfbClientPtr cl)
     }
 }
 
+static void
+vnc_mark(int x1, int y1, int x2, int y2)
+{
+    x2 = MIN(x2, allowedX);
+    y2 = MIN(y2, allowedY);
+
+    if ((x2 > x1) && (y2 > y1)) {
+        rfbMarkRectAsModified(rfb, x1, y1, x2, y2);
+        stats.marked += (uint64_t) (x2 - x1) * (y2 - y1) * sizeof(uint32_t);
+    }
+}
+
+/* Once a second, log how much the encoders actually sent. */
+static void
+vnc_update_stats(void)
+{
+    rfbClientIteratorPtr iterator;
+    rfbClientPtr         cl;
+    uint32_t             now = plat_get_ticks();
+    long                 sent;
+
+    if ((now - stats.time) < 1000)
+        return;
+
+    sent     = stats.sent_gone;
+    iterator = rfbGetClientIterator(rfb);
+    while ((cl = rfbClientIteratorNext(iterator)) != NULL)
+        sent += rfbStatGetSentBytes(cl);
+    rfbReleaseClientIterator(iterator);
+
+    vnc_log("VNC: %ld bytes encoded, %" PRIu64 " bytes marked, %u/%u frames skipped in %u ms\n",
+            sent - stats.sent_last, stats.marked, stats.skipped, stats.frames, now - stats.time);
+
+    stats.time      = now;
+    stats.sent_last = sent;
+    stats.marked    = 0;
+    stats.frames    = 0;
+    stats.skipped   = 0;
+}
+
+/* Copy the frame in VNC_TILE sized tiles and only mark the ones that differ
+   from what the clients were last sent. */
+static void
+vnc_blit_tiles(const bitmap_t *buffer, int x, int y, int w, int h)
+{
+    int tiles = (w + VNC_TILE - 1) / VNC_TILE;
+
+    for (int ty = 0; ty < h; ty += VNC_TILE) {
+        int th    = MIN(VNC_TILE, h - ty);
+        int dirty = 0;
+        int start = -1;
+
+        memset(tile_dirty, 0, tiles);
+
+        for (int row = ty; row < (ty + th); row++) {
+            uint32_t       *dst = &((uint32_t *) rfb->frameBuffer)[row * VNC_MAX_X];
+            const uint32_t *src = &buffer->line[y + row][x];
+
+            for (int tx = 0; tx < tiles; tx++) {
+                int x0   = tx * VNC_TILE;
+                int size = MIN(VNC_TILE, w - x0) * sizeof(uint32_t);
+
+                if (tile_dirty[tx] || memcmp(&dst[x0], &src[x0], size)) {
+                    memcpy(&dst[x0], &src[x0], size);
+                    tile_dirty[tx] = 1;
+                    dirty          = 1;
+                }
+            }
+        }
+
+        if (!dirty)
+            continue;
+
+        /* Merge runs of changed tiles into one rectangle each. */
+        for (int tx = 0; tx <= tiles; tx++) {
+            if ((tx < tiles) && tile_dirty[tx]) {
+                if (start == -1)
+                    start = tx;
+            } else if (start != -1) {
+                vnc_mark(start * VNC_TILE, ty, MIN(tx * VNC_TILE, w), ty + th);
+                start = -1;
+            }
+        }
+    }
+}
+
 static void
 vnc_blit(int x, int y, int w, int h, int monitor_index)
 {
-    if (monitor_index || (x < 0) || (y < 0) || (w < VNC_MIN_X) || (h < VNC_MIN_Y) || (w > VNC_MAX_X) || (h > VNC_MAX_Y) || (buffer32 == NULL)) {
+    const bitmap_t *buffer = video_get_blit_buffer_monitor(monitor_index);
+    uint32_t        serial;
+
+    if (monitor_index || (x < 0) || (y < 0) || (w < VNC_MIN_X) || (h < VNC_MIN_Y) || (w > VNC_MAX_X) || (h > VNC_MAX_Y) || (buffer == NULL)) {
+        video_blit_complete_monitor(monitor_index);
+        return;
+    }
+
+    stats.frames++;
+
+    /* Nothing was redrawn since the last frame we copied. */
+    serial = video_get_blit_serial_monitor(monitor_index);
+    if (!full_update && !screenshots && (serial == last_serial)) {
         video_blit_complete_monitor(monitor_index);
+        stats.skipped++;
+        vnc_update_stats();
         return;
     }
+    last_serial = serial;
 
-    for (int row = 0; row < h; ++row)
-        video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(buffer32->line[y + row][x]), w * sizeof(uint32_t));
+    if (full_update || updatingSize) {
+        for (int row = 0; row < h; ++row)
+            video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(buffer->line[y + row][x]), w * sizeof(uint32_t));
+    } else
+        vnc_blit_tiles(buffer, x, y, w, h);
 
     if (screenshots)
         video_screenshot((uint32_t *) rfb->frameBuffer, 0, 0, VNC_MAX_X);
 
     video_blit_complete_monitor(monitor_index);
 
-    if (!updatingSize)
-        rfbMarkRectAsModified(rfb, 0, 0, allowedX, allowedY);
+    /* Whatever was copied during a resize goes out in full afterwards. */
+    if (updatingSize)
+        full_update = 1;
+    else if (full_update) {
+        vnc_mark(0, 0, allowedX, allowedY);
+        full_update = 0;
+    }
+
+    vnc_update_stats();
 }
 
 /* Initialize VNC for operation. */
@@ -219,8 +347,11 @@ vnc_init(UNUSED(void *arg))
     if (rfb == NULL) {
         wcstombs(title, ui_window_title(NULL), sizeof(title));
         updatingSize = 0;
+        full_update  = 1;
         allowedX     = scrnsz_x;
         allowedY     = scrnsz_y;
+        memset(&stats, 0, sizeof(vnc_stats_t));
+        stats.time = plat_get_ticks();
 
         rfb              = rfbGetScreen(0, NULL, VNC_MAX_X, VNC_MAX_Y, 8, 3, 4);
         rfb->desktopName = title;
@@ -289,6 +420,7 @@ vnc_resize(int x, int y)
 
         rfb->width  = x;
         rfb->height = y;
+        full_update = 1;
 
         iterator = rfbGetClientIterator(rfb);
         while ((cl = rfbClientIteratorNext(iterator)) != NULL) {